@@ -162,9 +162,8 @@ void initUIWindow() {
     // Set GLFW to use OpenGL if Vulkan is not available
     glfwWindowHint(GLFW_CLIENT_API, GLFW_OPENGL_API);
 
-    gladLoadGL();
-    glfwMakeContextCurrent(window);
-
+    // the context stays current on the gpupixel render thread, the window
+    // is only shown and polled here
     glfwShowWindow(window);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 
@@ -273,7 +272,9 @@ void performVideoFilters() {
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        GPUPixelContext::getInstance()->runSync([&] {
+            glfwSwapBuffers(window);
+        });
         glfwPollEvents();
     }
 
@@ -305,7 +306,9 @@ void performImageFilters() {
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        GPUPixelContext::getInstance()->runSync([&] {
+            glfwSwapBuffers(window);
+        });
         glfwPollEvents();
     }
     
@@ -317,6 +320,11 @@ void performImageFilters() {
 // ======================= Main function =========================
 int main(int argc, char** argv) {    
 
+#if defined(GPUPIXEL_ENABLE_EGL)
+    // TargetView draws into the GLFW window, the default backend is headless
+    GPUPixelContext::setContextBackend(GPUPixelContext::ContextBackendGLFW);
+#endif
+
     // Setup input parameters
     setupInputParams(argc, argv);
     
@@ -419,6 +427,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 {
     // make sure the viewport matches the new window dimensions; note that width and 
     // height will be significantly larger than specified on retina displays.
-    glViewport(0, 0, width, height);
+    GPUPixelContext::getInstance()->runSync([=] {
+        glViewport(0, 0, width, height);
+    });
     
 }
@@ -0,0 +1,344 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "frame_graph.h"
+#include <algorithm>
+#include <typeinfo>
+#include "filter_group.h"
+#include "gpupixel_context.h"
+#include "pointwise_filter.h"
+#include "source.h"
+#include "target.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// graph whose compiled frame is running on this thread
+static thread_local FrameGraph* s_executingGraph = nullptr;
+
+FrameGraph::FrameGraph()
+    : _context(nullptr), _generation(0), _currentNode(-1) {}
+
+bool FrameGraph::isStale() const {
+  return !_context || _generation != _context->getFrameGraphGeneration();
+}
+
+void FrameGraph::build(Source* root) {
+  _context = root ? root->getContext() : nullptr;
+  _generation = _context ? _context->getFrameGraphGeneration() : 0;
+  _nodes.clear();
+  _nodeMap.clear();
+  if (!root) {
+    return;
+  }
+
+  std::vector<Edge> edges;
+  _addNode(root, nullptr);
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    Source* source = _nodes[i].source;
+    if (!source) {
+      continue;
+    }
+    std::vector<std::pair<Target*, int>> consumers;
+    for (auto& it : source->getTargets()) {
+      _collectConsumers(it.first.get(), it.second, consumers);
+    }
+    for (auto& consumer : consumers) {
+      int index =
+          _addNode(dynamic_cast<Source*>(consumer.first), consumer.first);
+      edges.push_back({(int)i, index, consumer.second});
+    }
+  }
+
+  _sortNodes(edges);
+  _compile(edges);
+}
+
+void FrameGraph::_collectConsumers(
+    Target* target,
+    int texIdx,
+    std::vector<std::pair<Target*, int>>& consumers) {
+  // the filters of a group all receive the group input
+  if (auto group = dynamic_cast<FilterGroup*>(target)) {
+    for (auto& filter : group->getFilters()) {
+      _collectConsumers(filter.get(), texIdx, consumers);
+    }
+    return;
+  }
+  if (target) {
+    consumers.push_back({target, texIdx});
+  }
+}
+
+int FrameGraph::_addNode(Source* source, Target* target) {
+  // a filter is reached both as Source and as Target, key it by the object
+  const void* key = source ? dynamic_cast<const void*>(source)
+                           : dynamic_cast<const void*>(target);
+  auto it = _nodeMap.find(key);
+  if (it != _nodeMap.end()) {
+    return it->second;
+  }
+  Node node;
+  node.source = source;
+  node.target = target;
+  node.lastConsumer = -1;
+  node.transient = false;
+  node.external = false;
+  node.fused = false;
+  _nodes.push_back(node);
+  int index = (int)_nodes.size() - 1;
+  _nodeMap[key] = index;
+  return index;
+}
+
+void FrameGraph::_sortNodes(std::vector<Edge>& edges) {
+  // Kahn's algorithm, ties keep discovery order
+  std::vector<std::vector<int>> successors(_nodes.size());
+  std::vector<int> inDegree(_nodes.size(), 0);
+  for (auto& edge : edges) {
+    successors[edge.producer].push_back(edge.consumer);
+    inDegree[edge.consumer]++;
+  }
+  std::vector<int> order;
+  std::vector<bool> placed(_nodes.size(), false);
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    if (inDegree[i] == 0) {
+      order.push_back((int)i);
+      placed[i] = true;
+    }
+  }
+  for (size_t head = 0; head < order.size(); ++head) {
+    for (auto consumer : successors[order[head]]) {
+      if (--inDegree[consumer] == 0 && !placed[consumer]) {
+        order.push_back(consumer);
+        placed[consumer] = true;
+      }
+    }
+  }
+  if (order.size() != _nodes.size()) {
+    Util::Log("WARNING", "FrameGraph: cycle in the filter graph");
+    for (size_t i = 0; i < _nodes.size(); ++i) {
+      if (!placed[i]) {
+        order.push_back((int)i);
+      }
+    }
+  }
+
+  std::vector<int> position(_nodes.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    position[order[i]] = (int)i;
+  }
+  std::vector<Node> sorted;
+  sorted.reserve(_nodes.size());
+  for (auto index : order) {
+    sorted.push_back(_nodes[index]);
+  }
+  _nodes.swap(sorted);
+  for (auto& it : _nodeMap) {
+    it.second = position[it.second];
+  }
+  for (auto& edge : edges) {
+    edge.producer = position[edge.producer];
+    edge.consumer = position[edge.consumer];
+  }
+}
+
+void FrameGraph::_compile(const std::vector<Edge>& edges) {
+  for (auto& edge : edges) {
+    Node& producer = _nodes[edge.producer];
+    if (std::find(producer.consumers.begin(), producer.consumers.end(),
+                  edge.consumer) == producer.consumers.end()) {
+      producer.consumers.push_back(edge.consumer);
+    }
+    // a group hands its input to every filter inside it, the filter that
+    // draws later into the same slot wins
+    Node& consumer = _nodes[edge.consumer];
+    bool bound = false;
+    for (auto& input : consumer.inputs) {
+      if (input.texIdx == edge.texIdx) {
+        input.producer = std::max(input.producer, edge.producer);
+        bound = true;
+      }
+    }
+    if (!bound) {
+      consumer.inputs.push_back({edge.producer, edge.texIdx});
+    }
+  }
+  if (_context->isFrameGraphFusionEnabled()) {
+    _fuse();
+  }
+
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    Node& node = _nodes[i];
+    for (auto& input : node.inputs) {
+      Node& producer = _nodes[input.producer];
+      producer.lastConsumer = std::max(producer.lastConsumer, (int)i);
+    }
+    if (node.target) {
+      node.external = (int)node.inputs.size() < node.target->_inputNum;
+    }
+  }
+
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    Node& node = _nodes[i];
+    node.transient = node.target && node.source && !node.consumers.empty() &&
+                     !node.source->_retainFramebuffer;
+    if (node.source) {
+      // a fused filter only draws when a captured frame runs it the long way
+      node.source->_releaseFramebufferAfterUpdate =
+          node.transient || node.fused;
+    }
+    if (node.transient) {
+      // an output every consumer takes from a later producer is dropped
+      // right away
+      int release = node.lastConsumer >= 0 ? node.lastConsumer : (int)i;
+      _nodes[release].releases.push_back((int)i);
+    }
+  }
+}
+
+bool FrameGraph::_canFuse(int producer) const {
+  const Node& node = _nodes[producer];
+  // the root has drawn before the graph runs
+  if (producer == 0 || node.consumers.size() != 1 ||
+      node.inputs.size() != 1 || !node.target ||
+      !dynamic_cast<PointwiseFilter*>(node.source)) {
+    return false;
+  }
+  // an output read after the frame, or at another size, must be drawn
+  const Source* source = node.source;
+  if (source->_retainFramebuffer || source->_framebufferScale != 1.0 ||
+      node.target->_inputNum != 1) {
+    return false;
+  }
+  const Node& consumer = _nodes[node.consumers[0]];
+  return consumer.inputs.size() == 1 && consumer.inputs[0].texIdx == 0 &&
+         consumer.target->_inputNum == 1 &&
+         dynamic_cast<PointwiseFilter*>(consumer.source);
+}
+
+void FrameGraph::_fuse() {
+  // producers come first, a chain grows one consumer at a time
+  for (size_t i = 0; i < _nodes.size(); ++i) {
+    if (!_canFuse((int)i)) {
+      continue;
+    }
+    Node& node = _nodes[i];
+    Node& consumer = _nodes[node.consumers[0]];
+    consumer.stages.swap(node.stages);
+    if (consumer.stages.empty()) {
+      consumer.stages.push_back(dynamic_cast<PointwiseFilter*>(node.source));
+    }
+    consumer.stages.push_back(dynamic_cast<PointwiseFilter*>(consumer.source));
+
+    // the consumer reads what this node would have read
+    consumer.inputs = node.inputs;
+    for (auto& input : node.inputs) {
+      for (auto& index : _nodes[input.producer].consumers) {
+        if (index == (int)i) {
+          index = node.consumers[0];
+        }
+      }
+    }
+    node.inputs.clear();
+    node.consumers.clear();
+    node.fused = true;
+    // an output kept from before the fusion would never be replaced
+    node.source->_framebuffer.reset();
+  }
+}
+
+void FrameGraph::execute(int64_t frameTime) {
+  if (_nodes.empty()) {
+    return;
+  }
+  GLDebug* glDebug = _nodes[0].source->_context->getGLDebug();
+  FrameGraph* outerGraph = s_executingGraph;
+  s_executingGraph = this;
+  _produced.assign(_nodes.size(), false);
+  _produced[0] = true;
+
+  for (size_t i = 1; i < _nodes.size(); ++i) {
+    Node& node = _nodes[i];
+    if (node.fused) {
+      continue;
+    }
+    bool ready = true;
+    for (auto& input : node.inputs) {
+      Source* producer = _nodes[input.producer].source;
+      if (!_produced[input.producer] || !producer->_framebuffer) {
+        ready = false;
+        continue;
+      }
+      node.target->setInputFramebuffer(
+          producer->_framebuffer, producer->_outputRotation, input.texIdx);
+    }
+    if (ready && (!node.external || node.target->isPrepared())) {
+      _currentNode = (int)i;
+      TRACE_SCOPE(typeid(*node.target).name());
+      glDebug->setCurrentPass(typeid(*node.target).name());
+      if (node.stages.empty()) {
+        node.target->update(frameTime);
+      } else {
+        PointwiseFilter* filter = node.stages.back();
+        filter->setFusedStages(&node.stages);
+        filter->update(frameTime);
+        filter->setFusedStages(nullptr);
+      }
+      node.target->unPrepear();
+    }
+    for (auto producer : node.releases) {
+      _nodes[producer].source->_framebuffer.reset();
+    }
+  }
+
+  _currentNode = -1;
+  s_executingGraph = outerGraph;
+}
+
+bool FrameGraph::onSourceUpdated(Source* source) {
+  FrameGraph* graph = s_executingGraph;
+  if (!graph || graph->_currentNode < 0 ||
+      graph->_nodes[graph->_currentNode].source != source) {
+    return false;
+  }
+  graph->_produced[graph->_currentNode] = true;
+  return true;
+}
+
+int FrameGraph::getNodeIndex(const Source* source) const {
+  if (!source) {
+    return -1;
+  }
+  auto it = _nodeMap.find(dynamic_cast<const void*>(source));
+  if (it == _nodeMap.end()) {
+    return -1;
+  }
+  return it->second;
+}
+
+int FrameGraph::getFusedCount() const {
+  int count = 0;
+  for (auto& node : _nodes) {
+    if (node.fused) {
+      count++;
+    }
+  }
+  return count;
+}
+
+int FrameGraph::getTransientCount() const {
+  int count = 0;
+  for (auto& node : _nodes) {
+    if (node.transient) {
+      count++;
+    }
+  }
+  return count;
+}
+
+NS_GPUPIXEL_END
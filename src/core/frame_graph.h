@@ -0,0 +1,116 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <vector>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+class Source;
+class Target;
+class PointwiseFilter;
+
+// Lifetime analysis of the framebuffers flowing through the Source/Target
+// graph reachable from a root source. Nodes are kept in an order where every
+// producer comes before its consumers, and each output records the last node
+// reading it. Intermediate outputs are marked transient: their producer drops
+// its reference once the frame has been handed on, so the framebuffer goes
+// back to the cache as soon as the last consumer has drawn from it.
+//
+// The root output and the outputs of leaf nodes are never transient, callers
+// read them after the frame. A filter group is not a node itself, its input
+// is consumed by the filters inside it.
+//
+// Building also compiles the nodes into a flat list of steps: every input
+// slot is bound to the node it is read from, so execute() runs a frame in
+// order without walking the targets or recursing through update().
+//
+// A chain of pointwise filters, see PointwiseFilter, whose intermediate
+// outputs are only read by the next filter of the chain is fused: the last
+// filter reads the input of the first one and draws all of their stages in
+// one pass, the filters before it are skipped.
+class GPUPIXEL_API FrameGraph {
+ public:
+  struct Input {
+    int producer;
+    int texIdx;
+  };
+
+  struct Node {
+    // null for targets that produce nothing, such as views
+    Source* source;
+    // null for the root
+    Target* target;
+    // indices of the nodes this node's output is sent to
+    std::vector<int> consumers;
+    // the node each input slot is read from, a slot written by several
+    // producers keeps the one running last
+    std::vector<Input> inputs;
+    // producers whose output is dropped once this node has run
+    std::vector<int> releases;
+    // -1 when nothing in the graph reads the output
+    int lastConsumer;
+    bool transient;
+    // some inputs come from outside the graph, check the target is prepared
+    bool external;
+    // drawn by the last filter of its fused chain
+    bool fused;
+    // the filters of the fused chain ending with this one, first to last
+    std::vector<PointwiseFilter*> stages;
+  };
+
+  FrameGraph();
+
+  void build(Source* root);
+  // true once targets or filters have been added or removed in the context
+  // of the root since the last build, see
+  // GPUPixelContext::invalidateFrameGraphs()
+  bool isStale() const;
+
+  // runs the nodes after the root, which has already drawn its output
+  void execute(int64_t frameTime);
+  // called by Source::updateTargets(), true when a compiled frame is running
+  // on this thread and hands the output of the source on itself
+  static bool onSourceUpdated(Source* source);
+
+  const std::vector<Node>& getNodes() const { return _nodes; }
+  int getNodeIndex(const Source* source) const;
+  int getTransientCount() const;
+  int getFusedCount() const;
+
+ private:
+  typedef std::map<const void*, int> NodeMap;
+  struct Edge {
+    int producer;
+    int consumer;
+    int texIdx;
+  };
+
+  void _sortNodes(std::vector<Edge>& edges);
+  void _compile(const std::vector<Edge>& edges);
+  void _fuse();
+  bool _canFuse(int producer) const;
+  void _collectConsumers(Target* target,
+                         int texIdx,
+                         std::vector<std::pair<Target*, int>>& consumers);
+  int _addNode(Source* source, Target* target);
+
+  std::vector<Node> _nodes;
+  NodeMap _nodeMap;
+  // context of the root, and its generation the nodes were built at
+  GPUPixelContext* _context;
+  uint64_t _generation;
+  // nodes that have drawn in the running frame
+  std::vector<bool> _produced;
+  int _currentNode;
+};
+
+NS_GPUPIXEL_END
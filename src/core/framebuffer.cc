@@ -11,6 +11,14 @@
 #include "gpupixel_context.h"
 #include "util.h"
 
+// the loader of desktop GL stops at 3.1, texture swizzles came with 3.3
+#if defined(GL_RG) && !defined(GL_TEXTURE_SWIZZLE_R)
+#define GL_TEXTURE_SWIZZLE_R 0x8E42
+#define GL_TEXTURE_SWIZZLE_G 0x8E43
+#define GL_TEXTURE_SWIZZLE_B 0x8E44
+#define GL_TEXTURE_SWIZZLE_A 0x8E45
+#endif
+
 NS_GPUPIXEL_BEGIN
 
 // std::vector<std::shared_ptr<Framebuffer>> Framebuffer::_framebuffers;
@@ -22,18 +30,48 @@ TextureAttributes Framebuffer::defaultTextureAttribures = {
     .wrapT = GL_CLAMP_TO_EDGE,
     .internalFormat = GL_RGBA,
     .format = GL_RGBA,
-    .type = GL_UNSIGNED_BYTE};
+    .type = GL_UNSIGNED_BYTE,
+    .immutable = false};
 #else
 TextureAttributes Framebuffer::defaultTextureAttribures = {
     GL_LINEAR, GL_LINEAR, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE,
-    GL_RGBA,   GL_RGBA,   GL_UNSIGNED_BYTE};
+    GL_RGBA,   GL_RGBA,   GL_UNSIGNED_BYTE, false};
+#endif
+
+TextureAttributes Framebuffer::getFormatTextureAttributes(
+    FramebufferFormat format) {
+  TextureAttributes attributes = defaultTextureAttribures;
+  switch (format) {
+#if defined(GL_R8) && defined(GL_RG8) && defined(GL_RGBA16F)
+    case FramebufferFormatR8:
+      attributes.internalFormat = GL_R8;
+      attributes.format = GL_RED;
+      break;
+    case FramebufferFormatRG8:
+      attributes.internalFormat = GL_RG8;
+      attributes.format = GL_RG;
+      break;
+    case FramebufferFormatRGBA16F:
+      attributes.internalFormat = GL_RGBA16F;
+      attributes.type = GL_HALF_FLOAT;
+      break;
 #endif
+    default:
+      break;
+  }
+  return attributes;
+}
+
 Framebuffer::Framebuffer(
     int width,
     int height,
     bool onlyGenerateTexture /* = false*/,
-    const TextureAttributes textureAttributes /* = defaultTextureAttribures*/)
-    : _texture(-1), _framebuffer(-1) {
+    const TextureAttributes textureAttributes /* = defaultTextureAttribures*/,
+    GPUPixelContext* context /* = nullptr*/)
+    : _context(context ? context : GPUPixelContext::getInstance()),
+      _texture(-1),
+      _framebuffer(-1),
+      _orphaned(false) {
   _width = width;
   _height = height;
   _textureAttributes = textureAttributes;
@@ -47,33 +85,42 @@ Framebuffer::Framebuffer(
 }
 
 Framebuffer::~Framebuffer() {
-  gpupixel::GPUPixelContext::getInstance()->runSync([&] {
+  if (_orphaned) {
+    return;
+  }
+  _context->runSync([&] {
     bool bDeleteTex = (_texture != -1);
     bool bDeleteFB = (_framebuffer != -1);
 
+    GLStateCache* glState = _context->getGLStateCache();
     if (bDeleteTex) {
       CHECK_GL(glDeleteTextures(1, &_texture));
+      glState->onTextureDeleted(_texture);
       _texture = -1;
     }
     if (bDeleteFB) {
       CHECK_GL(glDeleteFramebuffers(1, &_framebuffer));
+      glState->onFramebufferDeleted(_framebuffer);
       _framebuffer = -1;
     }
   });
 }
 
 void Framebuffer::active() {
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
-  CHECK_GL(glViewport(0, 0, _width, _height));
+  GLStateCache* glState = _context->getGLStateCache();
+  glState->bindFramebuffer(_framebuffer);
+  glState->viewport(0, 0, _width, _height);
 }
 
 void Framebuffer::inactive() {
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  // the binding stays until the next framebuffer is activated, the default
+  // one is restored at the end of the frame
 }
 
 void Framebuffer::_generateTexture() {
+  GLStateCache* glState = _context->getGLStateCache();
   CHECK_GL(glGenTextures(1, &_texture));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, _texture));
+  glState->bindTexture(_texture);
   CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                            _textureAttributes.minFilter));
   CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
@@ -82,23 +129,46 @@ void Framebuffer::_generateTexture() {
                            _textureAttributes.wrapS));
   CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
                            _textureAttributes.wrapT));
+#if defined(GL_RG) && defined(GL_TEXTURE_SWIZZLE_R)
+  // read as the luminance formats GLES 2 had, see FramebufferFormat
+  if (_textureAttributes.format == GL_RED ||
+      _textureAttributes.format == GL_RG) {
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED));
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED));
+    CHECK_GL(glTexParameteri(
+        GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A,
+        _textureAttributes.format == GL_RG ? GL_GREEN : GL_ONE));
+  }
+#endif
 
   // TODO: Handle mipmaps
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+  glState->bindTexture(0);
 }
 
 void Framebuffer::_generateFramebuffer() {
+  GLStateCache* glState = _context->getGLStateCache();
   CHECK_GL(glGenFramebuffers(1, &_framebuffer));
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glState->bindFramebuffer(_framebuffer);
   _generateTexture();
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, _texture));
+  glState->bindTexture(_texture);
+#if defined(GPUPIXEL_ANDROID)
+  if (_textureAttributes.immutable) {
+    CHECK_GL(glTexStorage2D(GL_TEXTURE_2D, 1, _textureAttributes.internalFormat,
+                            _width, _height));
+  } else {
+    CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, _textureAttributes.internalFormat,
+                          _width, _height, 0, _textureAttributes.format,
+                          _textureAttributes.type, 0));
+  }
+#else
   CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, _textureAttributes.internalFormat,
                         _width, _height, 0, _textureAttributes.format,
                         _textureAttributes.type, 0));
+#endif
   CHECK_GL(glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                                   GL_TEXTURE_2D, _texture, 0));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  glState->bindTexture(0);
+  glState->bindFramebuffer(0);
 }
 
 NS_GPUPIXEL_END
@@ -12,6 +12,8 @@
 #include <vector>
 
 NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+
 GPUPIXEL_API typedef struct {
   GLenum minFilter;
   GLenum magFilter;
@@ -20,15 +22,31 @@ GPUPIXEL_API typedef struct {
   GLenum internalFormat;
   GLenum format;
   GLenum type;
+  // allocated with glTexStorage2D, which GLES 3.1 requires to write the
+  // texture as an image, see GLCompute. It can't be respecified.
+  bool immutable;
 } TextureAttributes;
 
+// Formats a filter can render its output in. R8 samples as luminance
+// (r, r, r, 1) and RG8 as luminance with alpha (r, r, r, g), so consumers
+// written for RGBA read them unchanged. RGBA16F keeps values outside 0..1
+// and finer steps between passes.
+enum FramebufferFormat {
+  FramebufferFormatRGBA8 = 0,
+  FramebufferFormatR8,
+  FramebufferFormatRG8,
+  FramebufferFormatRGBA16F,
+  FramebufferFormatCount
+};
+
 class GPUPIXEL_API Framebuffer {
  public:
   Framebuffer(
       int width,
       int height,
       bool onlyGenerateTexture = false,
-      const TextureAttributes textureAttributes = defaultTextureAttribures);
+      const TextureAttributes textureAttributes = defaultTextureAttribures,
+      GPUPixelContext* context = nullptr);
   ~Framebuffer();
 
   GLuint getTexture() const { return _texture; }
@@ -44,15 +62,23 @@ class GPUPIXEL_API Framebuffer {
 
   void active();
   void inactive();
+  // The context is gone and its GL objects with it, the destructor deletes
+  // nothing. Set for the framebuffers still held when their cache goes.
+  void orphan() { _orphaned = true; }
 
   static TextureAttributes defaultTextureAttribures;
+  // the attributes of |format|, linearly filtered and clamped like the
+  // default ones
+  static TextureAttributes getFormatTextureAttributes(FramebufferFormat format);
 
  private:
+  GPUPixelContext* _context;
   int _width, _height;
   TextureAttributes _textureAttributes;
   bool _hasFB;
   GLuint _texture;
   GLuint _framebuffer;
+  bool _orphaned;
 
   void _generateTexture();
   void _generateFramebuffer();
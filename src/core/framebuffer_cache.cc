@@ -10,7 +10,45 @@
 
 NS_GPUPIXEL_BEGIN
 
-FramebufferCache::FramebufferCache() {}
+const size_t FramebufferCache::kDefaultMemoryBudget = 128 * 1024 * 1024;
+
+bool FramebufferKey::operator==(const FramebufferKey& other) const {
+  return width == other.width && height == other.height &&
+         onlyTexture == other.onlyTexture &&
+         textureAttributes.minFilter == other.textureAttributes.minFilter &&
+         textureAttributes.magFilter == other.textureAttributes.magFilter &&
+         textureAttributes.wrapS == other.textureAttributes.wrapS &&
+         textureAttributes.wrapT == other.textureAttributes.wrapT &&
+         textureAttributes.internalFormat ==
+             other.textureAttributes.internalFormat &&
+         textureAttributes.format == other.textureAttributes.format &&
+         textureAttributes.type == other.textureAttributes.type &&
+         textureAttributes.immutable == other.textureAttributes.immutable;
+}
+
+size_t FramebufferKeyHash::operator()(const FramebufferKey& key) const {
+  // FNV-1a over the fields
+  uint64_t hash = 14695981039346656037ULL;
+  auto mix = [&hash](uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ULL;
+  };
+  mix((uint64_t)key.width);
+  mix((uint64_t)key.height);
+  mix(key.onlyTexture);
+  mix(key.textureAttributes.minFilter);
+  mix(key.textureAttributes.magFilter);
+  mix(key.textureAttributes.wrapS);
+  mix(key.textureAttributes.wrapT);
+  mix(key.textureAttributes.internalFormat);
+  mix(key.textureAttributes.format);
+  mix(key.textureAttributes.type);
+  mix(key.textureAttributes.immutable);
+  return (size_t)hash;
+}
+
+FramebufferCache::FramebufferCache(GPUPixelContext* context)
+    : _context(context), _memoryBudget(kDefaultMemoryBudget), _stats() {}
 
 FramebufferCache::~FramebufferCache() {
   purge();
@@ -21,92 +59,175 @@ std::shared_ptr<Framebuffer> FramebufferCache::fetchFramebuffer(
     int height,
     bool onlyTexture /* = false*/,
     const TextureAttributes textureAttributes /* = defaultTextureAttribure*/) {
-  std::shared_ptr<Framebuffer> framebufferFromCache;
-  std::string lookupHash =
-      _getHash(width, height, onlyTexture, textureAttributes);
-  int numberOfMatchingFramebuffers = 0;
-  if (_framebufferTypeCounts.find(lookupHash) != _framebufferTypeCounts.end()) {
-    numberOfMatchingFramebuffers = _framebufferTypeCounts[lookupHash];
+  FramebufferKey key = {width, height, onlyTexture, textureAttributes};
+  Framebuffer* framebuffer = nullptr;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto freeList = _freeLists.find(key);
+    if (freeList != _freeLists.end() && !freeList->second.empty()) {
+      CachedIterator cached = freeList->second.back();
+      freeList->second.pop_back();
+      framebuffer = cached->framebuffer;
+      _stats.cachedBytes -= _getByteSize(key);
+      _stats.cachedCount--;
+      _lru.erase(cached);
+      _stats.hits++;
+    } else {
+      _stats.misses++;
+    }
   }
-  if (numberOfMatchingFramebuffers < 1) {
-    framebufferFromCache = std::shared_ptr<Framebuffer>(
-        new Framebuffer(width, height, onlyTexture, textureAttributes));
-  } else {
-    int curFramebufferId = numberOfMatchingFramebuffers - 1;
-    while (!framebufferFromCache && curFramebufferId >= 0) {
-      std::string framebufferHash =
-          Util::str_format("%s-%ld", lookupHash.c_str(), curFramebufferId);
-      if (_framebuffers.find(framebufferHash) != _framebuffers.end()) {
-        framebufferFromCache = _framebuffers[framebufferHash];
-        _framebuffers.erase(framebufferHash);
-      } else {
-        framebufferFromCache = 0;
+
+  if (!framebuffer) {
+    framebuffer = new Framebuffer(width, height, onlyTexture,
+                                  textureAttributes, _context);
+    std::vector<Framebuffer*> evicted;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _stats.liveBytes += _getByteSize(key);
+      if (_stats.liveBytes > _stats.peakBytes) {
+        _stats.peakBytes = _stats.liveBytes;
       }
-      curFramebufferId--;
+      _evict(_memoryBudget, evicted);
     }
-    curFramebufferId++;
-    _framebufferTypeCounts[lookupHash] = curFramebufferId;
-
-    if (!framebufferFromCache) {
-      framebufferFromCache = std::shared_ptr<Framebuffer>(
-          new Framebuffer(width, height, onlyTexture, textureAttributes));
+    for (auto evictedFramebuffer : evicted) {
+      delete evictedFramebuffer;
     }
   }
 
-  return framebufferFromCache;
+  std::weak_ptr<FramebufferCache> weakCache = weak_from_this();
+  return std::shared_ptr<Framebuffer>(
+      framebuffer, [weakCache, key](Framebuffer* framebuffer) {
+        if (auto cache = weakCache.lock()) {
+          cache->_recycle(key, framebuffer);
+        } else {
+          // the cache went with its context, which may be destroyed already
+          framebuffer->orphan();
+          delete framebuffer;
+        }
+      });
 }
 
-void FramebufferCache::returnFramebuffer(
-    std::shared_ptr<Framebuffer> framebuffer) {
-  if (framebuffer == 0) {
-    return;
+void FramebufferCache::_recycle(const FramebufferKey& key,
+                                Framebuffer* framebuffer) {
+  std::vector<Framebuffer*> evicted;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _lru.push_front({key, framebuffer});
+    _freeLists[key].push_back(_lru.begin());
+    _stats.cachedBytes += _getByteSize(key);
+    _stats.cachedCount++;
+    _evict(_memoryBudget, evicted);
   }
-  int width = framebuffer->getWidth();
-  int height = framebuffer->getHeight();
-  const TextureAttributes& textureAttributes =
-      framebuffer->getTextureAttributes();
-  std::string lookupHash = _getHash(
-      width, height, !framebuffer->hasFramebuffer(), textureAttributes);
-  int numberOfMatchingFramebuffers = 0;
-  if (_framebufferTypeCounts.find(lookupHash) != _framebufferTypeCounts.end()) {
-    numberOfMatchingFramebuffers = _framebufferTypeCounts[lookupHash];
+  // deleting runs on the render thread, never while holding the lock
+  for (auto evictedFramebuffer : evicted) {
+    delete evictedFramebuffer;
   }
-  std::string framebufferHash = Util::str_format("%s-%ld", lookupHash.c_str(),
-                                                 numberOfMatchingFramebuffers);
-  _framebuffers[framebufferHash] = framebuffer;
-  _framebufferTypeCounts[lookupHash] = numberOfMatchingFramebuffers + 1;
 }
 
-std::string FramebufferCache::_getHash(
-    int width,
-    int height,
-    bool onlyTexture,
-    const TextureAttributes textureAttributes) const {
-  if (onlyTexture) {
-    return Util::str_format("%.1dx%.1d-%d:%d:%d:%d:%d:%d:%d-NOFB", width,
-                            height, textureAttributes.minFilter,
-                            textureAttributes.magFilter,
-                            textureAttributes.wrapS, textureAttributes.wrapT,
-                            textureAttributes.internalFormat,
-                            textureAttributes.format, textureAttributes.type);
-  } else {
-    return Util::str_format("%.1dx%.1d-%d:%d:%d:%d:%d:%d:%d", width, height,
-                            textureAttributes.minFilter,
-                            textureAttributes.magFilter,
-                            textureAttributes.wrapS, textureAttributes.wrapT,
-                            textureAttributes.internalFormat,
-                            textureAttributes.format, textureAttributes.type);
+void FramebufferCache::_evict(size_t budget,
+                              std::vector<Framebuffer*>& evicted) {
+  // only idle framebuffers can go, a working set larger than the budget
+  // must still find its framebuffers here on the next pass
+  while (!_lru.empty() && budget > 0 && _stats.cachedBytes > budget) {
+    CachedFramebuffer& oldest = _lru.back();
+    size_t bytes = _getByteSize(oldest.key);
+    auto& freeList = _freeLists[oldest.key];
+    // entries of one key are ordered by release time, oldest first
+    freeList.erase(freeList.begin());
+    if (freeList.empty()) {
+      _freeLists.erase(oldest.key);
+    }
+    evicted.push_back(oldest.framebuffer);
+    _stats.liveBytes -= bytes;
+    _stats.cachedBytes -= bytes;
+    _stats.cachedCount--;
+    _lru.pop_back();
+  }
+}
+
+void FramebufferCache::purge() {
+  std::vector<Framebuffer*> evicted;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto& cached : _lru) {
+      evicted.push_back(cached.framebuffer);
+      _stats.liveBytes -= _getByteSize(cached.key);
+    }
+    _lru.clear();
+    _freeLists.clear();
+    _stats.cachedBytes = 0;
+    _stats.cachedCount = 0;
+  }
+  for (auto framebuffer : evicted) {
+    delete framebuffer;
   }
 }
 
-std::shared_ptr<Framebuffer> FramebufferCache::_getFramebufferByHash(
-    const std::string& hash) {
-  return _framebuffers[hash];
+void FramebufferCache::setMemoryBudget(size_t bytes) {
+  std::vector<Framebuffer*> evicted;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _memoryBudget = bytes;
+    _evict(_memoryBudget, evicted);
+  }
+  for (auto framebuffer : evicted) {
+    delete framebuffer;
+  }
 }
 
-void FramebufferCache::purge() {
-  _framebuffers.clear();
-  _framebufferTypeCounts.clear();
+FramebufferCacheStats FramebufferCache::getStats() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  return _stats;
+}
+
+void FramebufferCache::resetStats() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _stats.hits = 0;
+  _stats.misses = 0;
+  _stats.peakBytes = _stats.liveBytes;
+}
+
+size_t FramebufferCache::_getByteSize(const FramebufferKey& key) {
+  const TextureAttributes& attributes = key.textureAttributes;
+  size_t components = 4;
+  switch (attributes.format) {
+    case GL_ALPHA:
+    case GL_LUMINANCE:
+      components = 1;
+      break;
+    case GL_LUMINANCE_ALPHA:
+      components = 2;
+      break;
+#if defined(GL_RG)
+    case GL_RED:
+      components = 1;
+      break;
+    case GL_RG:
+      components = 2;
+      break;
+#endif
+    case GL_RGB:
+      components = 3;
+      break;
+    default:
+      break;
+  }
+  size_t componentSize = 1;
+  switch (attributes.type) {
+    case GL_FLOAT:
+      componentSize = 4;
+      break;
+    case GL_UNSIGNED_SHORT:
+    case GL_SHORT:
+#if defined(GL_HALF_FLOAT)
+    case GL_HALF_FLOAT:
+#endif
+      componentSize = 2;
+      break;
+    default:
+      break;
+  }
+  return (size_t)key.width * key.height * components * componentSize;
 }
 
 NS_GPUPIXEL_END
@@ -7,15 +7,51 @@
 
 #pragma once
 
-#include <map>
-#include <string>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 #include "framebuffer.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API FramebufferCache {
+class GPUPixelContext;
+
+struct FramebufferKey {
+  int width;
+  int height;
+  bool onlyTexture;
+  TextureAttributes textureAttributes;
+
+  bool operator==(const FramebufferKey& other) const;
+};
+
+struct FramebufferKeyHash {
+  size_t operator()(const FramebufferKey& key) const;
+};
+
+struct FramebufferCacheStats {
+  uint64_t hits;
+  uint64_t misses;
+  // textures allocated by the cache, in use or idle
+  size_t liveBytes;
+  size_t peakBytes;
+  // idle textures waiting to be reused
+  size_t cachedBytes;
+  int cachedCount;
+};
+
+// Framebuffers handed out by the cache come back to it when the last
+// shared_ptr is released. Idle ones are reused for the same size and
+// attributes, and the least recently released are deleted once the idle
+// bytes exceed the memory budget. Framebuffers in use don't count against
+// it, they can't be deleted.
+class GPUPIXEL_API FramebufferCache
+    : public std::enable_shared_from_this<FramebufferCache> {
  public:
-  FramebufferCache();
+  FramebufferCache(GPUPixelContext* context);
   ~FramebufferCache();
   std::shared_ptr<Framebuffer> fetchFramebuffer(
       int width,
@@ -23,18 +59,36 @@ class GPUPIXEL_API FramebufferCache {
       bool onlyTexture = false,
       const TextureAttributes textureAttributes =
           Framebuffer::defaultTextureAttribures);
-  void returnFramebuffer(std::shared_ptr<Framebuffer> framebuffer);
   void purge();
 
+  // bytes of idle framebuffers kept for reuse, 0 disables eviction
+  void setMemoryBudget(size_t bytes);
+  size_t getMemoryBudget() const { return _memoryBudget; }
+  FramebufferCacheStats getStats();
+  void resetStats();
+
+  static const size_t kDefaultMemoryBudget;
+
  private:
-  std::string _getHash(int width,
-                       int height,
-                       bool onlyTexture,
-                       const TextureAttributes textureAttributes) const;
-  std::shared_ptr<Framebuffer> _getFramebufferByHash(const std::string& hash);
-
-  std::map<std::string, std::shared_ptr<Framebuffer>> _framebuffers;
-  std::map<std::string, int> _framebufferTypeCounts;
+  struct CachedFramebuffer {
+    FramebufferKey key;
+    Framebuffer* framebuffer;
+  };
+  typedef std::list<CachedFramebuffer>::iterator CachedIterator;
+
+  void _recycle(const FramebufferKey& key, Framebuffer* framebuffer);
+  void _evict(size_t budget, std::vector<Framebuffer*>& evicted);
+  static size_t _getByteSize(const FramebufferKey& key);
+
+  GPUPixelContext* _context;
+  std::mutex _mutex;
+  // idle framebuffers, most recently released first
+  std::list<CachedFramebuffer> _lru;
+  std::unordered_map<FramebufferKey, std::vector<CachedIterator>,
+                     FramebufferKeyHash>
+      _freeLists;
+  size_t _memoryBudget;
+  FramebufferCacheStats _stats;
 };
 
 NS_GPUPIXEL_END
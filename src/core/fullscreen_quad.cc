@@ -0,0 +1,253 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "fullscreen_quad.h"
+#include <cstdlib>
+#include <cstring>
+#include "gpupixel_context.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+static const GLfloat kQuadPositions[] = {
+    -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
+};
+
+// floats per attribute of the quad, four vertices of two components
+static const int kQuadAttributeSize = 8;
+static const int kRotationCount = Rotate180 + 1;
+
+// texture coordinates of |rotation| follow the positions in the buffer
+static GLintptr getTexCoordOffset(RotationMode rotation) {
+  return (1 + (int)rotation) * kQuadAttributeSize * sizeof(GLfloat);
+}
+
+static int getGLMajorVersion() {
+  const char* version = (const char*)glGetString(GL_VERSION);
+  if (!version) {
+    return 0;
+  }
+  // "OpenGL ES 3.0 ..." on embedded contexts, "3.2 ..." on desktop
+  const char* prefix = "OpenGL ES ";
+  if (strncmp(version, prefix, strlen(prefix)) == 0) {
+    version += strlen(prefix);
+  }
+  return atoi(version);
+}
+
+FullscreenQuad::FullscreenQuad(GPUPixelContext* context)
+    : _context(context),
+      _initialized(false),
+      _vertexArraySupported(false),
+      _buffer(0) {}
+
+FullscreenQuad::~FullscreenQuad() {
+  if (!_initialized) {
+    return;
+  }
+  _context->runSync([&] {
+    GLStateCache* glState = _context->getGLStateCache();
+#if !defined(GPUPIXEL_MAC)
+    for (auto& it : _vertexArrays) {
+      glState->onVertexArrayDeleted(it.second);
+      CHECK_GL(glDeleteVertexArrays(1, &it.second));
+    }
+#endif
+    _vertexArrays.clear();
+    if (_buffer) {
+      glState->onBufferDeleted(_buffer);
+      CHECK_GL(glDeleteBuffers(1, &_buffer));
+      _buffer = 0;
+    }
+  });
+}
+
+bool FullscreenQuad::_init() {
+  _initialized = true;
+
+  std::vector<GLfloat> vertices(kQuadPositions,
+                                kQuadPositions + kQuadAttributeSize);
+  for (int i = 0; i < kRotationCount; ++i) {
+    const GLfloat* texCoords = getTextureCoordinates((RotationMode)i);
+    vertices.insert(vertices.end(), texCoords, texCoords + kQuadAttributeSize);
+  }
+
+  CHECK_GL(glGenBuffers(1, &_buffer));
+  _context->getGLStateCache()->bindArrayBuffer(_buffer);
+  CHECK_GL(glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
+                        vertices.data(), GL_STATIC_DRAW));
+
+#if !defined(GPUPIXEL_MAC)
+  // core in GL 3.0 and GLES 3.0, legacy macOS contexts only have the
+  // APPLE extension
+  _vertexArraySupported = getGLMajorVersion() >= 3;
+#endif
+  Util::Log("INFO", "FullscreenQuad: vertex arrays %s",
+            _vertexArraySupported ? "enabled" : "not supported");
+  return _buffer != 0;
+}
+
+void FullscreenQuad::bind(GLint positionAttribute,
+                          GLint texCoordAttribute,
+                          RotationMode rotation) {
+  bind(positionAttribute, {{texCoordAttribute, rotation}});
+}
+
+void FullscreenQuad::bind(
+    GLint positionAttribute,
+    const std::vector<TexCoordAttribute>& texCoordAttributes) {
+  if (!_initialized) {
+    _init();
+  }
+  GLStateCache* glState = _context->getGLStateCache();
+  if (!_vertexArraySupported) {
+    glState->bindArrayBuffer(_buffer);
+    _setupAttributes(positionAttribute, texCoordAttributes);
+    return;
+  }
+
+  _layoutKey.clear();
+  _layoutKey.push_back(positionAttribute);
+  for (auto& attribute : texCoordAttributes) {
+    if (attribute.location >= 0) {
+      _layoutKey.push_back(attribute.location);
+      _layoutKey.push_back(attribute.rotation);
+    }
+  }
+  auto it = _vertexArrays.find(_layoutKey);
+  if (it != _vertexArrays.end()) {
+    glState->bindVertexArray(it->second);
+    return;
+  }
+
+#if !defined(GPUPIXEL_MAC)
+  GLuint vertexArray = 0;
+  CHECK_GL(glGenVertexArrays(1, &vertexArray));
+  _vertexArrays[_layoutKey] = vertexArray;
+  glState->bindVertexArray(vertexArray);
+  glState->bindArrayBuffer(_buffer);
+  _setupAttributes(positionAttribute, texCoordAttributes);
+#endif
+}
+
+void FullscreenQuad::_setupAttributes(
+    GLint positionAttribute,
+    const std::vector<TexCoordAttribute>& texCoordAttributes) {
+  GLStateCache* glState = _context->getGLStateCache();
+  if (positionAttribute >= 0) {
+    glState->enableVertexAttribArray(positionAttribute);
+    CHECK_GL(glVertexAttribPointer(positionAttribute, 2, GL_FLOAT, 0, 0, 0));
+  }
+  for (auto& attribute : texCoordAttributes) {
+    if (attribute.location < 0) {
+      continue;
+    }
+    glState->enableVertexAttribArray(attribute.location);
+    CHECK_GL(glVertexAttribPointer(
+        attribute.location, 2, GL_FLOAT, 0, 0,
+        (const GLvoid*)getTexCoordOffset(attribute.rotation)));
+  }
+}
+
+bool FullscreenQuad::isVertexArraySupported() {
+  if (!_initialized) {
+    _init();
+  }
+  return _vertexArraySupported;
+}
+
+void FullscreenQuad::draw() {
+  CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+}
+
+void FullscreenQuad::unbind() {
+  GLStateCache* glState = _context->getGLStateCache();
+  if (_vertexArraySupported) {
+    glState->bindVertexArray(0);
+  }
+  glState->bindArrayBuffer(0);
+}
+
+const GLfloat* FullscreenQuad::getTextureCoordinates(RotationMode rotation) {
+  static const GLfloat noRotationTextureCoordinates[] = {
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+  };
+
+  static const GLfloat rotateLeftTextureCoordinates[] = {
+    1.0f, 0.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    0.0f, 1.0f,
+  };
+
+  static const GLfloat rotateRightTextureCoordinates[] = {
+    0.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 1.0f,
+    1.0f, 0.0f,
+  };
+
+  static const GLfloat verticalFlipTextureCoordinates[] = {
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+  };
+
+  static const GLfloat horizontalFlipTextureCoordinates[] = {
+    1.0f, 0.0f,
+    0.0f, 0.0f,
+    1.0f, 1.0f,
+    0.0f, 1.0f,
+  };
+
+  static const GLfloat rotateRightVerticalFlipTextureCoordinates[] = {
+    0.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 0.0f,
+    1.0f, 1.0f,
+  };
+
+  static const GLfloat rotateRightHorizontalFlipTextureCoordinates[] = {
+    1.0f, 1.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    0.0f, 0.0f,
+  };
+
+  static const GLfloat rotate180TextureCoordinates[] = {
+    1.0f, 1.0f,
+    0.0f, 1.0f,
+    1.0f, 0.0f,
+    0.0f, 0.0f,
+  };
+
+  switch (rotation) {
+    case RotateLeft:
+      return rotateLeftTextureCoordinates;
+    case RotateRight:
+      return rotateRightTextureCoordinates;
+    case FlipVertical:
+      return verticalFlipTextureCoordinates;
+    case FlipHorizontal:
+      return horizontalFlipTextureCoordinates;
+    case RotateRightFlipVertical:
+      return rotateRightVerticalFlipTextureCoordinates;
+    case RotateRightFlipHorizontal:
+      return rotateRightHorizontalFlipTextureCoordinates;
+    case Rotate180:
+      return rotate180TextureCoordinates;
+    case NoRotation:
+    default:
+      return noRotationTextureCoordinates;
+  }
+}
+
+NS_GPUPIXEL_END
@@ -0,0 +1,68 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "gpupixel_macros.h"
+#include "target.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+
+// The quad every fullscreen pass draws, owned by the context. Its positions
+// and the texture coordinates of all rotations live in one static vertex
+// buffer, so no vertex data is copied on a draw.
+//
+// Where the context has vertex array objects the setup of each attribute
+// layout is recorded once and shared by the programs using it, a pass is then
+// a bind and a draw. Otherwise the attributes are pointed into the buffer on
+// every bind. Code drawing from client memory has to call unbind() first.
+class GPUPIXEL_API FullscreenQuad {
+ public:
+  struct TexCoordAttribute {
+    GLint location;
+    RotationMode rotation;
+  };
+
+  FullscreenQuad(GPUPixelContext* context);
+  ~FullscreenQuad();
+
+  // feeds |positionAttribute| and the texture coordinates of each input,
+  // attributes with a location of -1 are skipped
+  void bind(GLint positionAttribute,
+            const std::vector<TexCoordAttribute>& texCoordAttributes);
+  void bind(GLint positionAttribute,
+            GLint texCoordAttribute,
+            RotationMode rotation);
+  // draws the bound quad as a triangle strip
+  void draw();
+  void unbind();
+
+  // for passes keeping vertex arrays of their own
+  bool isVertexArraySupported();
+
+  static const GLfloat* getTextureCoordinates(RotationMode rotation);
+
+ private:
+  bool _init();
+  void _setupAttributes(
+      GLint positionAttribute,
+      const std::vector<TexCoordAttribute>& texCoordAttributes);
+
+  GPUPixelContext* _context;
+  bool _initialized;
+  bool _vertexArraySupported;
+  GLuint _buffer;
+  // one vertex array per attribute layout, keyed by the position location
+  // followed by the location and rotation of each texture coordinate
+  std::map<std::vector<GLint>, GLuint> _vertexArrays;
+  std::vector<GLint> _layoutKey;
+};
+
+NS_GPUPIXEL_END
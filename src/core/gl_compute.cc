@@ -0,0 +1,212 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "gl_compute.h"
+#include "gl_program.h"
+#include "gpupixel_context.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+static const GLenum kGLWriteOnly = 0x88B9;
+static const GLbitfield kGLTextureFetchBarrierBit = 0x00000008;
+static const GLbitfield kGLTextureUpdateBarrierBit = 0x00000100;
+static const GLbitfield kGLFramebufferBarrierBit = 0x00000400;
+
+GLCompute::GLCompute(GPUPixelContext* context)
+    : _context(context),
+      _enabled(true),
+      _supported(0),
+      _dispatchCompute(nullptr),
+      _bindImageTexture(nullptr),
+      _memoryBarrier(nullptr) {}
+
+void GLCompute::setEnabled(bool enabled) {
+  _enabled = enabled;
+}
+
+bool GLCompute::isAvailable() {
+  if (!isEnabled()) {
+    return false;
+  }
+  if (_supported == 0) {
+    _supported = _init() ? 1 : -1;
+    Util::Log("INFO", "GLCompute: compute shaders %s",
+              _supported > 0 ? "enabled" : "not supported");
+  }
+  return _supported > 0;
+}
+
+bool GLCompute::_init() {
+#if defined(GPUPIXEL_ANDROID) || defined(GPUPIXEL_WIN) || \
+    defined(GPUPIXEL_LINUX)
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+#if defined(GPUPIXEL_ANDROID)
+  if (!(major > 3 || (major == 3 && minor >= 1))) {
+    return false;
+  }
+#else
+  if (!(major > 4 || (major == 4 && minor >= 3))) {
+    return false;
+  }
+#endif
+  _dispatchCompute =
+      (DispatchComputeProc)_context->getProcAddress("glDispatchCompute");
+  _bindImageTexture =
+      (BindImageTextureProc)_context->getProcAddress("glBindImageTexture");
+  _memoryBarrier =
+      (MemoryBarrierProc)_context->getProcAddress("glMemoryBarrier");
+  return _dispatchCompute && _bindImageTexture && _memoryBarrier;
+#else
+  // the Apple GL implementations stop before compute shaders
+  return false;
+#endif
+}
+
+std::string GLCompute::getImageFormat(const TextureAttributes& attributes) {
+#if defined(GPUPIXEL_ANDROID)
+  // GLES 3.1 binds textures of immutable storage only
+  if (!attributes.immutable) {
+    return "";
+  }
+  switch (attributes.internalFormat) {
+    case GL_RGBA8:
+      return "rgba8";
+    case GL_RGBA16F:
+      return "rgba16f";
+    case GL_RGBA32F:
+      return "rgba32f";
+    default:
+      return "";
+  }
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  switch (attributes.internalFormat) {
+    case GL_RGBA8:
+      return "rgba8";
+    case GL_RGBA16F:
+      return "rgba16f";
+    case GL_RGBA32F:
+      return "rgba32f";
+    case GL_R8:
+      return "r8";
+    case GL_RG8:
+      return "rg8";
+    default:
+      return "";
+  }
+#else
+  return "";
+#endif
+}
+
+TextureAttributes GLCompute::getImageTextureAttributes(
+    const TextureAttributes& attributes) {
+  TextureAttributes imageAttributes = attributes;
+#if defined(GPUPIXEL_ANDROID) || defined(GPUPIXEL_WIN) || \
+    defined(GPUPIXEL_LINUX)
+  // images need a sized format, GL_RGBA leaves the size to the driver
+  if (attributes.internalFormat == GL_RGBA &&
+      attributes.type == GL_UNSIGNED_BYTE) {
+    imageAttributes.internalFormat = GL_RGBA8;
+  }
+#if defined(GPUPIXEL_ANDROID)
+  if (attributes.internalFormat == GL_R8 ||
+      attributes.internalFormat == GL_RG8) {
+    imageAttributes.internalFormat = GL_RGBA8;
+    imageAttributes.format = GL_RGBA;
+  }
+  imageAttributes.immutable = true;
+#endif
+#endif
+  return imageAttributes;
+}
+
+std::string GLCompute::generateLineShaderString(
+    const std::string& imageFormat,
+    const std::string& tileType,
+    const std::string& read,
+    const std::string& declarations,
+    const std::string& body,
+    const std::string& output) {
+#if defined(GPUPIXEL_ANDROID)
+  const std::string version = "#version 310 es\n";
+#else
+  const std::string version = "#version 430\n";
+#endif
+  return version +
+         Util::str_format(
+             "layout(local_size_x = %d) in;\n"
+             "uniform highp sampler2D inputImageTexture;\n"
+             "layout(%s, binding = 0) writeonly uniform highp image2D "
+             "outputImage;\n"
+             "// 0 along the rows, 1 along the columns\n"
+             "uniform int lineAxis;\n"
+             "uniform int lineApron;\n"
+             "%s"
+             "shared %s tile[%d];\n"
+             "%s readTexel(ivec2 texel) {\n"
+             "  return %s;\n"
+             "}\n"
+             "void main() {\n"
+             "  ivec2 size = textureSize(inputImageTexture, 0);\n"
+             "  int lineSize = lineAxis == 0 ? size.x : size.y;\n"
+             "  int line = int(gl_WorkGroupID.y);\n"
+             "  int start = int(gl_WorkGroupID.x) * %d - lineApron;\n"
+             "  // past the edges the outermost texels repeat, as clamped\n"
+             "  // texture reads would\n"
+             "  for (int i = int(gl_LocalInvocationID.x);\n"
+             "       i < %d + 2 * lineApron; i += %d) {\n"
+             "    int index = clamp(start + i, 0, lineSize - 1);\n"
+             "    tile[i] = readTexel(lineAxis == 0 ? ivec2(index, line)\n"
+             "                                      : ivec2(line, index));\n"
+             "  }\n"
+             "  barrier();\n"
+             "  int position = int(gl_GlobalInvocationID.x);\n"
+             "  if (position >= lineSize) {\n"
+             "    return;\n"
+             "  }\n"
+             "  int center = int(gl_LocalInvocationID.x) + lineApron;\n"
+             "%s"
+             "  imageStore(outputImage,\n"
+             "             lineAxis == 0 ? ivec2(position, line)\n"
+             "                           : ivec2(line, position),\n"
+             "             %s);\n"
+             "}\n",
+             kLineTileSize, imageFormat.c_str(), declarations.c_str(),
+             tileType.c_str(), kLineTileSize + 2 * kMaxLineApron,
+             tileType.c_str(), read.c_str(), kLineTileSize, kLineTileSize,
+             kLineTileSize, body.c_str(), output.c_str());
+}
+
+void GLCompute::dispatchLines(GLProgram* program,
+                              Framebuffer* input,
+                              Framebuffer* output,
+                              bool alongWidth,
+                              int apron) {
+  _context->setActiveShaderProgram(program);
+  _context->getGLStateCache()->bindTexture(0, input->getTexture());
+  program->setUniformValue("inputImageTexture", 0);
+  program->setUniformValue("lineAxis", alongWidth ? 0 : 1);
+  program->setUniformValue("lineApron", apron);
+  CHECK_GL(_bindImageTexture(0, output->getTexture(), 0, GL_FALSE, 0,
+                             kGLWriteOnly,
+                             output->getTextureAttributes().internalFormat));
+
+  int lineSize = alongWidth ? output->getWidth() : output->getHeight();
+  int lines = alongWidth ? output->getHeight() : output->getWidth();
+  CHECK_GL(_dispatchCompute((lineSize + kLineTileSize - 1) / kLineTileSize,
+                            lines, 1));
+  // the passes after it sample the output, render to it or read it back
+  CHECK_GL(_memoryBarrier(kGLTextureFetchBarrierBit |
+                          kGLTextureUpdateBarrierBit |
+                          kGLFramebufferBarrierBit));
+}
+
+NS_GPUPIXEL_END
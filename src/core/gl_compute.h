@@ -0,0 +1,91 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <string>
+#include "framebuffer.h"
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+class GLProgram;
+
+// Compute passes of a context, owned by it. A line pass runs a work group
+// per kLineTileSize texels of a row or column of the image. The group loads
+// its texels and up to kMaxLineApron on either side into shared memory
+// once, and every output is computed from there, where a fragment shader
+// would read the texture for each tap.
+//
+// Needs GL 4.3 or GLES 3.1, elsewhere isAvailable() is false and filters
+// keep their fragment shaders. Enabled by default.
+class GPUPIXEL_API GLCompute {
+ public:
+  static const int kLineTileSize = 128;
+  static const int kMaxLineApron = 64;
+
+  GLCompute(GPUPixelContext* context);
+
+  // any thread, takes effect with the next pass
+  void setEnabled(bool enabled);
+  bool isEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+  // render thread, enabled and supported by the context
+  bool isAvailable();
+
+  // The layout qualifier of the image a texture of |attributes| is written
+  // as, empty when the compute shaders can't write it.
+  static std::string getImageFormat(const TextureAttributes& attributes);
+  // |attributes| turned into ones getImageFormat() accepts. GLES 3.1 has no
+  // image format of one or two 8 bit channels, those become RGBA8 there.
+  static TextureAttributes getImageTextureAttributes(
+      const TextureAttributes& attributes);
+
+  // A line pass writing images of |imageFormat|. The tile holds values of
+  // |tileType| read from "texel" by |read|. |body| sets "result" of
+  // |tileType| from tile[center + i], i within +-lineApron, and |output|
+  // is the vec4 written from it. |declarations| go before main().
+  static std::string generateLineShaderString(const std::string& imageFormat,
+                                              const std::string& tileType,
+                                              const std::string& read,
+                                              const std::string& declarations,
+                                              const std::string& body,
+                                              const std::string& output);
+  // render thread. Runs the line pass |program| over the rows, or the
+  // columns without |alongWidth|, of |input| into |output| of its size.
+  // The passes after it see the writes.
+  void dispatchLines(GLProgram* program,
+                     Framebuffer* input,
+                     Framebuffer* output,
+                     bool alongWidth,
+                     int apron);
+
+ private:
+  typedef void(GPUPIXEL_GL_APIENTRY* DispatchComputeProc)(GLuint groupsX,
+                                                          GLuint groupsY,
+                                                          GLuint groupsZ);
+  typedef void(GPUPIXEL_GL_APIENTRY* BindImageTextureProc)(GLuint unit,
+                                                           GLuint texture,
+                                                           GLint level,
+                                                           GLboolean layered,
+                                                           GLint layer,
+                                                           GLenum access,
+                                                           GLenum format);
+  typedef void(GPUPIXEL_GL_APIENTRY* MemoryBarrierProc)(GLbitfield barriers);
+
+  bool _init();
+
+  GPUPixelContext* _context;
+  std::atomic<bool> _enabled;
+  // 0 unknown, 1 supported, -1 unsupported
+  int _supported;
+  DispatchComputeProc _dispatchCompute;
+  BindImageTextureProc _bindImageTexture;
+  MemoryBarrierProc _memoryBarrier;
+};
+
+NS_GPUPIXEL_END
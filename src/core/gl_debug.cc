@@ -0,0 +1,186 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "gl_debug.h"
+#include "gpupixel_context.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// KHR_debug, not in the headers of every platform
+static const GLenum kGLDebugOutput = 0x92E0;
+static const GLenum kGLDebugOutputSynchronous = 0x8242;
+static const GLenum kGLDebugTypeError = 0x824C;
+static const GLenum kGLDebugSeverityHigh = 0x9146;
+static const GLenum kGLDebugSeverityNotification = 0x826B;
+
+typedef void(GPUPIXEL_GL_APIENTRY* GLDebugProc)(GLenum source,
+                                                GLenum type,
+                                                GLuint id,
+                                                GLenum severity,
+                                                GLsizei length,
+                                                const GLchar* message,
+                                                const void* userParam);
+typedef void(GPUPIXEL_GL_APIENTRY* GLDebugMessageCallbackProc)(
+    GLDebugProc callback,
+    const void* userParam);
+
+#if defined(NDEBUG)
+std::atomic<int> GLDebug::_checkMode(GLDebug::CheckPerFrame);
+#else
+std::atomic<int> GLDebug::_checkMode(GLDebug::CheckPerCall);
+#endif
+
+static const char* getErrorString(GLenum error) {
+  switch (error) {
+    case GL_INVALID_ENUM:
+      return "GL_INVALID_ENUM";
+    case GL_INVALID_VALUE:
+      return "GL_INVALID_VALUE";
+    case GL_INVALID_OPERATION:
+      return "GL_INVALID_OPERATION";
+#if defined(GL_INVALID_FRAMEBUFFER_OPERATION)
+    case GL_INVALID_FRAMEBUFFER_OPERATION:
+      return "GL_INVALID_FRAMEBUFFER_OPERATION";
+#endif
+    case GL_OUT_OF_MEMORY:
+      return "GL_OUT_OF_MEMORY";
+    default:
+      return "";
+  }
+}
+
+struct GLDebugCallback {
+  static void GPUPIXEL_GL_APIENTRY onMessage(GLenum /*source*/,
+                                             GLenum type,
+                                             GLuint /*id*/,
+                                             GLenum severity,
+                                             GLsizei /*length*/,
+                                             const GLchar* message,
+                                             const void* userParam) {
+    GLDebug* debug = (GLDebug*)userParam;
+    if (debug && message) {
+      debug->_onDebugMessage(type, severity, message);
+    }
+  }
+};
+
+void GLDebug::setCheckMode(CheckMode mode) {
+  _checkMode = mode;
+}
+
+GLDebug::CheckMode GLDebug::getCheckMode() {
+  return (CheckMode)_checkMode.load();
+}
+
+bool GLDebug::checkError(const char* function, const char* file, int line) {
+  bool clean = true;
+  // several flags may be set, and a lost context keeps reporting
+  for (int i = 0; i < 8; ++i) {
+    GLenum error = glGetError();
+    if (error == GL_NO_ERROR) {
+      break;
+    }
+    clean = false;
+    Util::Log("ERROR",
+              "GL ERROR 0x%04X %s in func:%s(), in file:%s, at line %i", error,
+              getErrorString(error), function, file, line);
+  }
+  return clean;
+}
+
+GLDebug::GLDebug(GPUPixelContext* context)
+    : _context(context),
+      _currentPass(nullptr),
+      _frame(0),
+      _appliedMode(-1),
+      _debugOutput(0) {}
+
+void GLDebug::applyCheckMode() {
+  int mode = _checkMode.load();
+  if (mode == _appliedMode) {
+    return;
+  }
+  _appliedMode = mode;
+  if (_debugOutput == 0) {
+    _debugOutput = _installDebugCallback() ? 1 : -1;
+  }
+  if (_debugOutput < 0) {
+    return;
+  }
+  if (mode == CheckOff) {
+    glDisable(kGLDebugOutput);
+    return;
+  }
+  glEnable(kGLDebugOutput);
+  // synchronous reports arrive inside the failing call, at a cost
+  if (mode == CheckPerCall) {
+    glEnable(kGLDebugOutputSynchronous);
+  } else {
+    glDisable(kGLDebugOutputSynchronous);
+  }
+}
+
+void GLDebug::endFrame() {
+  applyCheckMode();
+  if (_appliedMode == CheckPerFrame) {
+    for (int i = 0; i < 8; ++i) {
+      GLenum error = glGetError();
+      if (error == GL_NO_ERROR) {
+        break;
+      }
+      // the callback has already named the pass
+      if (_debugOutput < 0) {
+        Util::Log("ERROR", "GL ERROR 0x%04X %s in frame %llu, last pass %s",
+                  error, getErrorString(error), (unsigned long long)_frame,
+                  _currentPass ? _currentPass : "unknown");
+      }
+    }
+  }
+  _currentPass = nullptr;
+  _frame++;
+}
+
+bool GLDebug::_installDebugCallback() {
+  GLDebugMessageCallbackProc debugMessageCallback = nullptr;
+#if defined(GPUPIXEL_ANDROID)
+  if (_context->hasExtension("GL_KHR_debug")) {
+    debugMessageCallback = (GLDebugMessageCallbackProc)
+        _context->getProcAddress("glDebugMessageCallbackKHR");
+  }
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (major > 4 || (major == 4 && minor >= 3) ||
+      _context->hasExtension("GL_KHR_debug")) {
+    debugMessageCallback = (GLDebugMessageCallbackProc)
+        _context->getProcAddress("glDebugMessageCallback");
+  }
+#endif
+  if (!debugMessageCallback) {
+    Util::Log("INFO", "GLDebug: KHR_debug not available, using glGetError");
+    return false;
+  }
+  debugMessageCallback(GLDebugCallback::onMessage, this);
+  return true;
+}
+
+void GLDebug::_onDebugMessage(GLenum type,
+                              GLenum severity,
+                              const char* message) {
+  if (severity == kGLDebugSeverityNotification) {
+    return;
+  }
+  bool error = type == kGLDebugTypeError || severity == kGLDebugSeverityHigh;
+  Util::Log(error ? "ERROR" : "WARNING", "GL DEBUG %s (pass %s, frame %llu)",
+            message, _currentPass ? _currentPass : "unknown",
+            (unsigned long long)_frame);
+}
+
+NS_GPUPIXEL_END
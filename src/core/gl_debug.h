@@ -0,0 +1,62 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+
+// GL error reporting of a context. How often glGetError() runs is a process
+// wide mode: every CHECK_GL in CheckPerCall, once at the end of each frame in
+// CheckPerFrame, never in CheckOff. glGetError() stalls the pipeline on many
+// drivers, release builds default to CheckPerFrame.
+//
+// Where the context has KHR_debug the driver reports errors itself through a
+// callback naming the pass and frame, unless checking is off. The callback is
+// synchronous in CheckPerCall mode only.
+class GPUPIXEL_API GLDebug {
+ public:
+  enum CheckMode { CheckOff = 0, CheckPerFrame, CheckPerCall };
+
+  static void setCheckMode(CheckMode mode);
+  static CheckMode getCheckMode();
+  static bool isCheckingPerCall() {
+    return _checkMode.load(std::memory_order_relaxed) == CheckPerCall;
+  }
+  // logs and clears the pending GL errors, false when there were any
+  static bool checkError(const char* function, const char* file, int line);
+
+  GLDebug(GPUPixelContext* context);
+
+  // names the pass whose GL calls follow in reports, |name| must stay valid
+  void setCurrentPass(const char* name) { _currentPass = name; }
+  // follows mode changes with the debug output, on the thread of the context
+  void applyCheckMode();
+  // checks for errors in CheckPerFrame mode and starts the next frame
+  void endFrame();
+  uint64_t getFrameCount() const { return _frame; }
+
+ private:
+  bool _installDebugCallback();
+  void _onDebugMessage(GLenum type, GLenum severity, const char* message);
+  friend struct GLDebugCallback;
+
+  static std::atomic<int> _checkMode;
+
+  GPUPixelContext* _context;
+  const char* _currentPass;
+  uint64_t _frame;
+  int _appliedMode;
+  // 0 unknown, 1 installed, -1 unavailable
+  int _debugOutput;
+};
+
+NS_GPUPIXEL_END
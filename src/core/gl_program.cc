@@ -12,36 +12,27 @@
 
 NS_GPUPIXEL_BEGIN
 
-std::vector<GLProgram*> GLProgram::_programs;
-
-GLProgram::GLProgram() : _program(-1) {
-  _programs.push_back(this);
-}
+GLProgram::GLProgram()
+    : _context(GPUPixelContext::getInstance()),
+      _object(nullptr),
+      _program(-1),
+      _revision(0) {}
 
 GLProgram::~GLProgram() {
-  GPUPixelContext::getInstance()->runSync([=] {
-    std::vector<GLProgram*>::iterator itr =
-        std::find(_programs.begin(), _programs.end(), this);
-    if (itr != _programs.end()) {
-      _programs.erase(itr);
-    }
-
-    bool bDeleteProgram = (_program != -1);
-
-    for (auto const& program : _programs) {
-      if (bDeleteProgram) {
-        if (_program == program->getID()) {
-          bDeleteProgram = false;
-          break;
-        }
-      }
-    }
+  _context->runSync([=] { _releaseObject(); });
+}
 
-    if (bDeleteProgram) {
-      glDeleteProgram(_program);
-      _program = -1;
-    }
-  });
+void GLProgram::_releaseObject() {
+  if (!_object) {
+    return;
+  }
+  if (_object->uniformOwner == this) {
+    _object->uniformOwner = nullptr;
+  }
+  _context->getProgramCache()->release(_object);
+  _object = nullptr;
+  _program = -1;
+  _uniformValues.clear();
 }
 
 GLProgram* GLProgram::createByShaderString(
@@ -57,143 +48,224 @@ GLProgram* GLProgram::createByShaderString(
   return ret;
 }
 
+GLProgram* GLProgram::createByComputeShaderString(
+    const std::string& computeShaderSource) {
+  return createByShaderString("", computeShaderSource);
+}
+
 bool GLProgram::_initWithShaderString(const std::string& vertexShaderSource,
                                       const std::string& fragmentShaderSource) {
-  if (_program != -1) {
-    CHECK_GL(glDeleteProgram(_program));
-    _program = -1;
-  }
-  CHECK_GL(_program = glCreateProgram());
-
-  CHECK_GL(GLuint vertShader = glCreateShader(GL_VERTEX_SHADER));
-  const char* vertexShaderSourceStr = vertexShaderSource.c_str();
-  CHECK_GL(glShaderSource(vertShader, 1, &vertexShaderSourceStr, NULL));
-  CHECK_GL(glCompileShader(vertShader));
-
-  //
-  GLint compileSuccess;
-  glGetShaderiv(vertShader, GL_COMPILE_STATUS, &compileSuccess);
-  if (compileSuccess == GL_FALSE) {
-    GLchar messages[256];
-    glGetShaderInfoLog(vertShader, sizeof(messages), 0, &messages[0]);
-#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
-    NSString* messageString = [NSString stringWithUTF8String:messages];
-    NSLog(@"%@", messageString);
-#else
-
-#endif
-    gpupixel::Util::Log(
-        "ERROR", "GL ERROR GLProgram::_initWithShaderString vertex shader %s",
-        messages);
-    return -1;
-  }
-
-  CHECK_GL(GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER));
-  const char* fragmentShaderSourceStr = fragmentShaderSource.c_str();
-  CHECK_GL(glShaderSource(fragShader, 1, &fragmentShaderSourceStr, NULL));
-  CHECK_GL(glCompileShader(fragShader));
-
-  glGetShaderiv(fragShader, GL_COMPILE_STATUS, &compileSuccess);
-  if (compileSuccess == GL_FALSE) {
-    GLchar messages[256];
-    glGetShaderInfoLog(fragShader, sizeof(messages), 0, &messages[0]);
-#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
-    NSString* messageString = [NSString stringWithUTF8String:messages];
-    NSLog(@"%@", messageString);
-#else
-
-#endif
-    gpupixel::Util::Log(
-        "ERROR", "GL ERROR GLProgram::_initWithShaderString frag shader %s",
-        messages);
-    return -1;
-  }
-
-  CHECK_GL(glAttachShader(_program, vertShader));
-  CHECK_GL(glAttachShader(_program, fragShader));
-
-  CHECK_GL(glLinkProgram(_program));
-
-  CHECK_GL(glDeleteShader(vertShader));
-  CHECK_GL(glDeleteShader(fragShader));
-
-  return true;
+  _releaseObject();
+  _object = _context->getProgramCache()->acquire(vertexShaderSource,
+                                                 fragmentShaderSource);
+  _program = _object->id;
+  return _object->linked;
 }
 
 void GLProgram::use() {
-  CHECK_GL(glUseProgram(_program));
+  _context->getGLStateCache()->useProgram(_program);
+  if (_object->uniformOwner == this) {
+    return;
+  }
+  // another GLProgram on the same sources used the program last
+  _object->uniformOwner = this;
+  for (auto it = _object->uniformValues.begin();
+       it != _object->uniformValues.end();) {
+    // a value it set that this GLProgram never did goes back to the default
+    if (_uniformValues.find(it->first) == _uniformValues.end() &&
+        std::any_of(it->second.begin(), it->second.end(),
+                    [](uint8_t byte) { return byte != 0; })) {
+      _resetUniform(it->first);
+      it = _object->uniformValues.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  for (auto& it : _uniformValues) {
+    if (_object->uniformValues[it.first] != it.second.data) {
+      _uploadUniform(it.first, it.second);
+    }
+  }
 }
 
 GLuint GLProgram::getAttribLocation(const std::string& attribute) {
-  return glGetAttribLocation(_program, attribute.c_str());
+  auto it = _object->attribLocations.find(attribute);
+  if (it != _object->attribLocations.end()) {
+    return it->second;
+  }
+  // not active in the program, remember the miss as well
+  GLint location = glGetAttribLocation(_program, attribute.c_str());
+  _object->attribLocations[attribute] = location;
+  return location;
 }
 
 GLuint GLProgram::getUniformLocation(const std::string& uniformName) {
-  return glGetUniformLocation(_program, uniformName.c_str());
+  auto it = _object->uniformLocations.find(uniformName);
+  if (it != _object->uniformLocations.end()) {
+    return it->second;
+  }
+  // array elements other than [0] and names missing from the program
+  GLint location = glGetUniformLocation(_program, uniformName.c_str());
+  _object->uniformLocations[uniformName] = location;
+  return location;
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName, int value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value);
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName, float value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value);
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName, Matrix4 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value);
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName, Vector2 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value);
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName, Matrix3 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value);
 }
 
 void GLProgram::setUniformValue(const std::string& uniformName,
                                 const void* value,
                                 int length) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
   setUniformValue(getUniformLocation(uniformName), value, length);
 }
 
 void GLProgram::setUniformValue(int uniformLocation, int value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniform1i(uniformLocation, value));
+  _setUniform(uniformLocation, UniformInt, &value, sizeof(value));
 }
 
 void GLProgram::setUniformValue(int uniformLocation, float value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniform1f(uniformLocation, value));
+  _setUniform(uniformLocation, UniformFloat, &value, sizeof(value));
 }
 
 void GLProgram::setUniformValue(int uniformLocation, Matrix4 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, (GLfloat*)&value));
+  _setUniform(uniformLocation, UniformMatrix4, &value, sizeof(value));
 }
 
 void GLProgram::setUniformValue(int uniformLocation, Vector2 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniform2f(uniformLocation, value.x, value.y));
+  _setUniform(uniformLocation, UniformVector2, &value, sizeof(value));
 }
 
 void GLProgram::setUniformValue(int uniformLocation, Matrix3 value) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, (GLfloat*)&value));
+  _setUniform(uniformLocation, UniformMatrix3, &value, sizeof(value));
 }
 
 void GLProgram::setUniformValue(int uniformLocation,
                                 const void* value,
                                 int length) {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(this);
-  CHECK_GL(glUniform1fv(uniformLocation, length, (GLfloat*)value));
+  _setUniform(uniformLocation, UniformFloatArray, value,
+              length * sizeof(GLfloat), length);
+}
+
+void GLProgram::_setUniform(int uniformLocation,
+                            UniformType type,
+                            const void* value,
+                            size_t size,
+                            int count /* = 1*/) {
+  if (uniformLocation < 0) {
+    return;
+  }
+  UniformValue& uniformValue = _uniformValues[uniformLocation];
+  const uint8_t* bytes = (const uint8_t*)value;
+  if (uniformValue.data.size() != size ||
+      !std::equal(bytes, bytes + size, uniformValue.data.begin())) {
+    _revision++;
+  }
+  uniformValue.type = type;
+  uniformValue.count = count;
+  uniformValue.data.assign(bytes, bytes + size);
+  if (_object->uniformOwner == this &&
+      _object->uniformValues[uniformLocation] == uniformValue.data) {
+    return;
+  }
+  // loads the values of this GLProgram, the new one among them
+  _context->setActiveShaderProgram(this);
+  if (_object->uniformValues[uniformLocation] != uniformValue.data) {
+    _uploadUniform(uniformLocation, uniformValue);
+  }
+}
+
+void GLProgram::_resetUniform(int uniformLocation) {
+  auto it = _object->uniformTypes.find(uniformLocation);
+  if (it == _object->uniformTypes.end()) {
+    return;
+  }
+  GLenum type = it->second.first;
+  GLsizei count = it->second.second;
+  // zero, the default of uniforms the shaders never initialize
+  std::vector<uint8_t> zeros(16 * sizeof(GLfloat) * count, 0);
+  const GLfloat* floats = (const GLfloat*)zeros.data();
+  const GLint* ints = (const GLint*)zeros.data();
+  switch (type) {
+    case GL_FLOAT:
+      CHECK_GL(glUniform1fv(uniformLocation, count, floats));
+      break;
+    case GL_FLOAT_VEC2:
+      CHECK_GL(glUniform2fv(uniformLocation, count, floats));
+      break;
+    case GL_FLOAT_VEC3:
+      CHECK_GL(glUniform3fv(uniformLocation, count, floats));
+      break;
+    case GL_FLOAT_VEC4:
+      CHECK_GL(glUniform4fv(uniformLocation, count, floats));
+      break;
+    case GL_FLOAT_MAT2:
+      CHECK_GL(glUniformMatrix2fv(uniformLocation, count, GL_FALSE, floats));
+      break;
+    case GL_FLOAT_MAT3:
+      CHECK_GL(glUniformMatrix3fv(uniformLocation, count, GL_FALSE, floats));
+      break;
+    case GL_FLOAT_MAT4:
+      CHECK_GL(glUniformMatrix4fv(uniformLocation, count, GL_FALSE, floats));
+      break;
+    case GL_INT_VEC2:
+    case GL_BOOL_VEC2:
+      CHECK_GL(glUniform2iv(uniformLocation, count, ints));
+      break;
+    case GL_INT_VEC3:
+    case GL_BOOL_VEC3:
+      CHECK_GL(glUniform3iv(uniformLocation, count, ints));
+      break;
+    case GL_INT_VEC4:
+    case GL_BOOL_VEC4:
+      CHECK_GL(glUniform4iv(uniformLocation, count, ints));
+      break;
+    default:
+      // int, bool and the samplers
+      CHECK_GL(glUniform1iv(uniformLocation, count, ints));
+      break;
+  }
+}
+
+void GLProgram::_uploadUniform(int uniformLocation, const UniformValue& value) {
+  const GLfloat* data = (const GLfloat*)value.data.data();
+  switch (value.type) {
+    case UniformInt:
+      CHECK_GL(glUniform1i(uniformLocation, *(const GLint*)data));
+      break;
+    case UniformFloat:
+      CHECK_GL(glUniform1f(uniformLocation, data[0]));
+      break;
+    case UniformVector2:
+      CHECK_GL(glUniform2f(uniformLocation, data[0], data[1]));
+      break;
+    case UniformMatrix3:
+      CHECK_GL(glUniformMatrix3fv(uniformLocation, 1, GL_FALSE, data));
+      break;
+    case UniformMatrix4:
+      CHECK_GL(glUniformMatrix4fv(uniformLocation, 1, GL_FALSE, data));
+      break;
+    case UniformFloatArray:
+      CHECK_GL(glUniform1fv(uniformLocation, value.count, data));
+      break;
+  }
+  _object->uniformValues[uniformLocation] = value.data;
 }
 
 NS_GPUPIXEL_END
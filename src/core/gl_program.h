@@ -10,10 +10,19 @@
 #include "gpupixel_macros.h"
 
 #include "math_toolbox.h"
-#include <vector>
+#include "program_cache.h"
+#include <cstdint>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+
+// Programs built from the same sources share one GL program, see
+// ProgramCache. Uniform values are kept per GLProgram and loaded into the
+// shared program by use(), so each GLProgram behaves as if it owned it:
+// uniforms it never set read as zero, whatever another one set them to.
 class GPUPIXEL_API GLProgram {
  public:
   GLProgram();
@@ -22,12 +31,20 @@ class GPUPIXEL_API GLProgram {
   static GLProgram* createByShaderString(
       const std::string& vertexShaderSource,
       const std::string& fragmentShaderSource);
+  // a compute program, see ProgramCache::acquireCompute()
+  static GLProgram* createByComputeShaderString(
+      const std::string& computeShaderSource);
   void use();
   GLuint getID() const { return _program; }
+  GPUPixelContext* getContext() const { return _context; }
 
+  // resolved once after linking, names missing from the program give -1
   GLuint getAttribLocation(const std::string& attribute);
   GLuint getUniformLocation(const std::string& uniformName);
 
+  // Setting a value the program already holds at the location is skipped,
+  // so is a location of -1.
+
   void setUniformValue(const std::string& uniformName, int value);
   void setUniformValue(const std::string& uniformName, float value);
   void setUniformValue(const std::string& uniformName, Vector2 value);
@@ -45,11 +62,44 @@ class GPUPIXEL_API GLProgram {
   void setUniformValue(int uniformLocation, Matrix4 value);
   void setUniformValue(int uniformLocation, const void* array, int length);
 
+  // counts the values set through this GLProgram that differ from the ones
+  // they replace, a cheap way to tell that something changed
+  uint64_t getRevision() const { return _revision; }
+
  private:
-  static std::vector<GLProgram*> _programs;
+  enum UniformType {
+    UniformInt,
+    UniformFloat,
+    UniformVector2,
+    UniformMatrix3,
+    UniformMatrix4,
+    UniformFloatArray
+  };
+  struct UniformValue {
+    UniformType type;
+    int count;
+    std::vector<uint8_t> data;
+  };
+
+  GPUPixelContext* _context;
+  ProgramObject* _object;
   GLuint _program;
+  // values set through this GLProgram, loaded into the shared program when
+  // it is used
+  std::unordered_map<GLint, UniformValue> _uniformValues;
+  uint64_t _revision;
+
   bool _initWithShaderString(const std::string& vertexShaderSource,
                              const std::string& fragmentShaderSource);
+  void _releaseObject();
+  void _setUniform(int uniformLocation,
+                   UniformType type,
+                   const void* value,
+                   size_t size,
+                   int count = 1);
+  void _uploadUniform(int uniformLocation, const UniformValue& value);
+  // back to zero, the value another GLProgram set is erased by the caller
+  void _resetUniform(int uniformLocation);
 };
 
 NS_GPUPIXEL_END
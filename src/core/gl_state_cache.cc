@@ -0,0 +1,204 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "gl_state_cache.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// a name the driver never hands out, marks state that is not known
+static const GLuint kUnknownName = (GLuint)-1;
+
+GLStateCache::GLStateCache() : _stats(), _frameStats() {
+  invalidate();
+}
+
+void GLStateCache::invalidate() {
+  _framebuffer = kUnknownName;
+  _viewport[0] = _viewport[1] = -1;
+  _viewport[2] = _viewport[3] = -1;
+  _activeUnit = -1;
+  for (int i = 0; i < kMaxTextureUnits; ++i) {
+    _textures[i] = kUnknownName;
+  }
+  _arrayBuffer = kUnknownName;
+  _vertexArray = kUnknownName;
+  _attribsKnown = 0;
+  _attribsEnabled = 0;
+  _program = kUnknownName;
+  _clearColorKnown = false;
+}
+
+bool GLStateCache::_update(bool changed) {
+  if (changed) {
+    _stats.issued++;
+  } else {
+    _stats.suppressed++;
+  }
+  return changed;
+}
+
+void GLStateCache::bindFramebuffer(GLuint framebuffer) {
+  if (_update(_framebuffer != framebuffer)) {
+    _framebuffer = framebuffer;
+    CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, framebuffer));
+  }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+  if (_update(_viewport[0] != x || _viewport[1] != y ||
+              _viewport[2] != width || _viewport[3] != height)) {
+    _viewport[0] = x;
+    _viewport[1] = y;
+    _viewport[2] = width;
+    _viewport[3] = height;
+    CHECK_GL(glViewport(x, y, width, height));
+  }
+}
+
+void GLStateCache::activeTexture(int unit) {
+  if (_update(_activeUnit != unit)) {
+    _activeUnit = unit;
+    CHECK_GL(glActiveTexture(GL_TEXTURE0 + unit));
+  }
+}
+
+void GLStateCache::bindTexture(int unit, GLuint texture) {
+  if (unit < 0 || unit >= kMaxTextureUnits) {
+    // not shadowed, leaves the active unit unknown
+    CHECK_GL(glActiveTexture(GL_TEXTURE0 + unit));
+    CHECK_GL(glBindTexture(GL_TEXTURE_2D, texture));
+    _activeUnit = -1;
+    _stats.issued += 2;
+    return;
+  }
+  if (_update(_textures[unit] != texture)) {
+    activeTexture(unit);
+    _textures[unit] = texture;
+    CHECK_GL(glBindTexture(GL_TEXTURE_2D, texture));
+  }
+}
+
+void GLStateCache::bindTexture(GLuint texture) {
+  if (_activeUnit < 0) {
+    activeTexture(0);
+  }
+  bindTexture(_activeUnit, texture);
+}
+
+void GLStateCache::bindArrayBuffer(GLuint buffer) {
+  if (_update(_arrayBuffer != buffer)) {
+    _arrayBuffer = buffer;
+    CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, buffer));
+  }
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray) {
+  if (_update(_vertexArray != vertexArray)) {
+    _vertexArray = vertexArray;
+    _attribsKnown = 0;
+#if !defined(GPUPIXEL_MAC)
+    CHECK_GL(glBindVertexArray(vertexArray));
+#endif
+  }
+}
+
+void GLStateCache::enableVertexAttribArray(GLuint index) {
+  if (index >= kMaxVertexAttribs) {
+    _stats.issued++;
+    CHECK_GL(glEnableVertexAttribArray(index));
+    return;
+  }
+  uint32_t bit = 1u << index;
+  if (_update(!(_attribsKnown & bit) || !(_attribsEnabled & bit))) {
+    _attribsKnown |= bit;
+    _attribsEnabled |= bit;
+    CHECK_GL(glEnableVertexAttribArray(index));
+  }
+}
+
+void GLStateCache::disableVertexAttribArray(GLuint index) {
+  if (index >= kMaxVertexAttribs) {
+    _stats.issued++;
+    CHECK_GL(glDisableVertexAttribArray(index));
+    return;
+  }
+  uint32_t bit = 1u << index;
+  if (_update(!(_attribsKnown & bit) || (_attribsEnabled & bit))) {
+    _attribsKnown |= bit;
+    _attribsEnabled &= ~bit;
+    CHECK_GL(glDisableVertexAttribArray(index));
+  }
+}
+
+void GLStateCache::useProgram(GLuint program) {
+  if (_update(_program != program)) {
+    _program = program;
+    CHECK_GL(glUseProgram(program));
+  }
+}
+
+void GLStateCache::clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+  if (_update(!_clearColorKnown || _clearColor[0] != r ||
+              _clearColor[1] != g || _clearColor[2] != b ||
+              _clearColor[3] != a)) {
+    _clearColorKnown = true;
+    _clearColor[0] = r;
+    _clearColor[1] = g;
+    _clearColor[2] = b;
+    _clearColor[3] = a;
+    CHECK_GL(glClearColor(r, g, b, a));
+  }
+}
+
+void GLStateCache::onTextureDeleted(GLuint texture) {
+  // the driver unbinds a deleted texture from every unit
+  for (int i = 0; i < kMaxTextureUnits; ++i) {
+    if (_textures[i] == texture) {
+      _textures[i] = 0;
+    }
+  }
+}
+
+void GLStateCache::onFramebufferDeleted(GLuint framebuffer) {
+  if (_framebuffer == framebuffer) {
+    _framebuffer = 0;
+  }
+}
+
+void GLStateCache::onProgramDeleted(GLuint program) {
+  // a deleted program stays in use until another one is, but its name may
+  // be handed out again
+  if (_program == program) {
+    _program = kUnknownName;
+  }
+}
+
+void GLStateCache::onBufferDeleted(GLuint buffer) {
+  if (_arrayBuffer == buffer) {
+    _arrayBuffer = 0;
+  }
+}
+
+void GLStateCache::onVertexArrayDeleted(GLuint vertexArray) {
+  // deleting the bound vertex array reverts to the default one
+  if (_vertexArray == vertexArray) {
+    _vertexArray = 0;
+    _attribsKnown = 0;
+  }
+}
+
+void GLStateCache::endFrame() {
+  bindFramebuffer(0);
+  _frameStats = _stats;
+  _stats.issued = 0;
+  _stats.suppressed = 0;
+  // the host may touch GL between frames
+  invalidate();
+}
+
+NS_GPUPIXEL_END
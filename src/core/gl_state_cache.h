@@ -0,0 +1,83 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+
+struct GLStateStats {
+  // calls that reached the driver
+  uint64_t issued;
+  // calls dropped because the state was already set
+  uint64_t suppressed;
+};
+
+// Shadow of the GL state the filters touch on every draw, owned by the
+// context. Only changes reach the driver. Everything in the library binds
+// framebuffers, textures, attributes and programs through it, GL code
+// outside of it has to call invalidate() afterwards.
+class GPUPIXEL_API GLStateCache {
+ public:
+  GLStateCache();
+
+  void bindFramebuffer(GLuint framebuffer);
+  void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  void activeTexture(int unit);
+  // binds a GL_TEXTURE_2D to |unit|, which becomes the active unit
+  void bindTexture(int unit, GLuint texture);
+  // binds a GL_TEXTURE_2D to the active unit
+  void bindTexture(GLuint texture);
+  void bindArrayBuffer(GLuint buffer);
+  // the enabled attributes belong to the vertex array, binding another one
+  // forgets them. Only called where vertex arrays are supported.
+  void bindVertexArray(GLuint vertexArray);
+  void enableVertexAttribArray(GLuint index);
+  void disableVertexAttribArray(GLuint index);
+  void useProgram(GLuint program);
+  void clearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a);
+
+  // deleted names may be reused by the driver, drop them from the shadow
+  void onTextureDeleted(GLuint texture);
+  void onFramebufferDeleted(GLuint framebuffer);
+  void onProgramDeleted(GLuint program);
+  void onBufferDeleted(GLuint buffer);
+  void onVertexArrayDeleted(GLuint vertexArray);
+
+  // forgets all state, the next call of each kind reaches the driver
+  void invalidate();
+
+  // restores the default framebuffer for the host, closes the counters of
+  // the frame and forgets all state
+  void endFrame();
+  GLStateStats getFrameStats() const { return _frameStats; }
+
+  static const int kMaxTextureUnits = 32;
+  static const int kMaxVertexAttribs = 32;
+
+ private:
+  bool _update(bool changed);
+
+  GLuint _framebuffer;
+  GLint _viewport[4];
+  int _activeUnit;
+  GLuint _textures[kMaxTextureUnits];
+  GLuint _arrayBuffer;
+  GLuint _vertexArray;
+  uint32_t _attribsKnown;
+  uint32_t _attribsEnabled;
+  GLuint _program;
+  GLfloat _clearColor[4];
+  bool _clearColorKnown;
+
+  GLStateStats _stats;
+  GLStateStats _frameStats;
+};
+
+NS_GPUPIXEL_END
@@ -0,0 +1,304 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "gpu_profiler.h"
+#include <algorithm>
+#include <cmath>
+#include "gpupixel_context.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// ARB_timer_query and EXT_disjoint_timer_query share the values
+static const GLenum kGLTimestamp = 0x8E28;
+static const GLenum kGLQueryResult = 0x8866;
+static const GLenum kGLQueryResultAvailable = 0x8867;
+static const GLenum kGLGPUDisjoint = 0x8FBB;
+
+// frames whose results have not arrived yet, older ones are dropped
+static const size_t kMaxPendingFrames = 4;
+static const size_t kDefaultWindowSize = 300;
+
+GPUProfiler::GPUProfiler(GPUPixelContext* context)
+    : _context(context),
+      _enabled(false),
+      _supported(0),
+      _disjointQuery(false),
+      _genQueries(nullptr),
+      _deleteQueries(nullptr),
+      _queryCounter(nullptr),
+      _getQueryObjectui64v(nullptr),
+      _windowSize(kDefaultWindowSize),
+      _frames(0) {}
+
+GPUProfiler::~GPUProfiler() {
+  if (_supported <= 0) {
+    return;
+  }
+  _context->runSync([&] {
+    _releaseQueries(_frameScopes);
+    for (auto& frame : _pendingFrames) {
+      _releaseQueries(frame);
+    }
+    if (!_freeQueries.empty()) {
+      _deleteQueries((GLsizei)_freeQueries.size(), _freeQueries.data());
+    }
+    _freeQueries.clear();
+  });
+}
+
+void GPUProfiler::setEnabled(bool enabled) {
+  _enabled = enabled;
+}
+
+void GPUProfiler::setWindowSize(int size) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _windowSize = size > 0 ? size : 1;
+  for (auto& it : _samples) {
+    it.second.window.clear();
+    it.second.next = 0;
+  }
+}
+
+bool GPUProfiler::_init() {
+  const char* suffix = "";
+#if defined(GPUPIXEL_ANDROID)
+  if (_context->hasExtension("GL_EXT_disjoint_timer_query")) {
+    suffix = "EXT";
+    _disjointQuery = true;
+  } else {
+    return false;
+  }
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (!(major > 3 || (major == 3 && minor >= 3)) &&
+      !_context->hasExtension("GL_ARB_timer_query")) {
+    return false;
+  }
+#else
+  // no timestamp queries on Apple platforms
+  return false;
+#endif
+  _genQueries = (GenQueriesProc)_context->getProcAddress(
+      Util::str_format("glGenQueries%s", suffix).c_str());
+  _deleteQueries = (DeleteQueriesProc)_context->getProcAddress(
+      Util::str_format("glDeleteQueries%s", suffix).c_str());
+  _queryCounter = (QueryCounterProc)_context->getProcAddress(
+      Util::str_format("glQueryCounter%s", suffix).c_str());
+  _getQueryObjectui64v = (GetQueryObjectui64vProc)_context->getProcAddress(
+      Util::str_format("glGetQueryObjectui64v%s", suffix).c_str());
+  return _genQueries && _deleteQueries && _queryCounter &&
+         _getQueryObjectui64v;
+}
+
+GLuint GPUProfiler::_acquireQuery() {
+  if (_freeQueries.empty()) {
+    GLuint queries[16] = {0};
+    _genQueries(16, queries);
+    _freeQueries.assign(queries, queries + 16);
+  }
+  GLuint query = _freeQueries.back();
+  _freeQueries.pop_back();
+  return query;
+}
+
+void GPUProfiler::_releaseQueries(const std::vector<Scope>& scopes) {
+  for (auto& scope : scopes) {
+    _freeQueries.push_back(scope.begin);
+    if (scope.end) {
+      _freeQueries.push_back(scope.end);
+    }
+  }
+}
+
+int GPUProfiler::beginScope(const char* name) {
+  // the warm-up frame would stand out as the slowest sample
+  if (!isEnabled() || _context->isWarmingUp) {
+    return -1;
+  }
+  if (_supported == 0) {
+    _supported = _init() ? 1 : -1;
+    Util::Log("INFO", "GPUProfiler: timer queries %s",
+              _supported > 0 ? "enabled" : "not supported");
+  }
+  if (_supported < 0) {
+    return -1;
+  }
+  Scope scope = {name, _acquireQuery(), 0};
+  _queryCounter(scope.begin, kGLTimestamp);
+  _frameScopes.push_back(scope);
+  return (int)_frameScopes.size() - 1;
+}
+
+void GPUProfiler::endScope(int scope) {
+  if (scope < 0 || scope >= (int)_frameScopes.size()) {
+    return;
+  }
+  Scope& frameScope = _frameScopes[scope];
+  frameScope.end = _acquireQuery();
+  _queryCounter(frameScope.end, kGLTimestamp);
+}
+
+void GPUProfiler::endFrame() {
+  if (_supported <= 0) {
+    return;
+  }
+  if (!_frameScopes.empty()) {
+    _pendingFrames.push_back(std::move(_frameScopes));
+    _frameScopes.clear();
+  }
+  while (_pendingFrames.size() > kMaxPendingFrames) {
+    _releaseQueries(_pendingFrames.front());
+    _pendingFrames.pop_front();
+  }
+  _collect();
+}
+
+void GPUProfiler::_collect() {
+  if (_disjointQuery && !_pendingFrames.empty()) {
+    // a frequency change or a context switch made the pending results
+    // meaningless
+    GLint disjoint = 0;
+    glGetIntegerv(kGLGPUDisjoint, &disjoint);
+    if (disjoint) {
+      for (auto& frame : _pendingFrames) {
+        _releaseQueries(frame);
+      }
+      _pendingFrames.clear();
+      return;
+    }
+  }
+
+  while (!_pendingFrames.empty()) {
+    std::vector<Scope>& frame = _pendingFrames.front();
+    // queries complete in order, the last one of the frame arrives last
+    uint64_t available = 0;
+    for (auto it = frame.rbegin(); it != frame.rend(); ++it) {
+      if (it->end) {
+        _getQueryObjectui64v(it->end, kGLQueryResultAvailable, &available);
+        break;
+      }
+    }
+    if (!available) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (auto& scope : frame) {
+      // a scope left open has no end time
+      if (!scope.end) {
+        continue;
+      }
+      uint64_t begin = 0;
+      uint64_t end = 0;
+      _getQueryObjectui64v(scope.begin, kGLQueryResult, &begin);
+      _getQueryObjectui64v(scope.end, kGLQueryResult, &end);
+      _record(scope.name, end > begin ? (end - begin) / 1e6 : 0.0);
+    }
+    _frames++;
+    lock.unlock();
+
+    _releaseQueries(frame);
+    _pendingFrames.pop_front();
+  }
+}
+
+void GPUProfiler::_record(const char* name, double ms) {
+  Samples& samples = _samples[_getReadableName(name)];
+  if (samples.window.size() < _windowSize) {
+    samples.window.push_back((float)ms);
+  } else {
+    samples.window[samples.next] = (float)ms;
+  }
+  samples.next = (samples.next + 1) % _windowSize;
+  samples.count++;
+  samples.total += ms;
+}
+
+const std::string& GPUProfiler::_getReadableName(const char* name) {
+  auto it = _readableNames.find(name);
+  if (it != _readableNames.end()) {
+    return it->second;
+  }
+  return _readableNames[name] = Util::demangle(name);
+}
+
+std::vector<GPUProfileStats> GPUProfiler::getStats() {
+  std::vector<GPUProfileStats> result;
+  std::unique_lock<std::mutex> lock(_mutex);
+  for (auto& it : _samples) {
+    const Samples& samples = it.second;
+    if (samples.window.empty()) {
+      continue;
+    }
+    std::vector<float> sorted = samples.window;
+    std::sort(sorted.begin(), sorted.end());
+    // nearest rank
+    auto percentile = [&sorted](double p) {
+      size_t rank = (size_t)std::ceil(p * sorted.size());
+      return (double)sorted[rank > 0 ? rank - 1 : 0];
+    };
+    GPUProfileStats stats;
+    stats.name = it.first;
+    stats.count = samples.count;
+    stats.meanMs = samples.total / samples.count;
+    stats.p50Ms = percentile(0.50);
+    stats.p95Ms = percentile(0.95);
+    stats.p99Ms = percentile(0.99);
+    stats.maxMs = sorted.back();
+    result.push_back(stats);
+  }
+  lock.unlock();
+  std::sort(result.begin(), result.end(),
+            [](const GPUProfileStats& a, const GPUProfileStats& b) {
+              return a.meanMs > b.meanMs;
+            });
+  return result;
+}
+
+std::string GPUProfiler::dumpJSON() {
+  std::vector<GPUProfileStats> stats = getStats();
+  uint64_t frames = 0;
+  size_t windowSize = 0;
+  {
+    std::unique_lock<std::mutex> lock(_mutex);
+    frames = _frames;
+    windowSize = _windowSize;
+  }
+  std::string json = Util::str_format("{\"frames\":%llu,\"window\":%d,",
+                                      (unsigned long long)frames,
+                                      (int)windowSize);
+  json += "\"passes\":[";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    std::string name;
+    for (char c : stats[i].name) {
+      if (c == '"' || c == '\\') {
+        name += '\\';
+      }
+      name += c;
+    }
+    json += Util::str_format(
+        "%s{\"name\":\"%s\",\"count\":%llu,\"mean_ms\":%.4f,"
+        "\"p50_ms\":%.4f,\"p95_ms\":%.4f,\"p99_ms\":%.4f,\"max_ms\":%.4f}",
+        i ? "," : "", name.c_str(), (unsigned long long)stats[i].count,
+        stats[i].meanMs, stats[i].p50Ms, stats[i].p95Ms, stats[i].p99Ms,
+        stats[i].maxMs);
+  }
+  json += "]}";
+  return json;
+}
+
+void GPUProfiler::reset() {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _samples.clear();
+  _frames = 0;
+}
+
+NS_GPUPIXEL_END
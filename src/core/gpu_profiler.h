@@ -0,0 +1,115 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+
+struct GPUProfileStats {
+  std::string name;
+  // samples recorded since the last reset, the percentiles only cover the
+  // most recent window of them
+  uint64_t count;
+  double meanMs;
+  double p50Ms;
+  double p95Ms;
+  double p99Ms;
+  double maxMs;
+};
+
+// GPU time of the passes of a context, owned by it. Each scope is bracketed
+// by two GL_TIMESTAMP queries, so scopes may nest. Results are read at the
+// end of a later frame once the driver has them, the pipeline never waits
+// for a query. Frames still pending after kMaxPendingFrames are dropped.
+//
+// Needs GL 3.3, ARB_timer_query or EXT_disjoint_timer_query, elsewhere
+// scopes cost nothing and no samples are recorded. Disabled by default.
+class GPUPIXEL_API GPUProfiler {
+ public:
+  GPUProfiler(GPUPixelContext* context);
+  ~GPUProfiler();
+
+  // any thread, takes effect with the next scope
+  void setEnabled(bool enabled);
+  bool isEnabled() const { return _enabled.load(std::memory_order_relaxed); }
+  // samples per scope the percentiles are taken over
+  void setWindowSize(int size);
+
+  // render thread. |name| must stay valid, mangled type names are
+  // demangled in the report. Returns -1 when nothing is measured.
+  int beginScope(const char* name);
+  void endScope(int scope);
+  // collects the results that have arrived and starts the next frame
+  void endFrame();
+
+  // any thread, sorted by mean time, slowest first
+  std::vector<GPUProfileStats> getStats();
+  std::string dumpJSON();
+  void reset();
+
+ private:
+  typedef void(GPUPIXEL_GL_APIENTRY* GenQueriesProc)(GLsizei n, GLuint* ids);
+  typedef void(GPUPIXEL_GL_APIENTRY* DeleteQueriesProc)(GLsizei n,
+                                                        const GLuint* ids);
+  typedef void(GPUPIXEL_GL_APIENTRY* QueryCounterProc)(GLuint id,
+                                                       GLenum target);
+  typedef void(GPUPIXEL_GL_APIENTRY* GetQueryObjectui64vProc)(
+      GLuint id,
+      GLenum pname,
+      uint64_t* params);
+
+  struct Scope {
+    const char* name;
+    GLuint begin;
+    GLuint end;
+  };
+  struct Samples {
+    std::vector<float> window;
+    size_t next = 0;
+    uint64_t count = 0;
+    double total = 0;
+  };
+
+  bool _init();
+  GLuint _acquireQuery();
+  void _collect();
+  void _releaseQueries(const std::vector<Scope>& scopes);
+  void _record(const char* name, double ms);
+  const std::string& _getReadableName(const char* name);
+
+  GPUPixelContext* _context;
+  std::atomic<bool> _enabled;
+  // 0 unknown, 1 supported, -1 unsupported
+  int _supported;
+  bool _disjointQuery;
+  GenQueriesProc _genQueries;
+  DeleteQueriesProc _deleteQueries;
+  QueryCounterProc _queryCounter;
+  GetQueryObjectui64vProc _getQueryObjectui64v;
+
+  std::vector<GLuint> _freeQueries;
+  std::vector<Scope> _frameScopes;
+  std::deque<std::vector<Scope>> _pendingFrames;
+
+  std::mutex _mutex;
+  size_t _windowSize;
+  uint64_t _frames;
+  std::map<std::string, Samples> _samples;
+  std::map<const char*, std::string> _readableNames;
+};
+
+NS_GPUPIXEL_END
@@ -13,11 +13,19 @@
 // base
 #include "framebuffer.h"
 #include "framebuffer_cache.h"
+#include "frame_graph.h"
+#include "fullscreen_quad.h"
 #include "gl_program.h"
+#include "gl_debug.h"
+#include "gl_state_cache.h"
+#include "gpu_profiler.h"
+#include "gl_compute.h"
 #include "gpupixel_context.h"
+#include "program_cache.h"
 
 // utils
 #include "math_toolbox.h"
+#include "trace.h"
 #include "util.h"
 
 // source
@@ -39,6 +47,7 @@
 // base filters
 #include "filter.h"
 #include "filter_group.h"
+#include "pointwise_filter.h"
 
 // face filters
 #include "beauty_face_filter.h"
@@ -49,6 +58,7 @@
 
 #include "box_blur_filter.h"
 #include "box_high_pass_filter.h"
+#include "box_mean_variance_filter.h"
 
 // general filters
 #include "bilateral_filter.h"
@@ -61,12 +71,14 @@
 #include "crosshatch_filter.h"
 #include "directional_non_maximum_suppression_filter.h"
 #include "directional_sobel_edge_detection_filter.h"
+#include "directional_sobel_non_maximum_suppression_filter.h"
 #include "emboss_filter.h"
 #include "exposure_filter.h"
 #include "gaussian_blur_filter.h"
 #include "gaussian_blur_mono_filter.h"
 #include "glass_sphere_filter.h"
 #include "grayscale_filter.h"
+#include "guided_filter.h"
 #include "hsb_filter.h"
 #include "halftone_filter.h"
 #include "hue_filter.h"
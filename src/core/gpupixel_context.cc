@@ -6,6 +6,7 @@
  */
 
 #include "gpupixel_context.h"
+#include <cstring>
 #include "util.h"
 
 #if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
@@ -83,25 +84,93 @@ const unsigned int VIEW_HEIGHT = 720;
 
 #endif
 
+// a couple of frames in flight, producers block beyond that
+const int kDefaultMaxPendingTasks = 3;
+
 GPUPixelContext* GPUPixelContext::_instance = 0;
 std::mutex GPUPixelContext::_mutex;
+#if defined(GPUPIXEL_ENABLE_EGL)
+GPUPixelContext::ContextBackend GPUPixelContext::_backend =
+    GPUPixelContext::ContextBackendEGL;
+#endif
+
+// context bound to the calling thread, see setCurrent(). Render threads are
+// bound to their own context.
+static thread_local GPUPixelContext* s_currentContext = nullptr;
+
+#if defined(GPUPIXEL_ANDROID) || defined(GPUPIXEL_ENABLE_EGL)
+// all contexts of the process live on one EGL display, it is only terminated
+// after the last of them has been released
+static EGLDisplay s_eglDisplay = EGL_NO_DISPLAY;
+static int s_eglDisplayRefs = 0;
+static std::mutex s_eglDisplayMutex;
+
+static void releaseSharedEGLDisplay() {
+  std::unique_lock<std::mutex> lock(s_eglDisplayMutex);
+  if (s_eglDisplayRefs > 0 && --s_eglDisplayRefs == 0) {
+    if (!eglTerminate(s_eglDisplay)) {
+      Util::Log("ERROR", "Free egldisplay Error!");
+    }
+    s_eglDisplay = EGL_NO_DISPLAY;
+  }
+}
+#endif
+
+#if defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+// glfwTerminate() destroys every window, keep glfw alive while any context
+// still uses it
+static int s_glfwRefs = 0;
+static std::mutex s_glfwMutex;
+#endif
 
-GPUPixelContext::GPUPixelContext()
-    : _curShaderProgram(0),
-      isCapturingFrame(false),
+GPUPixelContext::GPUPixelContext(GPUPixelContext* sharedContext /* = nullptr*/)
+    : isCapturingFrame(false),
       captureUpToFilter(0),
-      capturedFrameData(0) {
-  _framebufferCache = new FramebufferCache();
-  task_queue_ = std::make_shared<LocalDispatchQueue>();
+      capturedFrameData(0),
+      isWarmingUp(false),
+      _sharedContext(sharedContext),
+      _glStateCache(new GLStateCache()),
+      _glDebug(new GLDebug(this)),
+      _framebufferFormatsQueried(false),
+      _floatRenderTarget(false),
+      _framebufferFormats() {
+  _framebufferCache = std::make_shared<FramebufferCache>(this);
+  _fullscreenQuad.reset(new FullscreenQuad(this));
+  _gpuProfiler.reset(new GPUProfiler(this));
+  _glCompute.reset(new GLCompute(this));
+  _programCache.reset(new ProgramCache(this));
   init();
 }
 
 GPUPixelContext::~GPUPixelContext() {
+  // cached framebuffers delete their textures on this context
+  _framebufferCache.reset();
+  _fullscreenQuad.reset();
+  _gpuProfiler.reset();
+  _programCache.reset();
+  if (task_queue_) {
+    if (task_queue_->isQueueThread()) {
+      Util::Log("ERROR", "GPUPixelContext destroyed on its render thread!");
+    }
+    task_queue_->add([=] { clearCurrent(); });
+    task_queue_->join();
+    task_queue_.reset();
+  }
   releaseContext();
-  delete _framebufferCache;
+  if (s_currentContext == this) {
+    s_currentContext = nullptr;
+  }
+}
+
+void GPUPixelContext::setFrameGraphFusionEnabled(bool enabled) {
+  _frameGraphFusion = enabled;
+  invalidateFrameGraphs();
 }
 
 GPUPixelContext* GPUPixelContext::getInstance() {
+  if (s_currentContext) {
+    return s_currentContext;
+  }
   if (!_instance) {
     std::unique_lock<std::mutex> lock(_mutex);
     if (!_instance) {
@@ -112,39 +181,202 @@ GPUPixelContext* GPUPixelContext::getInstance() {
 };
 
 void GPUPixelContext::destroy() {
+  std::unique_lock<std::mutex> lock(_mutex);
   if (_instance) {
     delete _instance;
     _instance = 0;
   }
 }
 
+GPUPixelContext* GPUPixelContext::create(
+    GPUPixelContext* sharedContext /* = nullptr*/) {
+  return new (std::nothrow) GPUPixelContext(sharedContext);
+}
+
+void GPUPixelContext::destroy(GPUPixelContext* context) {
+  if (!context) {
+    return;
+  }
+  if (context == _instance) {
+    destroy();
+    return;
+  }
+  delete context;
+}
+
+void GPUPixelContext::setCurrent(GPUPixelContext* context) {
+  // only selects the context for new objects, GL stays on the render thread
+  s_currentContext = context;
+}
+
+GPUPixelContext* GPUPixelContext::getCurrent() {
+  return s_currentContext;
+}
+
+#if defined(GPUPIXEL_ENABLE_EGL)
+void GPUPixelContext::setContextBackend(ContextBackend backend) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (_instance) {
+    Util::Log("WARNING", "context backend must be set before getInstance()");
+    return;
+  }
+  _backend = backend;
+}
+
+GPUPixelContext::ContextBackend GPUPixelContext::getContextBackend() {
+  return _backend;
+}
+#endif
+
 void GPUPixelContext::init() {
+  Util::Log("INFO", "start init GPUPixelContext");
+#if defined(GPUPIXEL_ANDROID)
   runSync([=] {
-    Util::Log("INFO", "start init GPUPixelContext");
     this->createContext();
+    _glDebug->applyCheckMode();
   });
+#else
+  // platform contexts are created on the constructing thread, glfw windows
+  // must be, and then handed over to the render thread
+  createContext();
+  clearCurrent();
+  task_queue_ = std::make_shared<SerialDispatchQueue>(kDefaultMaxPendingTasks);
+  task_queue_->add([=] {
+    Trace::setThreadName("GPUPixel render");
+    s_currentContext = this;
+    useAsCurrent();
+    _glDebug->applyCheckMode();
+  });
+#endif
 }
 
 FramebufferCache* GPUPixelContext::getFramebufferCache() const {
-  return _framebufferCache;
+  return _framebufferCache.get();
 }
 
 void GPUPixelContext::setActiveShaderProgram(GLProgram* shaderProgram) {
-  if (_curShaderProgram != shaderProgram) {
-    _curShaderProgram = shaderProgram;
-    shaderProgram->use();
-  }
+  shaderProgram->use();
 }
 
 void GPUPixelContext::purge() {
   _framebufferCache->purge();
+  runSync([=] { _programCache->purge(); });
+}
+
+void GPUPixelContext::endFrame() {
+  _glStateCache->endFrame();
+  _gpuProfiler->endFrame();
+  _glDebug->endFrame();
+}
+
+void* GPUPixelContext::getProcAddress(const char* name) {
+#if defined(GPUPIXEL_ANDROID)
+  return (void*)eglGetProcAddress(name);
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+#if defined(GPUPIXEL_ENABLE_EGL)
+  if (_backend == ContextBackendEGL) {
+    return (void*)eglGetProcAddress(name);
+  }
+#endif
+  return (void*)glfwGetProcAddress(name);
+#else
+  return nullptr;
+#endif
+}
+
+bool GPUPixelContext::hasExtension(const char* name) {
+#if defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  GLint count = 0;
+  glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+  for (GLint i = 0; i < count; ++i) {
+    const char* extension = (const char*)glGetStringi(GL_EXTENSIONS, i);
+    if (extension && strcmp(extension, name) == 0) {
+      return true;
+    }
+  }
+  return false;
+#else
+  const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+  if (!extensions) {
+    return false;
+  }
+  size_t length = strlen(name);
+  for (const char* it = strstr(extensions, name); it;
+       it = strstr(it + length, name)) {
+    // whole words only
+    bool start = it == extensions || it[-1] == ' ';
+    bool end = it[length] == '\0' || it[length] == ' ';
+    if (start && end) {
+      return true;
+    }
+  }
+  return false;
+#endif
+}
+
+bool GPUPixelContext::isFloatRenderTargetSupported() {
+  if (!_framebufferFormatsQueried) {
+    _queryFramebufferFormats();
+  }
+  return _floatRenderTarget;
+}
+
+bool GPUPixelContext::isFramebufferFormatSupported(FramebufferFormat format) {
+  if (format < 0 || format >= FramebufferFormatCount) {
+    return false;
+  }
+  if (!_framebufferFormatsQueried) {
+    _queryFramebufferFormats();
+  }
+  return _framebufferFormats[format];
+}
+
+void GPUPixelContext::_queryFramebufferFormats() {
+  runSync([&] {
+    bool halfFloat = false;
+    // R8 and RG8 need swizzles to be read as luminance
+    bool swizzle = false;
+#if defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+    GLint major = 0;
+    GLint minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    _floatRenderTarget = major >= 3;
+    halfFloat = major >= 3;
+    swizzle = major > 3 || (major == 3 && minor >= 3) ||
+              (major == 3 && hasExtension("GL_ARB_texture_swizzle"));
+#elif defined(GPUPIXEL_ANDROID)
+    // the context asks for ES 2, drivers usually hand out ES 3
+    const char* version = (const char*)glGetString(GL_VERSION);
+    bool es3 = version && strstr(version, "OpenGL ES 3");
+    _floatRenderTarget = es3 && hasExtension("GL_EXT_color_buffer_float");
+    halfFloat = es3 && (_floatRenderTarget ||
+                        hasExtension("GL_EXT_color_buffer_half_float"));
+    swizzle = es3;
+#endif
+    // the ES 2 context of iOS and the legacy profile of macOS keep RGBA8
+    _framebufferFormats[FramebufferFormatRGBA8] = true;
+    _framebufferFormats[FramebufferFormatR8] = swizzle;
+    _framebufferFormats[FramebufferFormatRG8] = swizzle;
+    _framebufferFormats[FramebufferFormatRGBA16F] = halfFloat;
+    _framebufferFormatsQueried = true;
+  });
 }
  
 void GPUPixelContext::createContext() {
 #if defined(GPUPIXEL_IOS) 
-  _eglContext = [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+  if (_sharedContext) {
+    _eglContext = [[EAGLContext alloc]
+           initWithAPI:kEAGLRenderingAPIOpenGLES2
+            sharegroup:[_sharedContext->getEglContext() sharegroup]];
+  } else {
+    _eglContext =
+        [[EAGLContext alloc] initWithAPI:kEAGLRenderingAPIOpenGLES2];
+  }
   [EAGLContext setCurrentContext:_eglContext];
-  iosHelper = [[iOSHelper alloc] init];
+  if (!iosHelper) {
+    iosHelper = [[iOSHelper alloc] init];
+  }
 #elif defined(GPUPIXEL_MAC)
   NSOpenGLPixelFormatAttribute pixelFormatAttributes[] = {
       NSOpenGLPFADoubleBuffer,
@@ -162,8 +394,10 @@ void GPUPixelContext::createContext() {
 
   _pixelFormat =
       [[NSOpenGLPixelFormat alloc] initWithAttributes:pixelFormatAttributes];
-  imageProcessingContext =
-      [[NSOpenGLContext alloc] initWithFormat:_pixelFormat shareContext:nil];
+  imageProcessingContext = [[NSOpenGLContext alloc]
+      initWithFormat:_pixelFormat
+        shareContext:_sharedContext ? _sharedContext->getOpenGLContext()
+                                    : nil];
 
   GLint interval = 0;
   [imageProcessingContext makeCurrentContext];
@@ -177,19 +411,27 @@ void GPUPixelContext::createContext() {
   m_surfaceheight = 1;  // no use
   m_gpu_context = new _gpu_context_t;
   memset(m_gpu_context, 0, sizeof(_gpu_context_t));
-  m_gpu_context->egldisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
-  if (EGL_NO_DISPLAY == m_gpu_context->egldisplay) {
-    // err_log("eglGetDisplay Error!");
-    Util::Log("ERROR", "eglGetDisplay Error!");
-    return;
-  }
-
-  GLint majorVersion;
-  GLint minorVersion;
-  if (!eglInitialize(m_gpu_context->egldisplay, &majorVersion, &minorVersion)) {
-    // err_log("eglInitialize Error!");
-    Util::Log("ERROR", "eglInitialize Error!");
-    return;
+  {
+    std::unique_lock<std::mutex> lock(s_eglDisplayMutex);
+    if (s_eglDisplay == EGL_NO_DISPLAY) {
+      EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+      if (EGL_NO_DISPLAY == display) {
+        // err_log("eglGetDisplay Error!");
+        Util::Log("ERROR", "eglGetDisplay Error!");
+        return;
+      }
+
+      GLint majorVersion;
+      GLint minorVersion;
+      if (!eglInitialize(display, &majorVersion, &minorVersion)) {
+        // err_log("eglInitialize Error!");
+        Util::Log("ERROR", "eglInitialize Error!");
+        return;
+      }
+      s_eglDisplay = display;
+    }
+    s_eglDisplayRefs++;
+    m_gpu_context->egldisplay = s_eglDisplay;
   }
   // info_log("GL Version minor:%d major:%d", minorVersion, majorVersion);
 
@@ -216,8 +458,12 @@ void GPUPixelContext::createContext() {
   }
 
   EGLint context_attrib[] = {EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE};
+  EGLContext shareContext = EGL_NO_CONTEXT;
+  if (_sharedContext && _sharedContext->m_gpu_context) {
+    shareContext = _sharedContext->m_gpu_context->eglcontext;
+  }
   m_gpu_context->eglcontext = eglCreateContext(
-      m_gpu_context->egldisplay, eglConfig, EGL_NO_CONTEXT, context_attrib);
+      m_gpu_context->egldisplay, eglConfig, shareContext, context_attrib);
   if (EGL_NO_CONTEXT == m_gpu_context->eglcontext) {
     // err_log("eglCreateContext Error!");
     Util::Log("ERROR", "eglCreateContext Error!");
@@ -248,7 +494,24 @@ void GPUPixelContext::createContext() {
   Util::Log("INFO", "Create Surface width:%d height:%d", m_surfacewidth,
             m_surfaceheight);
 #elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
-  int ret = glfwInit();
+#if defined(GPUPIXEL_ENABLE_EGL)
+  if (_backend == ContextBackendEGL) {
+    if (!createEGLContext()) {
+      Util::Log("ERROR", "create headless EGL context failed!");
+      releaseContext();
+    }
+    return;
+  }
+#endif
+  int ret = 0;
+  {
+    std::unique_lock<std::mutex> lock(s_glfwMutex);
+    ret = glfwInit();
+    if (ret) {
+      s_glfwRefs++;
+      glfw_inited_ = true;
+    }
+  }
 
   glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
   glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
@@ -261,10 +524,12 @@ void GPUPixelContext::createContext() {
     // todo log error
     return;
   }
-  gl_context_ = glfwCreateWindow(VIEW_WIDTH, VIEW_HEIGHT, "gpupixel opengl context", NULL, NULL);
+  gl_context_ = glfwCreateWindow(
+      VIEW_WIDTH, VIEW_HEIGHT, "gpupixel opengl context", NULL,
+      _sharedContext ? _sharedContext->GetGLContext() : NULL);
   if (!gl_context_) {
     // todo log error
-    glfwTerminate();
+    releaseContext();
     return;
   }
   glfwMakeContextCurrent(gl_context_);
@@ -273,6 +538,157 @@ void GPUPixelContext::createContext() {
 #endif
 }
 
+#if defined(GPUPIXEL_ENABLE_EGL)
+bool GPUPixelContext::initEGLDisplay() {
+  std::unique_lock<std::mutex> lock(s_eglDisplayMutex);
+  if (s_eglDisplay == EGL_NO_DISPLAY) {
+    if (!openEGLDisplay()) {
+      return false;
+    }
+    s_eglDisplay = egl_display_;
+  }
+  s_eglDisplayRefs++;
+  egl_display_ = s_eglDisplay;
+  return true;
+}
+
+bool GPUPixelContext::openEGLDisplay() {
+  const char* clientExtensions =
+      eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  std::string extensions = clientExtensions ? clientExtensions : "";
+
+  auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+      "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay &&
+      extensions.find("EGL_EXT_platform_base") != std::string::npos) {
+    // Mesa: render without any window system, works with llvmpipe too
+    if (extensions.find("EGL_MESA_platform_surfaceless") != std::string::npos) {
+      egl_display_ = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, nullptr);
+      if (egl_display_ != EGL_NO_DISPLAY &&
+          eglInitialize(egl_display_, nullptr, nullptr)) {
+        Util::Log("INFO", "EGL display: surfaceless");
+        return true;
+      }
+      egl_display_ = EGL_NO_DISPLAY;
+    }
+
+    // vendor drivers expose their GPUs as EGL devices
+    auto queryDevices =
+        (PFNEGLQUERYDEVICESEXTPROC)eglGetProcAddress("eglQueryDevicesEXT");
+    if (queryDevices &&
+        extensions.find("EGL_EXT_platform_device") != std::string::npos) {
+      EGLDeviceEXT devices[16];
+      EGLint numDevices = 0;
+      if (queryDevices(16, devices, &numDevices)) {
+        for (int i = 0; i < numDevices; ++i) {
+          egl_display_ = getPlatformDisplay(EGL_PLATFORM_DEVICE_EXT,
+                                            devices[i], nullptr);
+          if (egl_display_ != EGL_NO_DISPLAY &&
+              eglInitialize(egl_display_, nullptr, nullptr)) {
+            Util::Log("INFO", "EGL display: device %d", i);
+            return true;
+          }
+        }
+      }
+      egl_display_ = EGL_NO_DISPLAY;
+    }
+  }
+
+  egl_display_ = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (egl_display_ != EGL_NO_DISPLAY &&
+      eglInitialize(egl_display_, nullptr, nullptr)) {
+    Util::Log("INFO", "EGL display: default");
+    return true;
+  }
+  egl_display_ = EGL_NO_DISPLAY;
+  return false;
+}
+
+bool GPUPixelContext::createEGLContext() {
+  if (!initEGLDisplay()) {
+    Util::Log("ERROR", "eglInitialize Error!");
+    return false;
+  }
+
+  if (!eglBindAPI(EGL_OPENGL_API)) {
+    Util::Log("ERROR", "eglBindAPI Error!");
+    return false;
+  }
+
+  const char* displayExtensions = eglQueryString(egl_display_, EGL_EXTENSIONS);
+  bool surfaceless =
+      displayExtensions &&
+      std::string(displayExtensions).find("EGL_KHR_surfaceless_context") !=
+          std::string::npos;
+
+  // all rendering goes to framebuffer objects, a pbuffer is only created
+  // when the driver can not make a context current without a surface
+  EGLint configAttribs[] = {EGL_RED_SIZE,        8,
+                            EGL_GREEN_SIZE,      8,
+                            EGL_BLUE_SIZE,       8,
+                            EGL_ALPHA_SIZE,      8,
+                            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                            EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+                            EGL_NONE};
+  if (surfaceless) {
+    // default surface type is EGL_WINDOW_BIT, accept any config instead
+    configAttribs[11] = 0;
+  }
+
+  EGLConfig eglConfig;
+  EGLint numConfigs = 0;
+  if (!eglChooseConfig(egl_display_, configAttribs, &eglConfig, 1,
+                       &numConfigs) ||
+      numConfigs < 1) {
+    Util::Log("ERROR", "eglChooseConfig Error!");
+    return false;
+  }
+
+  // same version as the glfw backend, legacy shaders need compatibility
+  EGLint contextAttribs[] = {EGL_CONTEXT_MAJOR_VERSION, 3,
+                             EGL_CONTEXT_MINOR_VERSION, 2,
+                             EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                             EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+                             EGL_NONE};
+  EGLContext shareContext =
+      _sharedContext ? _sharedContext->egl_context_ : EGL_NO_CONTEXT;
+  egl_context_ =
+      eglCreateContext(egl_display_, eglConfig, shareContext, contextAttribs);
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    egl_context_ =
+        eglCreateContext(egl_display_, eglConfig, shareContext, nullptr);
+  }
+  if (egl_context_ == EGL_NO_CONTEXT) {
+    Util::Log("ERROR", "eglCreateContext Error!");
+    return false;
+  }
+
+  if (!surfaceless) {
+    EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    egl_surface_ =
+        eglCreatePbufferSurface(egl_display_, eglConfig, pbufferAttribs);
+    if (egl_surface_ == EGL_NO_SURFACE) {
+      Util::Log("ERROR", "eglCreatePbufferSurface Error!");
+      return false;
+    }
+  }
+
+  if (!eglMakeCurrent(egl_display_, egl_surface_, egl_surface_,
+                      egl_context_)) {
+    Util::Log("ERROR", "eglMakeCurrent Error!");
+    return false;
+  }
+
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    Util::Log("ERROR", "load GL functions Error!");
+    return false;
+  }
+  Util::Log("INFO", "GL renderer: %s", glGetString(GL_RENDERER));
+  return true;
+}
+#endif
+
 void GPUPixelContext::useAsCurrent() {
   #if defined(GPUPIXEL_IOS)
     if ([EAGLContext currentContext] != _eglContext) {
@@ -289,12 +705,52 @@ void GPUPixelContext::useAsCurrent() {
     Util::Log("ERROR", "Set Current Context Error!");
   }
 #elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+#if defined(GPUPIXEL_ENABLE_EGL)
+  if (_backend == ContextBackendEGL) {
+    // nothing to bind before createContext()
+    if (egl_context_ == EGL_NO_CONTEXT) {
+      return;
+    }
+    if (eglGetCurrentContext() != egl_context_ &&
+        !eglMakeCurrent(egl_display_, egl_surface_, egl_surface_,
+                        egl_context_)) {
+      Util::Log("ERROR", "Set Current Context Error!");
+    }
+    return;
+  }
+#endif
    if (glfwGetCurrentContext() != gl_context_) {
     glfwMakeContextCurrent(gl_context_);
   }
 #endif
 }
 
+void GPUPixelContext::clearCurrent() {
+#if defined(GPUPIXEL_IOS)
+  if ([EAGLContext currentContext] == _eglContext) {
+    [EAGLContext setCurrentContext:nil];
+  }
+#elif defined(GPUPIXEL_MAC)
+  if ([NSOpenGLContext currentContext] == imageProcessingContext) {
+    [NSOpenGLContext clearCurrentContext];
+  }
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+#if defined(GPUPIXEL_ENABLE_EGL)
+  if (_backend == ContextBackendEGL) {
+    if (egl_context_ != EGL_NO_CONTEXT &&
+        eglGetCurrentContext() == egl_context_) {
+      eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                     EGL_NO_CONTEXT);
+    }
+    return;
+  }
+#endif
+  if (gl_context_ && glfwGetCurrentContext() == gl_context_) {
+    glfwMakeContextCurrent(NULL);
+  }
+#endif
+}
+
 void GPUPixelContext::presentBufferForDisplay() {
 #if defined(GPUPIXEL_IOS)
   [_eglContext presentRenderbuffer:GL_RENDERBUFFER];
@@ -305,10 +761,37 @@ void GPUPixelContext::presentBufferForDisplay() {
 
 void GPUPixelContext::releaseContext() {
 #if defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+#if defined(GPUPIXEL_ENABLE_EGL)
+  if (_backend == ContextBackendEGL) {
+    if (egl_display_ == EGL_NO_DISPLAY) {
+      return;
+    }
+    eglMakeCurrent(egl_display_, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                   EGL_NO_CONTEXT);
+    if (egl_context_ != EGL_NO_CONTEXT) {
+      eglDestroyContext(egl_display_, egl_context_);
+      egl_context_ = EGL_NO_CONTEXT;
+    }
+    if (egl_surface_ != EGL_NO_SURFACE) {
+      eglDestroySurface(egl_display_, egl_surface_);
+      egl_surface_ = EGL_NO_SURFACE;
+    }
+    egl_display_ = EGL_NO_DISPLAY;
+    releaseSharedEGLDisplay();
+    return;
+  }
+#endif
   if (gl_context_) {
     glfwDestroyWindow(gl_context_);
+    gl_context_ = nullptr;
+  }
+  if (glfw_inited_) {
+    glfw_inited_ = false;
+    std::unique_lock<std::mutex> lock(s_glfwMutex);
+    if (--s_glfwRefs == 0) {
+      glfwTerminate();
+    }
   }
-  glfwTerminate();
 #elif defined(GPUPIXEL_ANDROID)
   if (!context_inited) {
     return;
@@ -324,10 +807,7 @@ void GPUPixelContext::releaseContext() {
 
     eglMakeCurrent(m_gpu_context->egldisplay, EGL_NO_SURFACE, EGL_NO_SURFACE,
                    EGL_NO_CONTEXT);
-    if (!eglTerminate(m_gpu_context->egldisplay)) {
-      // err_log("Free egldisplay error!");
-      Util::Log("ERROR", "Free egldisplay Error!");
-    }
+    releaseSharedEGLDisplay();
   }
 
   if (m_gpu_context != nullptr) {
@@ -340,15 +820,56 @@ void GPUPixelContext::releaseContext() {
 void GPUPixelContext::runSync(std::function<void(void)> func) {
   // todo fix android 
 #if defined(GPUPIXEL_ANDROID)
+  GPUPixelContext* previous = s_currentContext;
+  s_currentContext = this;
+  if (previous != this) {
+    // the app renders on the same thread between calls
+    _glStateCache->invalidate();
+  }
   func();
+  s_currentContext = previous;
 #else
-  task_queue_->add([=]() {
-      useAsCurrent();
-      func();
-  });
-  task_queue_->processOne();
+  if (!task_queue_ || task_queue_->isQueueThread()) {
+    func();
+    return;
+  }
+  std::packaged_task<void()> task(func);
+  std::future<void> result = task.get_future();
+  task_queue_->add([&task] { task(); });
+  result.get();
+#endif
+}
+
+std::future<void> GPUPixelContext::runAsync(std::function<void(void)> func) {
+  auto task = std::make_shared<std::packaged_task<void()>>(func);
+  std::future<void> result = task->get_future();
+#if defined(GPUPIXEL_ANDROID)
+  runSync([=] { (*task)(); });
+#else
+  if (!task_queue_ || task_queue_->isQueueThread()) {
+    (*task)();
+  } else {
+    task_queue_->add([=] { (*task)(); });
+  }
 #endif
+  return result;
+}
 
+bool GPUPixelContext::isRenderThread() const {
+#if defined(GPUPIXEL_ANDROID)
+  // android renders inline on the caller's thread
+  return true;
+#else
+  return task_queue_ && task_queue_->isQueueThread();
+#endif
+}
+
+void GPUPixelContext::setMaxPendingTasks(int count) {
+#if !defined(GPUPIXEL_ANDROID)
+  if (task_queue_) {
+    task_queue_->setCapacity(count > 0 ? count : 1);
+  }
+#endif
 }
 
 NS_GPUPIXEL_END
@@ -7,9 +7,16 @@
 
 #pragma once
 
+#include <atomic>
+#include <future>
 #include <mutex>
 #include "framebuffer_cache.h"
+#include "fullscreen_quad.h"
+#include "gl_compute.h"
+#include "gl_state_cache.h"
+#include "gpu_profiler.h"
 #include "gpupixel_macros.h"
+#include "program_cache.h"
 #include "dispatch_queue.h"
 
 #include "filter.h"
@@ -27,16 +34,77 @@
 NS_GPUPIXEL_BEGIN
 class GPUPIXEL_API GPUPixelContext {
  public:
+#if defined(GPUPIXEL_ENABLE_EGL)
+  // Linux renders on a headless EGL context by default. The GLFW backend
+  // creates a hidden window and is only required when drawing into a
+  // TargetView. Must be selected before the first getInstance().
+  enum ContextBackend { ContextBackendEGL = 0, ContextBackendGLFW };
+  static void setContextBackend(ContextBackend backend);
+  static ContextBackend getContextBackend();
+#endif
+
+  // Returns the context made current on the calling thread, or the process
+  // wide default context when there is none.
   static GPUPixelContext* getInstance();
   static void destroy();
 
+  // Independent contexts, each one owns its own framebuffer cache, programs,
+  // task queue and capture state. Textures are visible across contexts
+  // created with the same |sharedContext|.
+  static GPUPixelContext* create(GPUPixelContext* sharedContext = nullptr);
+  // Framebuffers of its cache still held afterwards are freed without
+  // touching the context, their textures went with it.
+  static void destroy(GPUPixelContext* context);
+
+  // Filters, sources and targets bind to the current context of the thread
+  // that creates them, nullptr falls back to the default context.
+  static void setCurrent(GPUPixelContext* context);
+  static GPUPixelContext* getCurrent();
+
   FramebufferCache* getFramebufferCache() const;
+  // compiled programs, see ProgramCache
+  ProgramCache* getProgramCache() const { return _programCache.get(); }
+  // GL state of the render thread, see GLStateCache
+  GLStateCache* getGLStateCache() const { return _glStateCache.get(); }
+  // error reporting of the render thread, see GLDebug
+  GLDebug* getGLDebug() const { return _glDebug.get(); }
+  // GPU time of the passes, see GPUProfiler
+  GPUProfiler* getGPUProfiler() const { return _gpuProfiler.get(); }
+  // compute passes, see GLCompute
+  GLCompute* getGLCompute() const { return _glCompute.get(); }
+  // vertex buffer of the fullscreen passes, see FullscreenQuad
+  FullscreenQuad* getFullscreenQuad() const { return _fullscreenQuad.get(); }
+  // Called by every change to the graph topology of the sources of this
+  // context, their frame graphs rebuild before the next frame. The graphs of
+  // other contexts are left alone.
+  void invalidateFrameGraphs() { _frameGraphGeneration++; }
+  uint64_t getFrameGraphGeneration() const { return _frameGraphGeneration; }
+  // fusion of pointwise filter chains, see FrameGraph. On by default,
+  // changing it rebuilds the frame graphs of this context.
+  void setFrameGraphFusionEnabled(bool enabled);
+  bool isFrameGraphFusionEnabled() const { return _frameGraphFusion; }
   //todo(zhaoyou)
   void setActiveShaderProgram(GLProgram* shaderProgram);
   void purge();
+  // called on the render thread after the last pass of a frame
+  void endFrame();
+  // GL entry points outside of the loaded headers, null when unknown
+  void* getProcAddress(const char* name);
+  // extensions of the context, on the render thread
+  bool hasExtension(const char* name);
+  // whether framebuffers of 32 bit float RGBA can be rendered to
+  bool isFloatRenderTargetSupported();
+  // whether filters can render to |format|, see Filter::setOutputFormat()
+  bool isFramebufferFormatSupported(FramebufferFormat format);
 
+  // All GL work of a context happens on its render thread. runSync() blocks
+  // until |func| has run there, runAsync() returns at once and blocks only
+  // while setMaxPendingTasks() tasks are already queued. Both run |func|
+  // inline when called from the render thread.
   void runSync(std::function<void(void)> func);
-  void runAsync(std::function<void(void)> func);
+  std::future<void> runAsync(std::function<void(void)> func);
+  bool isRenderThread() const;
+  void setMaxPendingTasks(int count);
   void useAsCurrent(void);
   void presentBufferForDisplay();
  
@@ -55,21 +123,42 @@ class GPUPIXEL_API GPUPixelContext {
   unsigned char* capturedFrameData;
   int captureWidth;
   int captureHeight;
+  // set while Source::warmUp() runs its frame, targets deliver nothing
+  bool isWarmingUp;
 
  private:
-  GPUPixelContext();
+  GPUPixelContext(GPUPixelContext* sharedContext = nullptr);
   ~GPUPixelContext();
 
   void init();
 
   void createContext();
   void releaseContext();
+  void clearCurrent();
+  void _queryFramebufferFormats();
+#if defined(GPUPIXEL_ENABLE_EGL)
+  bool createEGLContext();
+  bool initEGLDisplay();
+  bool openEGLDisplay();
+#endif
  private:
   static GPUPixelContext* _instance;
   static std::mutex _mutex;
-  FramebufferCache* _framebufferCache;
-  GLProgram* _curShaderProgram;
-  std::shared_ptr<LocalDispatchQueue> task_queue_;
+  GPUPixelContext* _sharedContext;
+  std::shared_ptr<FramebufferCache> _framebufferCache;
+  std::unique_ptr<GLStateCache> _glStateCache;
+  std::unique_ptr<GLDebug> _glDebug;
+  std::unique_ptr<GPUProfiler> _gpuProfiler;
+  std::unique_ptr<GLCompute> _glCompute;
+  std::unique_ptr<FullscreenQuad> _fullscreenQuad;
+  std::unique_ptr<ProgramCache> _programCache;
+  std::shared_ptr<SerialDispatchQueue> task_queue_;
+  // what the framebuffers of the context can be, queried once
+  bool _framebufferFormatsQueried;
+  bool _floatRenderTarget;
+  bool _framebufferFormats[FramebufferFormatCount];
+  std::atomic<uint64_t> _frameGraphGeneration{1};
+  std::atomic<bool> _frameGraphFusion{true};
   
 #if defined(GPUPIXEL_ANDROID)
   bool context_inited = false;
@@ -83,8 +172,15 @@ class GPUPIXEL_API GPUPixelContext {
   NSOpenGLPixelFormat* _pixelFormat;
 #elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
   GLFWwindow* gl_context_ = nullptr;
+  bool glfw_inited_ = false;
 #endif
 
+#if defined(GPUPIXEL_ENABLE_EGL)
+  static ContextBackend _backend;
+  EGLDisplay egl_display_ = EGL_NO_DISPLAY;
+  EGLSurface egl_surface_ = EGL_NO_SURFACE;
+  EGLContext egl_context_ = EGL_NO_CONTEXT;
+#endif
 };
 
 NS_GPUPIXEL_END
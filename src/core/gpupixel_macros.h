@@ -87,6 +87,13 @@
   #include <glad/glad.h>
   #define GLEW_STATIC
   #include <GLFW/glfw3.h>
+  #if defined(GPUPIXEL_LINUX) && !defined(__emscripten__)
+    // headless context backend, no X/Wayland display needed
+    #define GPUPIXEL_ENABLE_EGL
+    #define EGL_NO_X11
+    #include <EGL/egl.h>
+    #include <EGL/eglext.h>
+  #endif
 #endif
 
 #define NS_GPUPIXEL_BEGIN namespace gpupixel {
@@ -97,36 +104,31 @@
 // Pi
 #define PI 3.14159265358979323846264338327950288
 
+// calling convention of GL entry points loaded at runtime
+#if defined(GPUPIXEL_ANDROID)
+#define GPUPIXEL_GL_APIENTRY GL_APIENTRY
+#elif defined(APIENTRY)
+#define GPUPIXEL_GL_APIENTRY APIENTRY
+#else
+#define GPUPIXEL_GL_APIENTRY
+#endif
+
 //------------- ENABLE_GL_CHECK Begin ------------ //
+// false compiles the checks out, otherwise GLDebug::setCheckMode() selects
+// them at runtime
+#ifndef ENABLE_GL_CHECK
 #define ENABLE_GL_CHECK true
+#endif
 #if ENABLE_GL_CHECK
   #define CHECK_GL(glFunc)                                                     \
   glFunc;                                                                      \
-  {                                                                            \
-    int e = glGetError();                                                      \
-    if (e != 0) {                                                              \
-      std::string errorString = "";                                            \
-      switch (e) {                                                             \
-        case GL_INVALID_ENUM:                                                  \
-          errorString = "GL_INVALID_ENUM";                                     \
-          break;                                                               \
-        case GL_INVALID_VALUE:                                                 \
-          errorString = "GL_INVALID_VALUE";                                    \
-          break;                                                               \
-        case GL_INVALID_OPERATION:                                             \
-          errorString = "GL_INVALID_OPERATION";                                \
-          break;                                                               \
-        case GL_OUT_OF_MEMORY:                                                 \
-          errorString = "GL_OUT_OF_MEMORY";                                    \
-          break;                                                               \
-        default:                                                               \
-          break;                                                               \
-      }                                                                        \
-      gpupixel::Util::Log("ERROR", "GL ERROR 0x%04X %s in func:%s(), in file:%s, at line %i", e, \
-                          errorString.c_str(), __FUNCTION__, __FILE__, __LINE__);        \
-    }                                                                          \
+  if (gpupixel::GLDebug::isCheckingPerCall()) {                                \
+    gpupixel::GLDebug::checkError(__FUNCTION__, __FILE__, __LINE__);           \
   }
 #else
   #define CHECK_GL(glFunc) glFunc;
 #endif
+
+#include "gl_debug.h"
+#include "trace.h"
  
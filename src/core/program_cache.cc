@@ -0,0 +1,490 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "program_cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "gpupixel_context.h"
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// ARB_get_program_binary and OES_get_program_binary share the values
+static const GLenum kGLProgramBinaryRetrievableHint = 0x8257;
+static const GLenum kGLProgramBinaryLength = 0x8741;
+static const GLenum kGLNumProgramBinaryFormats = 0x87FE;
+static const GLenum kGLComputeShader = 0x91B9;
+// any number of threads the driver sees fit
+static const GLuint kGLMaxShaderCompilerThreadsAll = 0xFFFFFFFF;
+
+static const char kBinaryMagic[4] = {'G', 'P', 'X', 'P'};
+static const uint32_t kBinaryVersion = 1;
+
+const int ProgramCache::kMaxIdlePrograms = 32;
+
+std::mutex ProgramCache::_binaryCacheMutex;
+std::string ProgramCache::_binaryCacheDir;
+
+ProgramCache::ProgramCache(GPUPixelContext* context)
+    : _context(context),
+      _stats(),
+      _binarySupported(0),
+      _getProgramBinary(nullptr),
+      _programBinary(nullptr),
+      _programParameteri(nullptr),
+      _parallelCompile(0) {}
+
+ProgramCache::~ProgramCache() {
+  if (_programs.empty()) {
+    return;
+  }
+  _context->runSync([&] {
+    // including programs of objects that never released theirs
+    for (auto& it : _programs) {
+      _delete(it.second.get());
+    }
+    _programs.clear();
+    _idlePrograms.clear();
+  });
+}
+
+void ProgramCache::setBinaryCacheDir(const std::string& dir) {
+  std::unique_lock<std::mutex> lock(_binaryCacheMutex);
+  _binaryCacheDir = dir;
+}
+
+std::string ProgramCache::getBinaryCacheDir() {
+  std::unique_lock<std::mutex> lock(_binaryCacheMutex);
+  return _binaryCacheDir;
+}
+
+uint64_t ProgramCache::_hashSources(const std::string& vertexShaderSource,
+                                    const std::string& fragmentShaderSource) {
+  // FNV-1a, stable across runs for the binary file names
+  uint64_t hash = 14695981039346656037ull;
+  auto feed = [&hash](const std::string& source) {
+    for (unsigned char c : source) {
+      hash = (hash ^ c) * 1099511628211ull;
+    }
+    hash = (hash ^ 0xFF) * 1099511628211ull;
+  };
+  feed(vertexShaderSource);
+  feed(fragmentShaderSource);
+  return hash;
+}
+
+ProgramObject* ProgramCache::acquire(const std::string& vertexShaderSource,
+                                     const std::string& fragmentShaderSource) {
+  uint64_t hash = _hashSources(vertexShaderSource, fragmentShaderSource);
+  auto it = _programs.find(hash);
+  if (it != _programs.end()) {
+    ProgramObject* program = it->second.get();
+    if (program->vertexShaderSource == vertexShaderSource &&
+        program->fragmentShaderSource == fragmentShaderSource) {
+      if (program->refs == 0) {
+        _idlePrograms.remove(program);
+        _stats.idleCount = (int)_idlePrograms.size();
+      }
+      program->refs++;
+      _stats.hits++;
+      return program;
+    }
+  }
+
+  ProgramObject* program = new ProgramObject();
+  program->id = 0;
+  program->hash = hash;
+  program->vertexShaderSource = vertexShaderSource;
+  program->fragmentShaderSource = fragmentShaderSource;
+  program->refs = 1;
+  program->linked = false;
+  program->cached = it == _programs.end();
+  program->uniformOwner = nullptr;
+
+  bool binaryCache = !getBinaryCacheDir().empty();
+  if (binaryCache && _binarySupported == 0) {
+    _binarySupported = _initBinarySupport() ? 1 : -1;
+    Util::Log("INFO", "ProgramCache: program binaries %s",
+              _binarySupported > 0 ? "enabled" : "not supported");
+  }
+  binaryCache = binaryCache && _binarySupported > 0 && program->cached;
+
+  if (binaryCache && _loadBinary(program)) {
+    _stats.binaryLoads++;
+  } else {
+    if (_parallelCompile == 0) {
+      _parallelCompile = _initParallelCompile() ? 1 : -1;
+      Util::Log("INFO", "ProgramCache: driver compiler threads %s",
+                _parallelCompile > 0 ? "raised" : "not adjustable");
+    }
+    program->linked = _compile(program, binaryCache);
+    _stats.compiles++;
+    if (binaryCache && program->linked) {
+      _storeBinary(program);
+    }
+  }
+  _cacheLocations(program);
+
+  // a failed program is retried by the next acquire, release() deletes it
+  if (!program->linked) {
+    program->cached = false;
+  }
+  if (program->cached) {
+    _programs[hash].reset(program);
+    _stats.programCount = (int)_programs.size();
+  }
+  return program;
+}
+
+ProgramObject* ProgramCache::acquireCompute(
+    const std::string& computeShaderSource) {
+  return acquire("", computeShaderSource);
+}
+
+void ProgramCache::release(ProgramObject* program) {
+  if (!program || --program->refs > 0) {
+    return;
+  }
+  if (!program->cached) {
+    _delete(program);
+    delete program;
+    return;
+  }
+  _idlePrograms.push_back(program);
+  while ((int)_idlePrograms.size() > kMaxIdlePrograms) {
+    ProgramObject* idle = _idlePrograms.front();
+    _idlePrograms.pop_front();
+    _delete(idle);
+    _programs.erase(idle->hash);
+  }
+  _stats.programCount = (int)_programs.size();
+  _stats.idleCount = (int)_idlePrograms.size();
+}
+
+void ProgramCache::purge() {
+  for (auto program : _idlePrograms) {
+    _delete(program);
+    _programs.erase(program->hash);
+  }
+  _idlePrograms.clear();
+  _stats.programCount = (int)_programs.size();
+  _stats.idleCount = 0;
+}
+
+void ProgramCache::_delete(ProgramObject* program) {
+  if (program->id) {
+    CHECK_GL(glDeleteProgram(program->id));
+    _context->getGLStateCache()->onProgramDeleted(program->id);
+    program->id = 0;
+  }
+}
+
+bool ProgramCache::_compile(ProgramObject* program, bool retrievable) {
+  CHECK_GL(program->id = glCreateProgram());
+
+  GLuint shaders[2] = {0, 0};
+  GLenum types[2] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+  const std::string* sources[2] = {&program->vertexShaderSource,
+                                   &program->fragmentShaderSource};
+  const char* names[2] = {"vertex", "frag"};
+  int count = 2;
+  if (program->vertexShaderSource.empty()) {
+    // see acquireCompute()
+    types[0] = kGLComputeShader;
+    sources[0] = &program->fragmentShaderSource;
+    names[0] = "compute";
+    count = 1;
+  }
+  for (int i = 0; i < count; ++i) {
+    CHECK_GL(shaders[i] = glCreateShader(types[i]));
+    const char* source = sources[i]->c_str();
+    CHECK_GL(glShaderSource(shaders[i], 1, &source, NULL));
+    CHECK_GL(glCompileShader(shaders[i]));
+  }
+
+  // the status queries wait for a compile running in the background
+  for (int i = 0; i < count; ++i) {
+    GLint compileSuccess;
+    glGetShaderiv(shaders[i], GL_COMPILE_STATUS, &compileSuccess);
+    if (compileSuccess == GL_FALSE) {
+      GLchar messages[256];
+      glGetShaderInfoLog(shaders[i], sizeof(messages), 0, &messages[0]);
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
+      NSString* messageString = [NSString stringWithUTF8String:messages];
+      NSLog(@"%@", messageString);
+#endif
+      Util::Log("ERROR",
+                "GL ERROR GLProgram::_initWithShaderString %s shader %s",
+                names[i], messages);
+    }
+    CHECK_GL(glAttachShader(program->id, shaders[i]));
+  }
+
+  if (retrievable && _programParameteri) {
+    // desktop drivers may not keep the binary otherwise
+    CHECK_GL(_programParameteri(program->id, kGLProgramBinaryRetrievableHint,
+                                GL_TRUE));
+  }
+  CHECK_GL(glLinkProgram(program->id));
+
+  for (int i = 0; i < count; ++i) {
+    CHECK_GL(glDetachShader(program->id, shaders[i]));
+    CHECK_GL(glDeleteShader(shaders[i]));
+  }
+
+  GLint linkSuccess = GL_FALSE;
+  CHECK_GL(glGetProgramiv(program->id, GL_LINK_STATUS, &linkSuccess));
+  if (linkSuccess == GL_FALSE) {
+    GLchar messages[256];
+    glGetProgramInfoLog(program->id, sizeof(messages), 0, &messages[0]);
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
+    NSString* messageString = [NSString stringWithUTF8String:messages];
+    NSLog(@"%@", messageString);
+#endif
+    Util::Log("ERROR", "GL ERROR GLProgram::_initWithShaderString link %s",
+              messages);
+  }
+  return linkSuccess == GL_TRUE;
+}
+
+void ProgramCache::_cacheLocations(ProgramObject* program) {
+  program->attribLocations.clear();
+  program->uniformLocations.clear();
+  program->uniformTypes.clear();
+  program->uniformValues.clear();
+  if (!program->linked) {
+    return;
+  }
+
+  GLuint id = program->id;
+  GLint count = 0;
+  GLint maxLength = 0;
+  GLsizei length = 0;
+  GLint size = 0;
+  GLenum type = 0;
+  CHECK_GL(glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &count));
+  CHECK_GL(glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength));
+  std::vector<GLchar> name(std::max(maxLength, 1));
+  for (GLint i = 0; i < count; ++i) {
+    CHECK_GL(glGetActiveUniform(id, i, (GLsizei)name.size(), &length, &size,
+                                &type, name.data()));
+    std::string uniformName(name.data(), length);
+    GLint location = glGetUniformLocation(id, uniformName.c_str());
+    program->uniformLocations[uniformName] = location;
+    if (location >= 0) {
+      program->uniformTypes[location] = std::make_pair(type, size);
+    }
+    // arrays are listed as "name[0]", also resolve the plain name
+    size_t bracket = uniformName.find('[');
+    if (bracket != std::string::npos) {
+      program->uniformLocations[uniformName.substr(0, bracket)] = location;
+    }
+  }
+
+  CHECK_GL(glGetProgramiv(id, GL_ACTIVE_ATTRIBUTES, &count));
+  CHECK_GL(glGetProgramiv(id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength));
+  name.resize(std::max(maxLength, 1));
+  for (GLint i = 0; i < count; ++i) {
+    CHECK_GL(glGetActiveAttrib(id, i, (GLsizei)name.size(), &length, &size,
+                               &type, name.data()));
+    std::string attribName(name.data(), length);
+    program->attribLocations[attribName] =
+        glGetAttribLocation(id, attribName.c_str());
+  }
+}
+
+bool ProgramCache::_initBinarySupport() {
+  const char* suffix = "";
+#if defined(GPUPIXEL_ANDROID)
+  if (!_context->hasExtension("GL_OES_get_program_binary")) {
+    return false;
+  }
+  suffix = "OES";
+#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  if (!(major > 4 || (major == 4 && minor >= 1)) &&
+      !_context->hasExtension("GL_ARB_get_program_binary")) {
+    return false;
+  }
+  _programParameteri = (ProgramParameteriProc)_context->getProcAddress(
+      "glProgramParameteri");
+#else
+  // not offered by the Apple GL implementations
+  return false;
+#endif
+  GLint formats = 0;
+  glGetIntegerv(kGLNumProgramBinaryFormats, &formats);
+  if (formats <= 0) {
+    return false;
+  }
+  _getProgramBinary = (GetProgramBinaryProc)_context->getProcAddress(
+      Util::str_format("glGetProgramBinary%s", suffix).c_str());
+  _programBinary = (ProgramBinaryProc)_context->getProcAddress(
+      Util::str_format("glProgramBinary%s", suffix).c_str());
+  return _getProgramBinary && _programBinary;
+}
+
+bool ProgramCache::_initParallelCompile() {
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
+  // not offered by the Apple GL implementations
+  return false;
+#else
+  MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+  if (_context->hasExtension("GL_KHR_parallel_shader_compile")) {
+    maxShaderCompilerThreads =
+        (MaxShaderCompilerThreadsProc)_context->getProcAddress(
+            "glMaxShaderCompilerThreadsKHR");
+  }
+#if defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+  if (!maxShaderCompilerThreads &&
+      _context->hasExtension("GL_ARB_parallel_shader_compile")) {
+    maxShaderCompilerThreads =
+        (MaxShaderCompilerThreadsProc)_context->getProcAddress(
+            "glMaxShaderCompilerThreadsARB");
+  }
+#endif
+  if (!maxShaderCompilerThreads) {
+    return false;
+  }
+  CHECK_GL(maxShaderCompilerThreads(kGLMaxShaderCompilerThreadsAll));
+  return true;
+#endif
+}
+
+std::string ProgramCache::_getBinaryPath(uint64_t hash) const {
+  return Util::str_format("%s/%016llx.glbin", getBinaryCacheDir().c_str(),
+                          (unsigned long long)hash);
+}
+
+std::string ProgramCache::_getDriverString() const {
+  // binaries break with any driver update
+  std::string driver;
+  const GLenum names[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+  for (int i = 0; i < 3; ++i) {
+    const char* value = (const char*)glGetString(names[i]);
+    driver += value ? value : "";
+    driver += '\n';
+  }
+  return driver;
+}
+
+// the file holds the magic, the version, the driver string, the length of
+// both sources, the binary format and the binary
+static bool readUint32(FILE* file, uint32_t& value) {
+  return fread(&value, sizeof(value), 1, file) == 1;
+}
+
+static bool writeUint32(FILE* file, uint32_t value) {
+  return fwrite(&value, sizeof(value), 1, file) == 1;
+}
+
+bool ProgramCache::_loadBinary(ProgramObject* program) {
+  std::string path = _getBinaryPath(program->hash);
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+
+  std::string driver = _getDriverString();
+  char magic[4] = {0};
+  uint32_t version = 0;
+  uint32_t driverLength = 0;
+  uint32_t vertexLength = 0;
+  uint32_t fragmentLength = 0;
+  uint32_t format = 0;
+  uint32_t binaryLength = 0;
+  bool valid = fread(magic, sizeof(magic), 1, file) == 1 &&
+               memcmp(magic, kBinaryMagic, sizeof(magic)) == 0 &&
+               readUint32(file, version) && version == kBinaryVersion &&
+               readUint32(file, driverLength) &&
+               driverLength == driver.size();
+  std::string fileDriver(valid ? driverLength : 0, '\0');
+  valid = valid &&
+          fread(&fileDriver[0], 1, driverLength, file) == driverLength &&
+          fileDriver == driver && readUint32(file, vertexLength) &&
+          vertexLength == program->vertexShaderSource.size() &&
+          readUint32(file, fragmentLength) &&
+          fragmentLength == program->fragmentShaderSource.size() &&
+          readUint32(file, format) && readUint32(file, binaryLength) &&
+          binaryLength > 0;
+  std::vector<uint8_t> binary(valid ? binaryLength : 0);
+  valid = valid && fread(binary.data(), 1, binaryLength, file) == binaryLength;
+  fclose(file);
+  if (!valid) {
+    // written by another driver or version, replaced after compiling
+    return false;
+  }
+
+  CHECK_GL(program->id = glCreateProgram());
+  CHECK_GL(_programBinary(program->id, (GLenum)format, binary.data(),
+                          (GLsizei)binaryLength));
+  GLint linkSuccess = GL_FALSE;
+  CHECK_GL(glGetProgramiv(program->id, GL_LINK_STATUS, &linkSuccess));
+  if (linkSuccess != GL_TRUE) {
+    Util::Log("WARNING", "ProgramCache: binary %s rejected", path.c_str());
+    _delete(program);
+    // glProgramBinary() may leave an error behind on rejection
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    return false;
+  }
+  program->linked = true;
+  return true;
+}
+
+void ProgramCache::_storeBinary(ProgramObject* program) {
+  GLint binaryLength = 0;
+  CHECK_GL(glGetProgramiv(program->id, kGLProgramBinaryLength, &binaryLength));
+  if (binaryLength <= 0) {
+    return;
+  }
+  std::vector<uint8_t> binary(binaryLength);
+  GLenum format = 0;
+  GLsizei length = 0;
+  CHECK_GL(_getProgramBinary(program->id, binaryLength, &length, &format,
+                             binary.data()));
+  if (length <= 0) {
+    return;
+  }
+
+  // written aside and renamed, a concurrent reader never sees half a file
+  std::string path = _getBinaryPath(program->hash);
+  std::string tempPath = Util::str_format("%s.%p", path.c_str(), this);
+  FILE* file = fopen(tempPath.c_str(), "wb");
+  if (!file) {
+    Util::Log("WARNING", "ProgramCache: can not write %s", tempPath.c_str());
+    return;
+  }
+  std::string driver = _getDriverString();
+  bool written =
+      fwrite(kBinaryMagic, sizeof(kBinaryMagic), 1, file) == 1 &&
+      writeUint32(file, kBinaryVersion) &&
+      writeUint32(file, (uint32_t)driver.size()) &&
+      fwrite(driver.data(), 1, driver.size(), file) == driver.size() &&
+      writeUint32(file, (uint32_t)program->vertexShaderSource.size()) &&
+      writeUint32(file, (uint32_t)program->fragmentShaderSource.size()) &&
+      writeUint32(file, (uint32_t)format) &&
+      writeUint32(file, (uint32_t)length) &&
+      fwrite(binary.data(), 1, length, file) == (size_t)length;
+  written = fclose(file) == 0 && written;
+#if defined(GPUPIXEL_WIN)
+  // rename() does not replace files on Windows
+  remove(path.c_str());
+#endif
+  if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+    remove(tempPath.c_str());
+    Util::Log("WARNING", "ProgramCache: can not write %s", path.c_str());
+    return;
+  }
+  _stats.binaryStores++;
+}
+
+NS_GPUPIXEL_END
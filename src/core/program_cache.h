@@ -0,0 +1,136 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+class GPUPixelContext;
+class GLProgram;
+
+// A linked GL program and what is known about it, shared by all the
+// GLProgram built from the same sources on a context.
+struct ProgramObject {
+  GLuint id;
+  uint64_t hash;
+  std::string vertexShaderSource;
+  std::string fragmentShaderSource;
+  int refs;
+  bool linked;
+  // false for the rare program whose hash collides with a cached one
+  bool cached;
+  std::unordered_map<std::string, GLint> attribLocations;
+  std::unordered_map<std::string, GLint> uniformLocations;
+  // GL type and array size of the active uniforms
+  std::unordered_map<GLint, std::pair<GLenum, GLint>> uniformTypes;
+  // values the GL program currently holds, and whose values they are
+  std::unordered_map<GLint, std::vector<uint8_t>> uniformValues;
+  const GLProgram* uniformOwner;
+};
+
+struct ProgramCacheStats {
+  // programs handed out without compiling
+  uint64_t hits;
+  uint64_t compiles;
+  uint64_t binaryLoads;
+  uint64_t binaryStores;
+  int programCount;
+  int idleCount;
+};
+
+// Programs of a context keyed by a hash of their sources. Identical sources
+// share one reference counted program, released ones stay idle for reuse
+// until kMaxIdlePrograms are reached or purge() is called.
+//
+// With a binary cache directory set, programs are also stored on disk with
+// glGetProgramBinary() and loaded with glProgramBinary() on later runs,
+// skipping compilation. A binary is only used by the driver that wrote it.
+// Needs GL 4.1, ARB_get_program_binary or OES_get_program_binary.
+//
+// With KHR_parallel_shader_compile the driver is allowed all its compiler
+// threads. Programs are still built one at a time as they are acquired,
+// only the shaders of one program are queued before waiting on either, so
+// the programs of a pipeline do not compile side by side.
+class GPUPIXEL_API ProgramCache {
+ public:
+  ProgramCache(GPUPixelContext* context);
+  ~ProgramCache();
+
+  // process wide, empty disables the binary cache
+  static void setBinaryCacheDir(const std::string& dir);
+  static std::string getBinaryCacheDir();
+
+  // render thread. Compile and link errors are logged, the program is
+  // still returned with linked unset but is not kept for later acquires.
+  ProgramObject* acquire(const std::string& vertexShaderSource,
+                         const std::string& fragmentShaderSource);
+  // A compute program, kept as a program without vertex shader whose
+  // fragment source is the compute shader. Needs GL 4.3 or GLES 3.1.
+  ProgramObject* acquireCompute(const std::string& computeShaderSource);
+  void release(ProgramObject* program);
+  // deletes the idle programs
+  void purge();
+
+  ProgramCacheStats getStats() const { return _stats; }
+
+  static const int kMaxIdlePrograms;
+
+ private:
+  typedef void(GPUPIXEL_GL_APIENTRY* GetProgramBinaryProc)(GLuint program,
+                                                           GLsizei bufSize,
+                                                           GLsizei* length,
+                                                           GLenum* format,
+                                                           void* binary);
+  typedef void(GPUPIXEL_GL_APIENTRY* ProgramBinaryProc)(GLuint program,
+                                                        GLenum format,
+                                                        const void* binary,
+                                                        GLsizei length);
+  typedef void(GPUPIXEL_GL_APIENTRY* ProgramParameteriProc)(GLuint program,
+                                                            GLenum pname,
+                                                            GLint value);
+  typedef void(GPUPIXEL_GL_APIENTRY* MaxShaderCompilerThreadsProc)(
+      GLuint count);
+
+  static uint64_t _hashSources(const std::string& vertexShaderSource,
+                               const std::string& fragmentShaderSource);
+  bool _initBinarySupport();
+  bool _initParallelCompile();
+  std::string _getBinaryPath(uint64_t hash) const;
+  std::string _getDriverString() const;
+  bool _compile(ProgramObject* program, bool retrievable);
+  bool _loadBinary(ProgramObject* program);
+  void _storeBinary(ProgramObject* program);
+  void _cacheLocations(ProgramObject* program);
+  void _delete(ProgramObject* program);
+
+  static std::mutex _binaryCacheMutex;
+  static std::string _binaryCacheDir;
+
+  GPUPixelContext* _context;
+  std::unordered_map<uint64_t, std::unique_ptr<ProgramObject>> _programs;
+  std::list<ProgramObject*> _idlePrograms;
+  ProgramCacheStats _stats;
+
+  // 0 unknown, 1 supported, -1 unsupported
+  int _binarySupported;
+  GetProgramBinaryProc _getProgramBinary;
+  ProgramBinaryProc _programBinary;
+  ProgramParameteriProc _programParameteri;
+  // 0 unknown, 1 enabled, -1 unsupported
+  int _parallelCompile;
+};
+
+NS_GPUPIXEL_END
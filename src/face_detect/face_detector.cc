@@ -45,6 +45,7 @@ int FaceDetector::Detect(const uint8_t* data,
                     int height,
                     GPUPIXEL_MODE_FMT fmt,
                     GPUPIXEL_FRAME_TYPE type) {
+  TRACE_SCOPE("FaceDetector::Detect");
   if(vnn_handle_ == 0) {
     return -1;
   }
@@ -122,6 +123,7 @@ int FaceDetector::Detect(const uint8_t* data,
   }
   
   // do callbck
+  TRACE_SCOPE("FaceDetector callbacks");
   for(auto cb : _face_detector_callbacks) {
     cb(landmarks);
   }
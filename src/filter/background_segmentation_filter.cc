@@ -6,6 +6,7 @@
  */
 
 #include "background_segmentation_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -57,9 +58,11 @@ const std::string kBackgroundSegmentationFragmentShaderString = R"(
  
 std::shared_ptr<BackgroundSegmentationFilter> BackgroundSegmentationFilter::create() {
   auto ret = std::shared_ptr<BackgroundSegmentationFilter>(new BackgroundSegmentationFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -6,6 +6,8 @@
  */
 
 #include "beauty_face_filter.h"
+#include "gpupixel_context.h"
+#include "util.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -15,9 +17,11 @@ BeautyFaceFilter::~BeautyFaceFilter() {}
 
 std::shared_ptr<BeautyFaceFilter> BeautyFaceFilter::create() {
   auto ret = std::shared_ptr<BeautyFaceFilter>(new BeautyFaceFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -26,21 +30,22 @@ bool BeautyFaceFilter::init() {
     return false;
   }
 
-  boxBlurFilter = BoxBlurFilter::create();
+  boxBlurFilter =
+      BoxMonoBlurFilter::create(GaussianBlurMonoFilter::HORIZONTAL, 4, 0.0);
   addFilter(boxBlurFilter);
 
-  boxHighPassFilter = BoxHighPassFilter::create();
-  addFilter(boxHighPassFilter);
+  boxMeanVarianceFilter = BoxMeanVarianceFilter::create();
+  addFilter(boxMeanVarianceFilter);
 
   beautyFilter = BeautyFaceUnitFilter::create();
   addFilter(beautyFilter);
 
-  boxBlurFilter->addTarget(beautyFilter, 1);
-  boxHighPassFilter->addTarget(beautyFilter, 2);
+  boxBlurFilter->addTarget(boxMeanVarianceFilter, 1);
+  boxMeanVarianceFilter->addTarget(beautyFilter, 1);
 
   setTerminalFilter(beautyFilter);
 
-  boxBlurFilter->setTexelSpacingMultiplier(4);
+  setStatisticsDownSampling(1.0);
   setRadius(4);
 
   registerProperty("whiteness", 0, "The whiteness of filter with range between -1 and 1.", [this](float& val) {
@@ -63,7 +68,7 @@ void BeautyFaceFilter::setInputFramebuffer(
 }
 
 void BeautyFaceFilter::setHighPassDelta(float highPassDelta) {
-  boxHighPassFilter->setDelta(highPassDelta);
+  boxMeanVarianceFilter->setDelta(highPassDelta);
 }
 
 void BeautyFaceFilter::setSharpen(float sharpen) {
@@ -78,8 +83,79 @@ void BeautyFaceFilter::setWhite(float white) {
   beautyFilter->setWhite(white);
 }
 
+void BeautyFaceFilter::setStatisticsDownSampling(float downSampling) {
+  if (downSampling < 1.0) {
+    downSampling = 1.0;
+  }
+  boxBlurFilter->setFramebufferScale(1.0 / downSampling);
+  boxMeanVarianceFilter->setFramebufferScale(1.0 / downSampling);
+  // the spacing counts texels of the smaller outputs
+  boxBlurFilter->setTexelSpacingMultiplier(4.0 / downSampling);
+  boxMeanVarianceFilter->setTexelSpacingMultiplier(4.0 / downSampling);
+  downSampling_ = downSampling;
+  _updateGuidedFilter();
+}
+
+void BeautyFaceFilter::setJointUpsampling(bool enabled) {
+  beautyFilter->setJointUpsampling(enabled);
+}
+
+void BeautyFaceFilter::setSmoothingCore(SmoothingCore smoothingCore) {
+  // the swap must not land between the passes of a frame
+  _context->runSync([&] {
+    if (smoothingCore == smoothingCore_) {
+      return;
+    }
+    if (smoothingCore == SmoothingCoreGuided && !guidedFilter) {
+      guidedFilter = GuidedFilter::create();
+      if (!guidedFilter) {
+        Util::Log("ERROR", "BeautyFaceFilter: failed to create GuidedFilter");
+        return;
+      }
+      _updateGuidedFilter();
+    }
+    smoothingCore_ = smoothingCore;
+
+    if (smoothingCore == SmoothingCoreGuided) {
+      removeFilter(boxBlurFilter);
+      removeFilter(boxMeanVarianceFilter);
+      boxMeanVarianceFilter->removeTarget(beautyFilter);
+      addFilter(guidedFilter);
+      guidedFilter->addTarget(beautyFilter, 1);
+    } else {
+      removeFilter(guidedFilter);
+      guidedFilter->removeTarget(beautyFilter);
+      addFilter(boxBlurFilter);
+      addFilter(boxMeanVarianceFilter);
+      boxMeanVarianceFilter->addTarget(beautyFilter, 1);
+    }
+    // the guided output is smoothed already, it has no variance to weigh
+    beautyFilter->setStatisticsVariance(smoothingCore ==
+                                        SmoothingCoreBoxVariance);
+    setTerminalFilter(beautyFilter);
+  });
+}
+
+void BeautyFaceFilter::setGuidedEpsilon(float epsilon) {
+  guidedEpsilon_ = epsilon;
+  _updateGuidedFilter();
+}
+
 void BeautyFaceFilter::setRadius(float radius) {
   boxBlurFilter->setRadius(radius);
-  boxHighPassFilter->setRadius(radius);
+  boxMeanVarianceFilter->setRadius(radius);
+  radius_ = radius;
+  _updateGuidedFilter();
+}
+
+void BeautyFaceFilter::_updateGuidedFilter() {
+  if (!guidedFilter) {
+    return;
+  }
+  // the box cores sample every 4th texel, the guided box covers the same
+  // area texel by texel
+  guidedFilter->setRadius((int)(radius_ * 4));
+  guidedFilter->setDownSampling(downSampling_);
+  guidedFilter->setEpsilon(guidedEpsilon_);
 }
 NS_GPUPIXEL_END
@@ -11,12 +11,17 @@
 #include "gpupixel_macros.h"
 
 #include "beauty_face_unit_filter.h"
-#include "box_blur_filter.h"
-#include "box_high_pass_filter.h"
-#include "gaussian_blur_filter.h"
+#include "box_mean_variance_filter.h"
+#include "box_mono_blur_filter.h"
+#include "guided_filter.h"
 NS_GPUPIXEL_BEGIN
 class GPUPIXEL_API BeautyFaceFilter : public FilterGroup {
  public:
+  // The smoothing mixed into the skin. The box variance core, the default,
+  // is one box blur and one pass of statistics. The guided core runs a
+  // GuidedFilter, six passes of better kept edges.
+  enum SmoothingCore { SmoothingCoreBoxVariance = 0, SmoothingCoreGuided };
+
   static std::shared_ptr<BeautyFaceFilter> create();
   ~BeautyFaceFilter();
   bool init();
@@ -26,6 +31,16 @@ class GPUPIXEL_API BeautyFaceFilter : public FilterGroup {
   void setBlurAlpha(float blurAlpha);
   void setWhite(float white);
   void setRadius(float sigma);
+  // Computes the local mean and variance at 1 / |downSampling| of the input
+  // size, over the same area of the image. 1, the default, keeps the input
+  // size.
+  void setStatisticsDownSampling(float downSampling);
+  // on by default, see BeautyFaceUnitFilter
+  void setJointUpsampling(bool enabled);
+  void setSmoothingCore(SmoothingCore smoothingCore);
+  SmoothingCore getSmoothingCore() const { return smoothingCore_; }
+  // see GuidedFilter::setEpsilon(), used by the guided core
+  void setGuidedEpsilon(float epsilon);
 
   virtual void setInputFramebuffer(std::shared_ptr<Framebuffer> framebuffer,
                                    RotationMode rotationMode /* = NoRotation*/,
@@ -34,9 +49,20 @@ class GPUPIXEL_API BeautyFaceFilter : public FilterGroup {
  protected:
   BeautyFaceFilter();
 
-  std::shared_ptr<BoxBlurFilter> boxBlurFilter;
-  std::shared_ptr<BoxHighPassFilter> boxHighPassFilter;
+  // one box blur gives both the mean and the variance
+  std::shared_ptr<BoxMonoBlurFilter> boxBlurFilter;
+  std::shared_ptr<BoxMeanVarianceFilter> boxMeanVarianceFilter;
   std::shared_ptr<BeautyFaceUnitFilter> beautyFilter;
+  // created with the first switch to the guided core
+  std::shared_ptr<GuidedFilter> guidedFilter;
+
+ private:
+  void _updateGuidedFilter();
+
+  SmoothingCore smoothingCore_ = SmoothingCoreBoxVariance;
+  float radius_ = 4.0;
+  float downSampling_ = 1.0;
+  float guidedEpsilon_ = 0.01;
 };
 
 NS_GPUPIXEL_END
@@ -6,6 +6,7 @@
  */
 
 #include "beauty_face_unit_filter.h"
+#include <typeinfo>
 #include "gpupixel_context.h"
 #include "source_image.h"
 
@@ -46,31 +47,66 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
 
     uniform sampler2D inputImageTexture;
     uniform sampler2D inputImageTexture2;
-    uniform sampler2D inputImageTexture3;
-    uniform sampler2D lookUpGray;
-    uniform sampler2D lookUpOrigin;
-    uniform sampler2D lookUpSkin;
-    uniform sampler2D lookUpCustom;
+    uniform sampler2D whitenLut;
 
     uniform highp float sharpen;
     uniform highp float blurAlpha;
     uniform highp float whiten;
-
-    const float levelRangeInv = 1.02657;
-    const float levelBlack = 0.0258820;
-    const float alpha = 0.7;
+    uniform highp vec2 statisticsTexelSize;
+    uniform float jointUpsample;
+    uniform highp float statisticsVariance;
+
+    const vec2 lutAtlasSize = vec2(1024.0, 512.0);
+
+    // the 64 blue slices of a table are 64x64 tiles laid out 8 by 8
+    highp vec2 tileOrigin(highp float slice) {
+      highp float row = floor(slice / 8.0);
+      return vec2(slice - row * 8.0, row) * 64.0;
+    }
+
+    // Joint bilateral upsampling of statistics computed at a lower
+    // resolution: the four nearest texels weighted by distance and by how
+    // close their mean is to the pixel, so edges do not bleed.
+    vec4 upsampleStatistics(vec3 guide) {
+      // 1 / (2 sigma^2) for a range sigma of 0.1
+      const float rangeWeight = 50.0;
+      highp vec2 position = textureCoordinate / statisticsTexelSize - 0.5;
+      highp vec2 base = floor(position);
+      highp vec2 f = position - base;
+      highp vec2 origin = (base + 0.5) * statisticsTexelSize;
+      vec4 s00 = texture2D(inputImageTexture2, origin);
+      vec4 s10 = texture2D(inputImageTexture2,
+                           origin + vec2(statisticsTexelSize.x, 0.0));
+      vec4 s01 = texture2D(inputImageTexture2,
+                           origin + vec2(0.0, statisticsTexelSize.y));
+      vec4 s11 = texture2D(inputImageTexture2, origin + statisticsTexelSize);
+      vec3 d00 = s00.rgb - guide;
+      vec3 d10 = s10.rgb - guide;
+      vec3 d01 = s01.rgb - guide;
+      vec3 d11 = s11.rgb - guide;
+      float w00 = (1.0 - f.x) * (1.0 - f.y) * exp(-dot(d00, d00) * rangeWeight);
+      float w10 = f.x * (1.0 - f.y) * exp(-dot(d10, d10) * rangeWeight);
+      float w01 = (1.0 - f.x) * f.y * exp(-dot(d01, d01) * rangeWeight);
+      float w11 = f.x * f.y * exp(-dot(d11, d11) * rangeWeight);
+      float weight = w00 + w10 + w01 + w11;
+      if (weight < 0.0001) {
+        return texture2D(inputImageTexture2, textureCoordinate);
+      }
+      return (s00 * w00 + s10 * w10 + s01 * w01 + s11 * w11) / weight;
+    }
 
     void main() {
       vec4 iColor = texture2D(inputImageTexture, textureCoordinate);
-      vec4 meanColor = texture2D(inputImageTexture2, textureCoordinate);
-      vec4 varColor = texture2D(inputImageTexture3, textureCoordinate);
+      vec4 meanColor = jointUpsample > 0.0
+                           ? upsampleStatistics(iColor.rgb)
+                           : texture2D(inputImageTexture2, textureCoordinate);
 
       vec3 color = iColor.rgb;
       if (blurAlpha > 0.0) {
         float theta = 0.1;
         float p =
             clamp((min(iColor.r, meanColor.r - 0.1) - 0.2) * 4.0, 0.0, 1.0);
-        float meanVar = (varColor.r + varColor.g + varColor.b) / 3.0;
+        float meanVar = meanColor.a * statisticsVariance;
         float kMin;
         highp vec3 resultColor;
         kMin = (1.0 - meanVar / (meanVar + theta)) * p * blurAlpha;
@@ -92,68 +128,18 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
       }
 
       if (whiten > 0.0) {
-        vec3 colorEPM = color;
-        color =
-            clamp((colorEPM - vec3(levelBlack)) * levelRangeInv, 0.0, 1.0);
-        vec3 texel = vec3(texture2D(lookUpGray, vec2(color.r, 0.5)).r,
-                          texture2D(lookUpGray, vec2(color.g, 0.5)).g,
-                          texture2D(lookUpGray, vec2(color.b, 0.5)).b);
-        texel = mix(color, texel, 0.5);
-        texel = mix(colorEPM, texel, alpha);
-
-        texel = clamp(texel, 0., 1.);
-        float blueColor = texel.b * 15.0;
-        vec2 quad1;
-        quad1.y = floor(floor(blueColor) * 0.25);
-        quad1.x = floor(blueColor) - (quad1.y * 4.0);
-        vec2 quad2;
-        quad2.y = floor(ceil(blueColor) * 0.25);
-        quad2.x = ceil(blueColor) - (quad2.y * 4.0);
-        vec2 texPos2 = texel.rg * 0.234375 + 0.0078125;
-        vec2 texPos1 = quad1 * 0.25 + texPos2;
-        texPos2 = quad2 * 0.25 + texPos2;
-        vec3 newColor1Origin = texture2D(lookUpOrigin, texPos1).rgb;
-        vec3 newColor2Origin = texture2D(lookUpOrigin, texPos2).rgb;
-        vec3 colorOrigin =
-            mix(newColor1Origin, newColor2Origin, fract(blueColor));
-        texel = mix(colorOrigin, color, alpha);
-
-        texel = clamp(texel, 0., 1.);
-        blueColor = texel.b * 15.0;
-        quad1.y = floor(floor(blueColor) * 0.25);
-        quad1.x = floor(blueColor) - (quad1.y * 4.0);
-        quad2.y = floor(ceil(blueColor) * 0.25);
-        quad2.x = ceil(blueColor) - (quad2.y * 4.0);
-        texPos2 = texel.rg * 0.234375 + 0.0078125;
-        texPos1 = quad1 * 0.25 + texPos2;
-        texPos2 = quad2 * 0.25 + texPos2;
-        vec3 newColor1 = texture2D(lookUpSkin, texPos1).rgb;
-        vec3 newColor2 = texture2D(lookUpSkin, texPos2).rgb;
-        color = mix(newColor1.rgb, newColor2.rgb, fract(blueColor));
-        color = clamp(color, 0., 1.);
-
-        highp float blueColor_custom = color.b * 63.0;
-        highp vec2 quad1_custom;
-        quad1_custom.y = floor(floor(blueColor_custom) / 8.0);
-        quad1_custom.x = floor(blueColor_custom) - (quad1_custom.y * 8.0);
-        highp vec2 quad2_custom;
-        quad2_custom.y = floor(ceil(blueColor_custom) / 8.0);
-        quad2_custom.x = ceil(blueColor_custom) - (quad2_custom.y * 8.0);
-        highp vec2 texPos1_custom;
-        texPos1_custom.x = (quad1_custom.x * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.r);
-        texPos1_custom.y = (quad1_custom.y * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.g);
-        highp vec2 texPos2_custom;
-        texPos2_custom.x = (quad2_custom.x * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.r);
-        texPos2_custom.y = (quad2_custom.y * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.g);
-        newColor1 = texture2D(lookUpCustom, texPos1_custom).rgb;
-        newColor2 = texture2D(lookUpCustom, texPos2_custom).rgb;
-        vec3 color_custom =
-            mix(newColor1, newColor2, fract(blueColor_custom));
-        color = mix(color, color_custom, whiten);
+        highp vec3 lattice = clamp(color, 0.0, 1.0);
+        highp float blue = lattice.b * 63.0;
+        highp float slice = min(floor(blue), 62.0);
+        highp vec2 texel = lattice.rg * 63.0 + 0.5;
+        highp vec2 low = (tileOrigin(slice) + texel) / lutAtlasSize;
+        highp vec2 high = (tileOrigin(slice + 1.0) + texel) / lutAtlasSize;
+        vec3 skin = mix(texture2D(whitenLut, low).rgb,
+                        texture2D(whitenLut, high).rgb, blue - slice);
+        vec3 custom = mix(texture2D(whitenLut, low + vec2(0.5, 0.0)).rgb,
+                          texture2D(whitenLut, high + vec2(0.5, 0.0)).rgb,
+                          blue - slice);
+        color = mix(skin, custom, whiten);
       }
 
       gl_FragColor = vec4(color, 1.0);
@@ -167,24 +153,59 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
 
     uniform sampler2D inputImageTexture;
     uniform sampler2D inputImageTexture2;
-    uniform sampler2D inputImageTexture3;
-    uniform sampler2D lookUpGray;
-    uniform sampler2D lookUpOrigin;
-    uniform sampler2D lookUpSkin;
-    uniform sampler2D lookUpCustom;
+    uniform sampler2D whitenLut;
 
     uniform float sharpen;
     uniform float blurAlpha;
     uniform float whiten;
-
-    const float levelRangeInv = 1.02657;
-    const float levelBlack = 0.0258820;
-    const float alpha = 0.7;
+    uniform vec2 statisticsTexelSize;
+    uniform float jointUpsample;
+    uniform float statisticsVariance;
+
+    const vec2 lutAtlasSize = vec2(1024.0, 512.0);
+
+    // the 64 blue slices of a table are 64x64 tiles laid out 8 by 8
+    vec2 tileOrigin(float slice) {
+      float row = floor(slice / 8.0);
+      return vec2(slice - row * 8.0, row) * 64.0;
+    }
+
+    // Joint bilateral upsampling of statistics computed at a lower
+    // resolution: the four nearest texels weighted by distance and by how
+    // close their mean is to the pixel, so edges do not bleed.
+    vec4 upsampleStatistics(vec3 guide) {
+      // 1 / (2 sigma^2) for a range sigma of 0.1
+      const float rangeWeight = 50.0;
+      vec2 position = textureCoordinate / statisticsTexelSize - 0.5;
+      vec2 base = floor(position);
+      vec2 f = position - base;
+      vec2 origin = (base + 0.5) * statisticsTexelSize;
+      vec4 s00 = texture2D(inputImageTexture2, origin);
+      vec4 s10 = texture2D(inputImageTexture2,
+                           origin + vec2(statisticsTexelSize.x, 0.0));
+      vec4 s01 = texture2D(inputImageTexture2,
+                           origin + vec2(0.0, statisticsTexelSize.y));
+      vec4 s11 = texture2D(inputImageTexture2, origin + statisticsTexelSize);
+      vec3 d00 = s00.rgb - guide;
+      vec3 d10 = s10.rgb - guide;
+      vec3 d01 = s01.rgb - guide;
+      vec3 d11 = s11.rgb - guide;
+      float w00 = (1.0 - f.x) * (1.0 - f.y) * exp(-dot(d00, d00) * rangeWeight);
+      float w10 = f.x * (1.0 - f.y) * exp(-dot(d10, d10) * rangeWeight);
+      float w01 = (1.0 - f.x) * f.y * exp(-dot(d01, d01) * rangeWeight);
+      float w11 = f.x * f.y * exp(-dot(d11, d11) * rangeWeight);
+      float weight = w00 + w10 + w01 + w11;
+      if (weight < 0.0001) {
+        return texture2D(inputImageTexture2, textureCoordinate);
+      }
+      return (s00 * w00 + s10 * w10 + s01 * w01 + s11 * w11) / weight;
+    }
 
     void main() {
       vec4 iColor = texture2D(inputImageTexture, textureCoordinate);
-      vec4 meanColor = texture2D(inputImageTexture2, textureCoordinate);
-      vec4 varColor = texture2D(inputImageTexture3, textureCoordinate);
+      vec4 meanColor = jointUpsample > 0.0
+                           ? upsampleStatistics(iColor.rgb)
+                           : texture2D(inputImageTexture2, textureCoordinate);
 
   
       vec3 color = iColor.rgb;
@@ -192,7 +213,7 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
         float theta = 0.1;
         float p =
             clamp((min(iColor.r, meanColor.r - 0.1) - 0.2) * 4.0, 0.0, 1.0);
-        float meanVar = (varColor.r + varColor.g + varColor.b) / 3.0;
+        float meanVar = meanColor.a * statisticsVariance;
         float kMin;
         vec3 resultColor;
         kMin = (1.0 - meanVar / (meanVar + theta)) * p * blurAlpha;
@@ -213,70 +234,19 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
         color = resultColor + sharpen * hPass * 2.0;
       }
 
-      // whiten
       if (whiten > 0.0) {
-        vec3 colorEPM = color;
-        color =
-            clamp((colorEPM - vec3(levelBlack)) * levelRangeInv, 0.0, 1.0);
-        vec3 texel = vec3(texture2D(lookUpGray, vec2(color.r, 0.5)).r,
-                          texture2D(lookUpGray, vec2(color.g, 0.5)).g,
-                          texture2D(lookUpGray, vec2(color.b, 0.5)).b);
-        texel = mix(color, texel, 0.5);
-        texel = mix(colorEPM, texel, alpha);
-
-        texel = clamp(texel, 0., 1.);
-        float blueColor = texel.b * 15.0;
-        vec2 quad1;
-        quad1.y = floor(floor(blueColor) * 0.25);
-        quad1.x = floor(blueColor) - (quad1.y * 4.0);
-        vec2 quad2;
-        quad2.y = floor(ceil(blueColor) * 0.25);
-        quad2.x = ceil(blueColor) - (quad2.y * 4.0);
-        vec2 texPos2 = texel.rg * 0.234375 + 0.0078125;
-        vec2 texPos1 = quad1 * 0.25 + texPos2;
-        texPos2 = quad2 * 0.25 + texPos2;
-        vec3 newColor1Origin = texture2D(lookUpOrigin, texPos1).rgb;
-        vec3 newColor2Origin = texture2D(lookUpOrigin, texPos2).rgb;
-        vec3 colorOrigin =
-            mix(newColor1Origin, newColor2Origin, fract(blueColor));
-        texel = mix(colorOrigin, color, alpha);
-
-        texel = clamp(texel, 0., 1.);
-        blueColor = texel.b * 15.0;
-        quad1.y = floor(floor(blueColor) * 0.25);
-        quad1.x = floor(blueColor) - (quad1.y * 4.0);
-        quad2.y = floor(ceil(blueColor) * 0.25);
-        quad2.x = ceil(blueColor) - (quad2.y * 4.0);
-        texPos2 = texel.rg * 0.234375 + 0.0078125;
-        texPos1 = quad1 * 0.25 + texPos2;
-        texPos2 = quad2 * 0.25 + texPos2;
-        vec3 newColor1 = texture2D(lookUpSkin, texPos1).rgb;
-        vec3 newColor2 = texture2D(lookUpSkin, texPos2).rgb;
-        color = mix(newColor1.rgb, newColor2.rgb, fract(blueColor));
-        color = clamp(color, 0., 1.);
-
-        float blueColor_custom = color.b * 63.0;
-        vec2 quad1_custom;
-        quad1_custom.y = floor(floor(blueColor_custom) / 8.0);
-        quad1_custom.x = floor(blueColor_custom) - (quad1_custom.y * 8.0);
-        vec2 quad2_custom;
-        quad2_custom.y = floor(ceil(blueColor_custom) / 8.0);
-        quad2_custom.x = ceil(blueColor_custom) - (quad2_custom.y * 8.0);
-        vec2 texPos1_custom;
-        texPos1_custom.x = (quad1_custom.x * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.r);
-        texPos1_custom.y = (quad1_custom.y * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.g);
-        vec2 texPos2_custom;
-        texPos2_custom.x = (quad2_custom.x * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.r);
-        texPos2_custom.y = (quad2_custom.y * 1.0 / 8.0) + 0.5 / 512.0 +
-                           ((1.0 / 8.0 - 1.0 / 512.0) * color.g);
-        newColor1 = texture2D(lookUpCustom, texPos1_custom).rgb;
-        newColor2 = texture2D(lookUpCustom, texPos2_custom).rgb;
-        vec3 color_custom =
-            mix(newColor1, newColor2, fract(blueColor_custom));
-        color = mix(color, color_custom, whiten);
+        vec3 lattice = clamp(color, 0.0, 1.0);
+        float blue = lattice.b * 63.0;
+        float slice = min(floor(blue), 62.0);
+        vec2 texel = lattice.rg * 63.0 + 0.5;
+        vec2 low = (tileOrigin(slice) + texel) / lutAtlasSize;
+        vec2 high = (tileOrigin(slice + 1.0) + texel) / lutAtlasSize;
+        vec3 skin = mix(texture2D(whitenLut, low).rgb,
+                        texture2D(whitenLut, high).rgb, blue - slice);
+        vec3 custom = mix(texture2D(whitenLut, low + vec2(0.5, 0.0)).rgb,
+                          texture2D(whitenLut, high + vec2(0.5, 0.0)).rgb,
+                          blue - slice);
+        color = mix(skin, custom, whiten);
       }
       
       gl_FragColor = vec4(color, 1.0);
@@ -284,94 +254,194 @@ const std::string kGPUImageBaseBeautyFaceFragmentShaderString = R"(
     })";
 #endif
 
+// Whitening as the four lookup PNGs define it, evaluated over a 64^3
+// lattice of colors. The left table holds the color after the skin lookup,
+// the right one that color through the custom lookup too, so the frame
+// shader blends them by "whiten" after reading both.
+const std::string kBeautyFaceWhitenLutShaderString = R"(
+    #ifdef GL_ES
+    precision highp float;
+    #endif
+    uniform sampler2D lookUpGray;
+    uniform sampler2D lookUpOrigin;
+    uniform sampler2D lookUpSkin;
+    uniform sampler2D lookUpCustom;
+
+    const float levelRangeInv = 1.02657;
+    const float levelBlack = 0.0258820;
+    const float alpha = 0.7;
+
+    // 16^3 tables in 4x4 tiles
+    vec3 lookup16(sampler2D table, vec3 texel) {
+      float blueColor = texel.b * 15.0;
+      vec2 quad1;
+      quad1.y = floor(floor(blueColor) * 0.25);
+      quad1.x = floor(blueColor) - (quad1.y * 4.0);
+      vec2 quad2;
+      quad2.y = floor(ceil(blueColor) * 0.25);
+      quad2.x = ceil(blueColor) - (quad2.y * 4.0);
+      vec2 texPos2 = texel.rg * 0.234375 + 0.0078125;
+      vec2 texPos1 = quad1 * 0.25 + texPos2;
+      texPos2 = quad2 * 0.25 + texPos2;
+      vec3 newColor1 = texture2D(table, texPos1).rgb;
+      vec3 newColor2 = texture2D(table, texPos2).rgb;
+      return mix(newColor1, newColor2, fract(blueColor));
+    }
+
+    // 64^3 tables in 8x8 tiles
+    vec3 lookup64(sampler2D table, vec3 color) {
+      float blueColor = color.b * 63.0;
+      vec2 quad1;
+      quad1.y = floor(floor(blueColor) / 8.0);
+      quad1.x = floor(blueColor) - (quad1.y * 8.0);
+      vec2 quad2;
+      quad2.y = floor(ceil(blueColor) / 8.0);
+      quad2.x = ceil(blueColor) - (quad2.y * 8.0);
+      vec2 texPos1 = quad1 / 8.0 + 0.5 / 512.0 +
+                     (1.0 / 8.0 - 1.0 / 512.0) * color.rg;
+      vec2 texPos2 = quad2 / 8.0 + 0.5 / 512.0 +
+                     (1.0 / 8.0 - 1.0 / 512.0) * color.rg;
+      vec3 newColor1 = texture2D(table, texPos1).rgb;
+      vec3 newColor2 = texture2D(table, texPos2).rgb;
+      return mix(newColor1, newColor2, fract(blueColor));
+    }
+
+    void main() {
+      vec2 lutTexel = floor(gl_FragCoord.xy);
+      float table = floor(lutTexel.x / 512.0);
+      lutTexel.x -= table * 512.0;
+      vec2 tile = floor(lutTexel / 64.0);
+      vec3 colorEPM =
+          vec3(lutTexel - tile * 64.0, tile.y * 8.0 + tile.x) / 63.0;
+
+      vec3 color =
+          clamp((colorEPM - vec3(levelBlack)) * levelRangeInv, 0.0, 1.0);
+      vec3 texel = vec3(texture2D(lookUpGray, vec2(color.r, 0.5)).r,
+                        texture2D(lookUpGray, vec2(color.g, 0.5)).g,
+                        texture2D(lookUpGray, vec2(color.b, 0.5)).b);
+      texel = mix(color, texel, 0.5);
+      texel = mix(colorEPM, texel, alpha);
+
+      texel = clamp(texel, 0., 1.);
+      texel = mix(lookup16(lookUpOrigin, texel), color, alpha);
+
+      texel = clamp(texel, 0., 1.);
+      color = clamp(lookup16(lookUpSkin, texel), 0., 1.);
+      if (table > 0.5) {
+        color = lookup64(lookUpCustom, color);
+      }
+      gl_FragColor = vec4(color, 1.0);
+    })";
+
 BeautyFaceUnitFilter::BeautyFaceUnitFilter() {}
 
 BeautyFaceUnitFilter::~BeautyFaceUnitFilter() {}
 
 std::shared_ptr<BeautyFaceUnitFilter> BeautyFaceUnitFilter::create() {
   auto ret = std::shared_ptr<BeautyFaceUnitFilter>(new BeautyFaceUnitFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool BeautyFaceUnitFilter::init() {
   if (!Filter::initWithShaderString(kGPUImageBaseBeautyFaceVertexShaderString,
                                     kGPUImageBaseBeautyFaceFragmentShaderString,
-                                    3)) {
+                                    2)) {
     return false;
   }
 
-  grayImage_ = SourceImage::create(Util::getResourcePath("lookup_gray.png"));
-  originImage_ = SourceImage::create(Util::getResourcePath("lookup_origin.png"));
-  skinImage_ = SourceImage::create(Util::getResourcePath("lookup_skin.png"));
-  customImage_ = SourceImage::create(Util::getResourcePath("lookup_light.png"));
+  return _bakeWhitenLut();
+}
+
+bool BeautyFaceUnitFilter::_bakeWhitenLut() {
+  // only needed until the table is baked
+  std::shared_ptr<SourceImage> lookups[] = {
+      SourceImage::create(Util::getResourcePath("lookup_gray.png")),
+      SourceImage::create(Util::getResourcePath("lookup_origin.png")),
+      SourceImage::create(Util::getResourcePath("lookup_skin.png")),
+      SourceImage::create(Util::getResourcePath("lookup_light.png"))};
+  const char* uniforms[] = {"lookUpGray", "lookUpOrigin", "lookUpSkin",
+                            "lookUpCustom"};
+  GLProgram* program = GLProgram::createByShaderString(
+      kDefaultVertexShader, kBeautyFaceWhitenLutShaderString);
+  if (!program) {
+    return false;
+  }
+
+  // creating the table texture unbinds the active unit, fetch it first
+  whitenLut_ = _context->getFramebufferCache()->fetchFramebuffer(1024, 512);
+  _context->setActiveShaderProgram(program);
+  for (int i = 0; i < 4; ++i) {
+    if (!lookups[i] || !lookups[i]->getFramebuffer()) {
+      Util::Log("ERROR", "BeautyFaceUnitFilter: missing lookup image");
+      delete program;
+      return false;
+    }
+    _context->getGLStateCache()->bindTexture(
+        i, lookups[i]->getFramebuffer()->getTexture());
+    program->setUniformValue(uniforms[i], i);
+  }
+  whitenLut_->active();
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(program->getAttribLocation("position"),
+             program->getAttribLocation("inputTextureCoordinate"),
+             NoRotation);
+  quad->draw();
+  whitenLut_->inactive();
+  delete program;
   return true;
 }
 
 bool BeautyFaceUnitFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  static const GLfloat imageVertices[] = {
-      -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
-  };
-
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  _context->setActiveShaderProgram(_filterProgram);
   _framebuffer->active();
-  CHECK_GL(glClearColor(_backgroundColor.r, _backgroundColor.g,
-                        _backgroundColor.b, _backgroundColor.a));
+  _context->getGLStateCache()->clearColor(
+      _backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+      _backgroundColor.a);
   CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
 
-  CHECK_GL(glActiveTexture(GL_TEXTURE2));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[0].frameBuffer->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      2, _inputFramebuffers[0].frameBuffer->getTexture());
   _filterProgram->setUniformValue("inputImageTexture", 2);
 
-  CHECK_GL(glActiveTexture(GL_TEXTURE3));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[1].frameBuffer->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      3, _inputFramebuffers[1].frameBuffer->getTexture());
   _filterProgram->setUniformValue("inputImageTexture2", 3);
 
-  CHECK_GL(glActiveTexture(GL_TEXTURE4));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[2].frameBuffer->getTexture()));
-  _filterProgram->setUniformValue("inputImageTexture3", 4);
-
-  // texcoord attribute
-  GLuint filterTexCoordAttribute =
-      _filterProgram->getAttribLocation("inputTextureCoordinate");
-  CHECK_GL(glEnableVertexAttribArray(filterTexCoordAttribute));
-  CHECK_GL(glVertexAttribPointer(
-      filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
-      _getTexureCoordinate(_inputFramebuffers[0].rotationMode)));
-
-  glActiveTexture(GL_TEXTURE5);
-  glBindTexture(GL_TEXTURE_2D, grayImage_->getFramebuffer()->getTexture());
-  _filterProgram->setUniformValue("lookUpGray", 5);
-
-  glActiveTexture(GL_TEXTURE6);
-  glBindTexture(GL_TEXTURE_2D, originImage_->getFramebuffer()->getTexture());
-  _filterProgram->setUniformValue("lookUpOrigin", 6);
+  _context->getGLStateCache()->bindTexture(5, whitenLut_->getTexture());
+  _filterProgram->setUniformValue("whitenLut", 5);
 
-  glActiveTexture(GL_TEXTURE7);
-  glBindTexture(GL_TEXTURE_2D, skinImage_->getFramebuffer()->getTexture());
-  _filterProgram->setUniformValue("lookUpSkin", 7);
-
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, customImage_->getFramebuffer()->getTexture());
-  _filterProgram->setUniformValue("lookUpCustom", 0);
-
-  // vertex position
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
+  // statistics computed at a lower resolution
+  std::shared_ptr<Framebuffer> statistics = _inputFramebuffers[1].frameBuffer;
+  bool upsample = statistics->getWidth() < _framebuffer->getWidth() ||
+                  statistics->getHeight() < _framebuffer->getHeight();
+  _filterProgram->setUniformValue(
+      "jointUpsample", jointUpsampling_ && upsample ? 1.0f : 0.0f);
+  _filterProgram->setUniformValue(
+      "statisticsTexelSize", Vector2(1.0f / statistics->getWidth(),
+                                     1.0f / statistics->getHeight()));
 
   _filterProgram->setUniformValue("sharpen", sharpen_);
   _filterProgram->setUniformValue("blurAlpha", blurAlpha_);
   _filterProgram->setUniformValue("whiten", white_);
+  _filterProgram->setUniformValue("statisticsVariance",
+                                  statisticsVariance_ ? 1.0f : 0.0f);
 
   // draw
-  CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute,
+             _filterProgram->getAttribLocation("inputTextureCoordinate"),
+             _inputFramebuffers[0].rotationMode);
+  quad->draw();
 
   _framebuffer->inactive();
+  profiler->endScope(profileScope);
 
   return Source::proceed(bUpdateTargets, frameTime);
 }
@@ -384,6 +454,14 @@ void BeautyFaceUnitFilter::setBlurAlpha(float blurAlpha) {
   blurAlpha_ = blurAlpha;
 }
 
+void BeautyFaceUnitFilter::setJointUpsampling(bool enabled) {
+  jointUpsampling_ = enabled;
+}
+
+void BeautyFaceUnitFilter::setStatisticsVariance(bool enabled) {
+  statisticsVariance_ = enabled;
+}
+
 void BeautyFaceUnitFilter::setWhite(float white) {
 #if defined(GPUPIXEL_MAC)
   white_ = white / 10;
@@ -11,8 +11,12 @@
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class SourceImage;
 
+// Input 0 is the image, input 1 its box mean with the variance in alpha,
+// see BoxMeanVarianceFilter. Input 1 may be smaller than the image, it is
+// then upsampled bilinearly or, with joint upsampling on, guided by the
+// image. Without the variance in alpha, input 1 is an already edge
+// preserving smoothing of the image, mixed in as it is.
 class GPUPIXEL_API BeautyFaceUnitFilter : public Filter {
  public:
   static std::shared_ptr<BeautyFaceUnitFilter> create();
@@ -23,19 +27,25 @@ class GPUPIXEL_API BeautyFaceUnitFilter : public Filter {
   void setSharpen(float sharpen);
   void setBlurAlpha(float blurAlpha);
   void setWhite(float white);
+  void setJointUpsampling(bool enabled);
+  // whether input 1 carries the variance in alpha, on by default
+  void setStatisticsVariance(bool enabled);
 
  protected:
   BeautyFaceUnitFilter();
 
-  std::shared_ptr<SourceImage> grayImage_;
-  std::shared_ptr<SourceImage> originImage_;
-  std::shared_ptr<SourceImage> skinImage_;
-  std::shared_ptr<SourceImage> customImage_;
+  // the whitening of the lookup PNGs baked into one table, see
+  // _bakeWhitenLut()
+  std::shared_ptr<Framebuffer> whitenLut_;
 
  private:
+  bool _bakeWhitenLut();
+
   float sharpen_ = 0.0;
   float blurAlpha_ = 0.0;
   float white_ = 0.0;
+  bool jointUpsampling_ = true;
+  bool statisticsVariance_ = true;
 };
 
 NS_GPUPIXEL_END
@@ -6,6 +6,9 @@
  */
 
 #include "bilateral_filter.h"
+#include <cmath>
+#include <typeinfo>
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -208,18 +211,55 @@ const std::string kBilateralBlurFragmentShaderString = R"(
       gl_FragColor = sum / gaussianWeightTotal;
     })";
 #endif
+// the taps of the fragment shader read from the tile of a line pass
+const std::string kBilateralBlurComputeDeclarations = R"(
+    uniform int texelSpacing;
+    uniform float distanceNormalizationFactor;
+    const float gaussianWeights[5] =
+        float[5](0.18, 0.15, 0.12, 0.09, 0.05);
+)";
+
+const std::string kBilateralBlurComputeBody = R"(
+      vec4 centralColor = tile[center];
+      float gaussianWeightTotal = 0.18;
+      vec4 result = centralColor * 0.18;
+      for (int i = 1; i <= 4; ++i) {
+        for (int side = -1; side <= 1; side += 2) {
+          vec4 sampleColor = tile[center + side * i * texelSpacing];
+          float distanceFromCentralColor = min(
+              distance(centralColor, sampleColor) * distanceNormalizationFactor,
+              1.0);
+          float gaussianWeight =
+              gaussianWeights[i] * (1.0 - distanceFromCentralColor);
+          gaussianWeightTotal += gaussianWeight;
+          result += sampleColor * gaussianWeight;
+        }
+      }
+      result /= gaussianWeightTotal;
+)";
+
 BilateralMonoFilter::BilateralMonoFilter(Type type)
     : _type(type),
       _texelSpacingMultiplier(4.0),
-      _distanceNormalizationFactor(8.0) {}
+      _distanceNormalizationFactor(8.0),
+      _computeProgram(nullptr) {}
+
+BilateralMonoFilter::~BilateralMonoFilter() {
+  if (_computeProgram) {
+    delete _computeProgram;
+    _computeProgram = nullptr;
+  }
+}
 
 std::shared_ptr<BilateralMonoFilter> BilateralMonoFilter::create(
     Type type /* = HORIZONTAL*/) {
   auto ret =
       std::shared_ptr<BilateralMonoFilter>(new BilateralMonoFilter(type));
-  if (!ret || !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!ret || !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -232,8 +272,10 @@ bool BilateralMonoFilter::init() {
 }
 
 bool BilateralMonoFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  std::shared_ptr<Framebuffer> inputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
+  if (_usesCompute() && _updateComputeProgram()) {
+    return _proceedCompute(bUpdateTargets, frameTime);
+  }
+
   RotationMode inputRotation = _inputFramebuffers.begin()->second.rotationMode;
 
   if (rotationSwapsSize(inputRotation)) {
@@ -267,6 +309,51 @@ bool BilateralMonoFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
   return Filter::proceed(bUpdateTargets, frameTime);
 }
 
+bool BilateralMonoFilter::_usesCompute() {
+  return _texelSpacingMultiplier >= 1.0 &&
+         _texelSpacingMultiplier == std::floor(_texelSpacingMultiplier) &&
+         _texelSpacingMultiplier * 4 <= GLCompute::kMaxLineApron &&
+         _canComputeLines();
+}
+
+bool BilateralMonoFilter::_updateComputeProgram() {
+  std::string imageFormat =
+      GLCompute::getImageFormat(_framebuffer->getTextureAttributes());
+  // a framebuffer fetched for a capture is no image
+  if (imageFormat.empty()) {
+    return false;
+  }
+  // a program that failed to link is not retried for the same format
+  if (imageFormat != _computeImageFormat) {
+    if (_computeProgram) {
+      delete _computeProgram;
+    }
+    _computeProgram = GLProgram::createByComputeShaderString(
+        GLCompute::generateLineShaderString(
+            imageFormat, "vec4", "texelFetch(inputImageTexture, texel, 0)",
+            kBilateralBlurComputeDeclarations, kBilateralBlurComputeBody,
+            "result"));
+    _computeImageFormat = imageFormat;
+  }
+  return _computeProgram != nullptr;
+}
+
+bool BilateralMonoFilter::_proceedCompute(bool bUpdateTargets,
+                                          int64_t frameTime) {
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  int spacing = (int)_texelSpacingMultiplier;
+  _computeProgram->setUniformValue("texelSpacing", spacing);
+  _computeProgram->setUniformValue("distanceNormalizationFactor",
+                                   _distanceNormalizationFactor);
+  _context->getGLCompute()->dispatchLines(
+      _computeProgram, _inputFramebuffers.begin()->second.frameBuffer.get(),
+      _framebuffer.get(), _type == HORIZONTAL, spacing * 4);
+  profiler->endScope(profileScope);
+
+  return Source::proceed(bUpdateTargets, frameTime);
+}
+
 void BilateralMonoFilter::setTexelSpacingMultiplier(float multiplier) {
   _texelSpacingMultiplier = multiplier;
 }
@@ -283,9 +370,11 @@ BilateralFilter::~BilateralFilter() {}
 
 std::shared_ptr<BilateralFilter> BilateralFilter::create() {
   auto ret = std::shared_ptr<BilateralFilter>(new BilateralFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
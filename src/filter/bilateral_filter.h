@@ -16,6 +16,7 @@ class GPUPIXEL_API BilateralMonoFilter : public Filter {
   enum Type { HORIZONTAL, VERTICAL };
 
   static std::shared_ptr<BilateralMonoFilter> create(Type type = HORIZONTAL);
+  ~BilateralMonoFilter();
   bool init();
 
   virtual bool proceed(bool bUpdateTargets = true,
@@ -26,9 +27,18 @@ class GPUPIXEL_API BilateralMonoFilter : public Filter {
 
  protected:
   BilateralMonoFilter(Type type);
+  // A line pass of GLCompute where the context has them, the input is read
+  // at its size and the spacing is whole texels, see GLCompute.
+  bool _usesCompute() override;
+  // false when the framebuffer is no image or the program does not link
+  bool _updateComputeProgram();
+  bool _proceedCompute(bool bUpdateTargets, int64_t frameTime);
+
   Type _type;
   float _texelSpacingMultiplier;
   float _distanceNormalizationFactor;
+  GLProgram* _computeProgram;
+  std::string _computeImageFormat;
 };
 
 class GPUPIXEL_API BilateralFilter : public FilterGroup {
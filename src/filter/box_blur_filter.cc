@@ -6,6 +6,7 @@
  */
 
 #include "box_blur_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -16,9 +17,11 @@ BoxBlurFilter::~BoxBlurFilter() {}
 std::shared_ptr<BoxBlurFilter> BoxBlurFilter::create(int radius /* = 4*/,
                                                      float sigma /* = 2.0*/) {
   auto ret = std::shared_ptr<BoxBlurFilter>(new BoxBlurFilter());
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
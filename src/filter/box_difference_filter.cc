@@ -6,6 +6,7 @@
  */
 
 #include "box_difference_filter.h"
+#include <typeinfo>
 #include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
@@ -59,9 +60,11 @@ BoxDifferenceFilter::~BoxDifferenceFilter() {}
 
 std::shared_ptr<BoxDifferenceFilter> BoxDifferenceFilter::create() {
   auto ret = std::shared_ptr<BoxDifferenceFilter>(new BoxDifferenceFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -82,49 +85,39 @@ bool BoxDifferenceFilter::init() {
 }
 
 bool BoxDifferenceFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  static const GLfloat imageVertices[] = {
-      -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
-  };
-
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  _context->setActiveShaderProgram(_filterProgram);
   _framebuffer->active();
-  CHECK_GL(glClearColor(_backgroundColor.r, _backgroundColor.g,
-                        _backgroundColor.b, _backgroundColor.a));
+  _context->getGLStateCache()->clearColor(
+      _backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+      _backgroundColor.a);
   CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
 
   // Texture 0
-  CHECK_GL(glActiveTexture(GL_TEXTURE0));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[0].frameBuffer->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      0, _inputFramebuffers[0].frameBuffer->getTexture());
   _filterProgram->setUniformValue("inputImageTexture", 0);
 
   // Texture 1
-  CHECK_GL(glActiveTexture(GL_TEXTURE1));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[1].frameBuffer->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      1, _inputFramebuffers[1].frameBuffer->getTexture());
   _filterProgram->setUniformValue("inputImageTexture2", 1);
 
-  CHECK_GL(glEnableVertexAttribArray(filterTexCoordAttribute_));
-  CHECK_GL(glVertexAttribPointer(
-      filterTexCoordAttribute_, 2, GL_FLOAT, 0, 0,
-      _getTexureCoordinate(_inputFramebuffers[0].rotationMode)));
-
-  CHECK_GL(glEnableVertexAttribArray(filterTexCoordAttribute2_));
-  CHECK_GL(glVertexAttribPointer(
-      filterTexCoordAttribute2_, 2, GL_FLOAT, 0, 0,
-      _getTexureCoordinate(_inputFramebuffers[1].rotationMode)));
-
-  // vertex position
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-
   // update uniform
   _filterProgram->setUniformValue("delta", delta_);
 
   // draw
-  CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute,
+             {{(GLint)filterTexCoordAttribute_,
+               _inputFramebuffers[0].rotationMode},
+              {(GLint)filterTexCoordAttribute2_,
+               _inputFramebuffers[1].rotationMode}});
+  quad->draw();
 
   _framebuffer->inactive();
+  profiler->endScope(profileScope);
 
   return Source::proceed(bUpdateTargets, frameTime);
 }
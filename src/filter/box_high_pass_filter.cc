@@ -6,6 +6,7 @@
  */
 
 #include "box_high_pass_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -15,9 +16,11 @@ BoxHighPassFilter::~BoxHighPassFilter() {}
 
 std::shared_ptr<BoxHighPassFilter> BoxHighPassFilter::create() {
   auto ret = std::shared_ptr<BoxHighPassFilter>(new BoxHighPassFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
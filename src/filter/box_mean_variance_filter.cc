@@ -0,0 +1,107 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "box_mean_variance_filter.h"
+#include <algorithm>
+#include "gpupixel_context.h"
+
+NS_GPUPIXEL_BEGIN
+
+BoxMeanVarianceFilter::BoxMeanVarianceFilter()
+    : BoxMonoBlurFilter(VERTICAL), delta_(7.07) {}
+
+BoxMeanVarianceFilter::~BoxMeanVarianceFilter() {}
+
+std::shared_ptr<BoxMeanVarianceFilter> BoxMeanVarianceFilter::create(
+    int radius /* = 4*/) {
+  auto ret =
+      std::shared_ptr<BoxMeanVarianceFilter>(new BoxMeanVarianceFilter());
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius)) {
+      ret.reset();
+    }
+  });
+  return ret;
+}
+
+bool BoxMeanVarianceFilter::init(int radius) {
+  _radius = radius;
+  _sigma = 0.0;
+  _inputNum = 2;
+  return _updateProgram();
+}
+
+bool BoxMeanVarianceFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
+  _filterProgram->setUniformValue("delta", delta_);
+  return BoxMonoBlurFilter::proceed(bUpdateTargets, frameTime);
+}
+
+void BoxMeanVarianceFilter::setDelta(float delta) {
+  delta_ = delta;
+}
+
+std::string BoxMeanVarianceFilter::_generateOptimizedVertexShaderString(
+    int radius,
+    float sigma) {
+  // the variance reads blurCoordinates[0], a radius below 1 would drop it
+  return BoxMonoBlurFilter::_generateOptimizedVertexShaderString(
+      std::max(radius, 1), sigma);
+}
+
+std::string BoxMeanVarianceFilter::_generateOptimizedFragmentShaderString(
+    int radius,
+    float sigma) {
+  return _addVariance(BoxMonoBlurFilter::_generateOptimizedFragmentShaderString(
+      std::max(radius, 1), sigma));
+}
+
+std::string BoxMeanVarianceFilter::_generateKernelFragmentShaderString() {
+  return _addVariance(BoxMonoBlurFilter::_generateKernelFragmentShaderString());
+}
+
+std::string BoxMeanVarianceFilter::_addVariance(const std::string& blur) {
+  // the blur reads the horizontal pass, input 1 as Filter::proceed() names it
+  std::string shaderStr;
+  size_t begin = 0;
+  size_t end = 0;
+  const std::string name = "inputImageTexture";
+  while ((end = blur.find(name, begin)) != std::string::npos) {
+    shaderStr.append(blur, begin, end - begin);
+    shaderStr += "inputImageTexture1";
+    begin = end + name.size();
+  }
+  shaderStr.append(blur, begin, std::string::npos);
+
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
+  shaderStr =
+      "uniform sampler2D inputImageTexture;\n"
+      "uniform highp float delta;\n" +
+      shaderStr;
+  const std::string footer =
+      "highp vec3 diffColor =\n"
+      "    (texture2D(inputImageTexture, blurCoordinates[0]).rgb - sum.rgb) *\n"
+      "    delta;\n";
+#else
+  shaderStr =
+      "uniform sampler2D inputImageTexture;\n"
+      "uniform float delta;\n" +
+      shaderStr;
+  const std::string footer =
+      "vec3 diffColor =\n"
+      "    (texture2D(inputImageTexture, blurCoordinates[0]).rgb - sum.rgb) *\n"
+      "    delta;\n";
+#endif
+  const std::string output = "gl_FragColor = sum;";
+  shaderStr.replace(shaderStr.find(output), output.size(),
+                    footer +
+                        "diffColor = min(diffColor * diffColor, 1.0);\n"
+                        "gl_FragColor = vec4(sum.rgb, (diffColor.r +\n"
+                        "    diffColor.g + diffColor.b) / 3.0);");
+  return shaderStr;
+}
+
+NS_GPUPIXEL_END
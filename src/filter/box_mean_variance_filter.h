@@ -0,0 +1,48 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include "box_mono_blur_filter.h"
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+// The vertical pass of a box blur that also measures how far the input
+// strays from the blurred result. Input 0 is the image, input 1 its
+// horizontal box blur. The output holds the mean in rgb and, in alpha,
+// min(((image - mean) * delta)^2, 1) averaged over the channels, which
+// BoxHighPassFilter computes per channel with a second blur and a pass of
+// its own.
+class GPUPIXEL_API BoxMeanVarianceFilter : public BoxMonoBlurFilter {
+ public:
+  static std::shared_ptr<BoxMeanVarianceFilter> create(int radius = 4);
+  ~BoxMeanVarianceFilter();
+  bool init(int radius);
+  virtual bool proceed(bool bUpdateTargets = true,
+                       int64_t frameTime = 0) override;
+
+  void setDelta(float delta);
+
+ protected:
+  BoxMeanVarianceFilter();
+
+  // the variance reads the image in the same pass
+  bool _canUsePrefixSums() const override { return false; }
+  bool _canUseCompute() const override { return false; }
+
+  std::string _generateOptimizedVertexShaderString(int radius,
+                                                   float sigma) override;
+  std::string _generateOptimizedFragmentShaderString(int radius,
+                                                     float sigma) override;
+  std::string _generateKernelFragmentShaderString() override;
+  // the blur shader |blur| turned into the pass described above
+  static std::string _addVariance(const std::string& blur);
+
+  float delta_;
+};
+
+NS_GPUPIXEL_END
@@ -6,47 +6,255 @@
  */
 
 #include "box_mono_blur_filter.h"
+#include "gpupixel_context.h"
 #include <cmath>
+#include <typeinfo>
 NS_GPUPIXEL_BEGIN
 
+// below it reading the texels costs less than the prefix sum passes
+const int BoxMonoBlurFilter::kMinPrefixSumRadius = 32;
+
+// reads per prefix sum pass, each pass multiplies the stride by as much
+static const int kScanReads = 8;
+
+// Adds kScanReads texels |scanStride| apart along |scanAxis|, ending with the
+// texel of the fragment. Starting at a stride of 1 over the image, every
+// pass leaves the sum of all the texels up to the fragment in
+// kScanReads times as many. The image is centered around 0 first, keeping
+// the sums small.
+const std::string kBoxPrefixScanFragmentShaderString = R"(
+    #ifdef GL_ES
+    precision highp float;
+    #endif
+    uniform sampler2D inputImageTexture;
+    uniform vec2 scanAxis;
+    uniform float scanSize;
+    uniform float scanStride;
+    uniform float scanCenter;
+    varying vec2 textureCoordinate;
+
+    void main() {
+      float index = floor(dot(textureCoordinate, scanAxis) * scanSize);
+      vec4 sum = vec4(0.0);
+      for (int i = 0; i < 8; ++i) {
+        float offset = float(i) * scanStride;
+        if (offset <= index) {
+          sum += texture2D(inputImageTexture,
+                           textureCoordinate - scanAxis * offset / scanSize) -
+                 scanCenter;
+        }
+      }
+      gl_FragColor = sum;
+    })";
+
+// The sum of the texels before a boundary between texels is the prefix sum
+// of the texel before it. Between boundaries it is interpolated, past the
+// edges it goes on with the outermost texels, as clamped reads would.
+const std::string kBoxPrefixFragmentShaderString = R"(
+    #ifdef GL_ES
+    precision highp float;
+    #endif
+    uniform sampler2D inputImageTexture;
+    uniform vec2 scanAxis;
+    uniform float scanSize;
+    uniform float boxRadius;
+    varying vec2 textureCoordinate;
+
+    vec4 boundarySum(float boundary) {
+      if (boundary < 0.5) {
+        return vec4(0.0);
+      }
+      float offset =
+          (boundary - 0.5) / scanSize - dot(textureCoordinate, scanAxis);
+      return texture2D(inputImageTexture,
+                       textureCoordinate + scanAxis * offset);
+    }
+
+    vec4 prefixSum(float position) {
+      float clamped = clamp(position, 0.0, scanSize);
+      float low = floor(clamped);
+      float high = min(low + 1.0, scanSize);
+      vec4 sum = mix(boundarySum(low), boundarySum(high), clamped - low);
+      if (position < 0.0) {
+        sum += position * boundarySum(1.0);
+      } else if (position > scanSize) {
+        vec4 last = boundarySum(scanSize) - boundarySum(scanSize - 1.0);
+        sum += (position - scanSize) * last;
+      }
+      return sum;
+    }
+
+    void main() {
+      float position = dot(textureCoordinate, scanAxis) * scanSize;
+      vec4 sum = prefixSum(position + boxRadius) -
+                 prefixSum(position - boxRadius);
+      gl_FragColor = sum / (2.0 * boxRadius) + 0.5;
+    })";
+
 BoxMonoBlurFilter::BoxMonoBlurFilter(Type type)
     : GaussianBlurMonoFilter(type) {}
 
-BoxMonoBlurFilter::~BoxMonoBlurFilter() {}
+BoxMonoBlurFilter::~BoxMonoBlurFilter() {
+  if (scanProgram_) {
+    delete scanProgram_;
+    scanProgram_ = nullptr;
+  }
+  if (boxProgram_) {
+    delete boxProgram_;
+    boxProgram_ = nullptr;
+  }
+}
 
 std::shared_ptr<BoxMonoBlurFilter> BoxMonoBlurFilter::create(Type type,
                                                              int radius,
                                                              float sigma) {
   auto ret = std::shared_ptr<BoxMonoBlurFilter>(new BoxMonoBlurFilter(type));
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool BoxMonoBlurFilter::init(int radius, float sigma) {
-  if (Filter::initWithShaderString(
-          _generateOptimizedVertexShaderString(radius, sigma),
-          _generateOptimizedFragmentShaderString(radius, sigma))) {
-    return true;
-  }
-  return false;
+  _radius = radius;
+  _sigma = sigma;
+  return _updateProgram();
 }
 
 void BoxMonoBlurFilter::setRadius(int radius) {
   float newBlurRadius =
       std::round(std::round(radius / 2.0) * 2.0);  // For now, only do even radii
 
-  if (newBlurRadius != _radius) {
-    _radius = newBlurRadius;
+  _radius = newBlurRadius;
+  // a uniform of the prefix sum passes
+  if (_usesPrefixSums()) {
+    return;
+  }
+  _updateProgram();
+}
 
-    if (_filterProgram) {
-      delete _filterProgram;
-      _filterProgram = 0;
+std::shared_ptr<const GaussianBlurMonoFilter::Kernel>
+BoxMonoBlurFilter::_getKernel(int radius, float sigma) {
+  auto kernel = std::make_shared<Kernel>();
+  kernel->centerWeight = 1.0;
+  if (radius >= 1) {
+    float boxWeight = 1.0 / (GLfloat)((radius * 2) + 1);
+    kernel->centerWeight = boxWeight;
+    for (int i = 0; i < radius / 2 + (radius % 2); ++i) {
+      kernel->weights.push_back(boxWeight * 2.0);
+      kernel->offsets.push_back((GLfloat)(i * 2) + 1.5);
     }
-    initWithShaderString(_generateOptimizedVertexShaderString(_radius, 0.0),
-                         _generateOptimizedFragmentShaderString(_radius, 0.0));
   }
+  return kernel;
+}
+
+bool BoxMonoBlurFilter::_usesPrefixSums() {
+  return _radius >= kMinPrefixSumRadius && _canUsePrefixSums() &&
+         !prefixSumsFailed_ && _context->isFloatRenderTargetSupported();
+}
+
+bool BoxMonoBlurFilter::_usesCompute() {
+  return !_usesPrefixSums() && GaussianBlurMonoFilter::_usesCompute();
+}
+
+bool BoxMonoBlurFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
+  if (_usesPrefixSums()) {
+    return _proceedPrefixSums(bUpdateTargets, frameTime);
+  }
+  // back from the prefix sums
+  _updateProgram();
+  return GaussianBlurMonoFilter::proceed(bUpdateTargets, frameTime);
+}
+
+bool BoxMonoBlurFilter::_proceedPrefixSums(bool bUpdateTargets,
+                                           int64_t frameTime) {
+#if defined(GL_RGBA32F)
+  const InputFrameBufferInfo& input = _inputFramebuffers.begin()->second;
+  int width = input.frameBuffer->getWidth();
+  int height = input.frameBuffer->getHeight();
+  // the blurred axis in the texture of the input, as proceed() of the
+  // gaussian blur picks it
+  bool swapsSize = rotationSwapsSize(input.rotationMode);
+  bool alongWidth = (_type == HORIZONTAL) != swapsSize;
+  float outputSize = _type == HORIZONTAL ? _framebuffer->getWidth()
+                                         : _framebuffer->getHeight();
+  float spacing =
+      _type == HORIZONTAL ? verticalTexelSpacing_ : horizontalTexelSpacing_;
+  float scanSize = alongWidth ? width : height;
+  Vector2 scanAxis = alongWidth ? Vector2(1.0, 0.0) : Vector2(0.0, 1.0);
+
+  if (!scanProgram_) {
+    scanProgram_ = GLProgram::createByShaderString(
+        kDefaultVertexShader, kBoxPrefixScanFragmentShaderString);
+    boxProgram_ = GLProgram::createByShaderString(
+        kDefaultVertexShader, kBoxPrefixFragmentShaderString);
+  }
+  // the driver can not link them, the uniform program blurs from now on
+  if (!scanProgram_ || !boxProgram_) {
+    delete scanProgram_;
+    scanProgram_ = nullptr;
+    delete boxProgram_;
+    boxProgram_ = nullptr;
+    prefixSumsFailed_ = true;
+    return proceed(bUpdateTargets, frameTime);
+  }
+
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  // fetched before binding any texture, creating one unbinds the active unit
+  static const TextureAttributes kPrefixSumAttributes = {
+      GL_NEAREST, GL_NEAREST, GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE,
+      GL_RGBA32F, GL_RGBA,    GL_FLOAT,         false};
+  FramebufferCache* framebufferCache = _context->getFramebufferCache();
+  std::shared_ptr<Framebuffer> sums[2] = {
+      framebufferCache->fetchFramebuffer(width, height, false,
+                                         kPrefixSumAttributes),
+      framebufferCache->fetchFramebuffer(width, height, false,
+                                         kPrefixSumAttributes)};
+
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  GLStateCache* glState = _context->getGLStateCache();
+  _context->setActiveShaderProgram(scanProgram_);
+  scanProgram_->setUniformValue("inputImageTexture", 0);
+  scanProgram_->setUniformValue("scanAxis", scanAxis);
+  scanProgram_->setUniformValue("scanSize", scanSize);
+  quad->bind(scanProgram_->getAttribLocation("position"),
+             scanProgram_->getAttribLocation("inputTextureCoordinate"),
+             NoRotation);
+  GLuint source = input.frameBuffer->getTexture();
+  int target = 0;
+  for (float stride = 1.0; stride < scanSize; stride *= kScanReads) {
+    sums[target]->active();
+    glState->bindTexture(0, source);
+    scanProgram_->setUniformValue("scanStride", stride);
+    scanProgram_->setUniformValue("scanCenter", stride == 1.0 ? 0.5f : 0.0f);
+    quad->draw();
+    source = sums[target]->getTexture();
+    target = 1 - target;
+  }
+
+  _framebuffer->active();
+  _context->setActiveShaderProgram(boxProgram_);
+  glState->bindTexture(0, source);
+  boxProgram_->setUniformValue("inputImageTexture", 0);
+  boxProgram_->setUniformValue("scanAxis", scanAxis);
+  boxProgram_->setUniformValue("scanSize", scanSize);
+  // the texels the reads of the optimized shader would span
+  boxProgram_->setUniformValue(
+      "boxRadius", (float)((_radius + 0.5) * spacing * scanSize / outputSize));
+  quad->bind(boxProgram_->getAttribLocation("position"),
+             boxProgram_->getAttribLocation("inputTextureCoordinate"),
+             input.rotationMode);
+  quad->draw();
+  _framebuffer->inactive();
+  profiler->endScope(profileScope);
+
+  return Source::proceed(bUpdateTargets, frameTime);
+#else
+  return GaussianBlurMonoFilter::proceed(bUpdateTargets, frameTime);
+#endif
 }
 
 std::string BoxMonoBlurFilter::_generateOptimizedVertexShaderString(
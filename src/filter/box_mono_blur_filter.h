@@ -12,6 +12,12 @@
 #include "gaussian_blur_mono_filter.h"
 
 NS_GPUPIXEL_BEGIN
+// From kMinPrefixSumRadius on, where float framebuffers can be rendered to,
+// the box is the difference of two prefix sums along the blurred axis
+// rather than a read of every other texel. A few passes of 8 reads each
+// accumulate the sums, so the cost no longer depends on the radius, which is
+// a uniform there and changes without building a program. The box then spans
+// the texel spacing continuously rather than reading every spaced texel.
 class GPUPIXEL_API BoxMonoBlurFilter : public GaussianBlurMonoFilter {
  public:
   static std::shared_ptr<BoxMonoBlurFilter> create(Type type = HORIZONTAL,
@@ -20,14 +26,32 @@ class GPUPIXEL_API BoxMonoBlurFilter : public GaussianBlurMonoFilter {
   ~BoxMonoBlurFilter();
   bool init(int radius, float sigma);
   void setRadius(int radius);
+  virtual bool proceed(bool bUpdateTargets = true,
+                       int64_t frameTime = 0) override;
+
+  static const int kMinPrefixSumRadius;
 
  protected:
   BoxMonoBlurFilter(Type type);
 
+  // false for subclasses whose shaders do more than the blur
+  virtual bool _canUsePrefixSums() const { return true; }
+  bool _usesPrefixSums();
+  // the prefix sums stay ahead of the line pass
+  bool _usesCompute() override;
+
+  std::shared_ptr<const Kernel> _getKernel(int radius, float sigma) override;
   std::string _generateOptimizedVertexShaderString(int radius,
                                                    float sigma) override;
   std::string _generateOptimizedFragmentShaderString(int radius,
                                                      float sigma) override;
+
+ private:
+  bool _proceedPrefixSums(bool bUpdateTargets, int64_t frameTime);
+
+  GLProgram* scanProgram_ = nullptr;
+  GLProgram* boxProgram_ = nullptr;
+  bool prefixSumsFailed_ = false;
 };
 
 NS_GPUPIXEL_END
@@ -6,42 +6,32 @@
  */
 
 #include "brightness_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
 REGISTER_FILTER_CLASS(BrightnessFilter)
 
-#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID) || defined(GPUPIXEL_MAC)
-const std::string kBrightnessFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp float brightness_para;
-    varying highp vec2 textureCoordinate;
+const std::string kBrightnessStageShaderString = R"(
+    uniform float $brightness_para;
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      gl_FragColor = vec4((color.rgb + vec3(brightness_para)), color.a);
+    vec4 $apply(vec4 color) {
+      return vec4((color.rgb + vec3($brightness_para)), color.a);
     })";
-#elif defined(GPUPIXEL_WIN) || defined(GPUPIXEL_MAC) || defined(GPUPIXEL_LINUX)
-const std::string kBrightnessFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform float brightness_para;
-    varying vec2 textureCoordinate;
-
-    void main() {
-      vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      gl_FragColor = vec4((color.rgb + vec3(brightness_para)), color.a);
-    })";
-#endif
 
 std::shared_ptr<BrightnessFilter> BrightnessFilter::create(
     float brightness /* = 0.0*/) {
   auto ret = std::shared_ptr<BrightnessFilter>(new BrightnessFilter());
-  if (ret && !ret->init(brightness)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(brightness)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool BrightnessFilter::init(float brightness) {
-  if (!initWithFragmentShaderString(kBrightnessFragmentShaderString)) {
+  if (!initWithStageShaderString(kBrightnessStageShaderString)) {
     return false;
   }
 
@@ -62,7 +52,7 @@ void BrightnessFilter::setBrightness(float brightness) {
   }
 }
 
-bool BrightnessFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("brightness_para", _brightness);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void BrightnessFilter::setStageUniforms(GLProgram* program,
+                                        const std::string& prefix) {
+  program->setUniformValue(prefix + "brightness_para", _brightness);
 }
@@ -7,16 +7,16 @@
 
 #pragma once
 
-#include "filter.h"
+#include "pointwise_filter.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API BrightnessFilter : public Filter {
+class GPUPIXEL_API BrightnessFilter : public PointwiseFilter {
  public:
   static std::shared_ptr<BrightnessFilter> create(float brightness = 0.0);
   bool init(float brightness);
-  virtual bool proceed(bool bUpdateTargets = true,
-                       int64_t frameTime = 0) override;
+  virtual void setStageUniforms(GLProgram* program,
+                                const std::string& prefix) override;
 
   void setBrightness(float brightness);
 
@@ -6,15 +6,14 @@
  */
 
 #include "canny_edge_detection_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
 REGISTER_FILTER_CLASS(CannyEdgeDetectionFilter)
 
 CannyEdgeDetectionFilter::CannyEdgeDetectionFilter()
-    : _grayscaleFilter(0),
-      _blurFilter(0),
-      _edgeDetectionFilter(0),
+    : _blurFilter(0),
       _nonMaximumSuppressionFilter(0),
       _weakPixelInclusionFilter(0) {}
 
@@ -23,9 +22,11 @@ CannyEdgeDetectionFilter::~CannyEdgeDetectionFilter() {}
 std::shared_ptr<CannyEdgeDetectionFilter> CannyEdgeDetectionFilter::create() {
   auto ret =
       std::shared_ptr<CannyEdgeDetectionFilter>(new CannyEdgeDetectionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -34,27 +35,20 @@ bool CannyEdgeDetectionFilter::init() {
     return false;
   }
 
-  // 1. convert image to luminance
-  _grayscaleFilter = GrayscaleFilter::create();
-
-  // 2. apply a varialbe Gaussian blur
+  // 1. apply a variable Gaussian blur to the luminance of the image
   _blurFilter = SingleComponentGaussianBlurFilter::create();
+  _blurFilter->setLuminanceInput(true);
 
-  // 3. soble edge detection
-  _edgeDetectionFilter = DirectionalSobelEdgeDetectionFilter::create();
-
-  // 4. apply non-maximum suppression
+  // 2. Sobel edge detection and non-maximum suppression
   _nonMaximumSuppressionFilter =
-      DirectionalNonMaximumSuppressionFilter::create();
+      DirectionalSobelNonMaximumSuppressionFilter::create();
 
-  // 5. include weak pixels to complete edges
+  // 3. include weak pixels to complete edges
   _weakPixelInclusionFilter = WeakPixelInclusionFilter::create();
 
-  _grayscaleFilter->addTarget(_blurFilter)
-      ->addTarget(_edgeDetectionFilter)
-      ->addTarget(_nonMaximumSuppressionFilter)
+  _blurFilter->addTarget(_nonMaximumSuppressionFilter)
       ->addTarget(_weakPixelInclusionFilter);
-  addFilter(_grayscaleFilter);
+  addFilter(_blurFilter);
 
   return true;
 }
@@ -7,15 +7,17 @@
 
 #pragma once
 
-#include "directional_non_maximum_suppression_filter.h"
-#include "directional_sobel_edge_detection_filter.h"
+#include "directional_sobel_non_maximum_suppression_filter.h"
 #include "filter_group.h"
 #include "gpupixel_macros.h"
-#include "grayscale_filter.h"
 #include "single_component_gaussian_blur_filter.h"
 #include "weak_pixel_inclusion_filter.h"
 
 NS_GPUPIXEL_BEGIN
+// Grayscale, Gaussian blur, directional Sobel, non-maximum suppression and
+// weak pixel inclusion in four passes over single channel framebuffers: the
+// grayscale is read by the horizontal blur and the suppression computes the
+// gradients itself.
 class GPUPIXEL_API CannyEdgeDetectionFilter : public FilterGroup {
  public:
   static std::shared_ptr<CannyEdgeDetectionFilter> create();
@@ -25,10 +27,8 @@ class GPUPIXEL_API CannyEdgeDetectionFilter : public FilterGroup {
  protected:
   CannyEdgeDetectionFilter();
 
-  std::shared_ptr<GrayscaleFilter> _grayscaleFilter;
   std::shared_ptr<SingleComponentGaussianBlurFilter> _blurFilter;
-  std::shared_ptr<DirectionalSobelEdgeDetectionFilter> _edgeDetectionFilter;
-  std::shared_ptr<DirectionalNonMaximumSuppressionFilter>
+  std::shared_ptr<DirectionalSobelNonMaximumSuppressionFilter>
       _nonMaximumSuppressionFilter;
   std::shared_ptr<WeakPixelInclusionFilter> _weakPixelInclusionFilter;
 };
@@ -7,18 +7,15 @@
 
 #pragma once
 
-#include "filter.h"
+#include "pointwise_filter.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API ColorInvertFilter : public Filter {
+class GPUPIXEL_API ColorInvertFilter : public PointwiseFilter {
  public:
   static std::shared_ptr<ColorInvertFilter> create();
   bool init();
 
-  virtual bool proceed(bool bUpdateTargets = true,
-                       int64_t frameTime = 0) override;
-
  protected:
   ColorInvertFilter(){};
 };
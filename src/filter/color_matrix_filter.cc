@@ -6,52 +6,35 @@
  */
 
 #include "color_matrix_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
-#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
-const std::string kColorMatrixFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp mat4 colorMatrix;
-    uniform lowp float intensity;
+const std::string kColorMatrixStageShaderString = R"(
+    uniform mat4 $colorMatrix;
+    uniform float $intensity;
 
-    varying highp vec2 textureCoordinate;
+    vec4 $apply(vec4 color) {
+      vec4 outputColor = color * $colorMatrix;
 
-    void main() {
-      lowp vec4 textureColor = texture2D(inputImageTexture, textureCoordinate);
-      lowp vec4 outputColor = textureColor * colorMatrix;
-
-      gl_FragColor =
-          (intensity * outputColor) + ((1.0 - intensity) * textureColor);
-    })";
-#elif defined(GPUPIXEL_MAC) || defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
-const std::string kColorMatrixFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform mat4 colorMatrix;
-    uniform float intensity;
-
-    varying vec2 textureCoordinate;
-
-    void main() {
-      vec4 textureColor = texture2D(inputImageTexture, textureCoordinate);
-      vec4 outputColor = textureColor * colorMatrix;
-
-      gl_FragColor =
-          (intensity * outputColor) + ((1.0 - intensity) * textureColor);
+      return ($intensity * outputColor) + ((1.0 - $intensity) * color);
     })";
-#endif
 
 ColorMatrixFilter::ColorMatrixFilter()
     : _intensity(1.0), _colorMatrix(Matrix4::IDENTITY) {}
 
 std::shared_ptr<ColorMatrixFilter> ColorMatrixFilter::create() {
   auto ret = std::shared_ptr<ColorMatrixFilter>(new ColorMatrixFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool ColorMatrixFilter::init() {
-  if (!Filter::initWithFragmentShaderString(kColorMatrixFragmentShaderString)) {
+  if (!initWithStageShaderString(kColorMatrixStageShaderString)) {
     return false;
   }
 
@@ -72,10 +55,10 @@ bool ColorMatrixFilter::init() {
   return true;
 }
 
-bool ColorMatrixFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("intensity", _intensity);
-  _filterProgram->setUniformValue("colorMatrix", _colorMatrix);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void ColorMatrixFilter::setStageUniforms(GLProgram* program,
+                                         const std::string& prefix) {
+  program->setUniformValue(prefix + "intensity", _intensity);
+  program->setUniformValue(prefix + "colorMatrix", _colorMatrix);
 }
 
 NS_GPUPIXEL_END
@@ -6,18 +6,18 @@
  */
 
 #pragma once
-#include "filter.h"
+#include "pointwise_filter.h"
 #include "gpupixel_macros.h"
 #include "math_toolbox.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API ColorMatrixFilter : public Filter {
+class GPUPIXEL_API ColorMatrixFilter : public PointwiseFilter {
  public:
   static std::shared_ptr<ColorMatrixFilter> create();
   bool init();
 
-  virtual bool proceed(bool bUpdateTargets = true,
-                       int64_t frameTime = 0) override;
+  virtual void setStageUniforms(GLProgram* program,
+                                const std::string& prefix) override;
 
   void setIntensity(float intensity) { _intensity = intensity; }
   void setColorMatrix(Matrix4 colorMatrix) { _colorMatrix = colorMatrix; }
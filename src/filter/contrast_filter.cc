@@ -6,31 +6,31 @@
  */
 
 #include "contrast_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
 REGISTER_FILTER_CLASS(ContrastFilter)
 
-const std::string kContrastFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp float contrast;
-    varying highp vec2 textureCoordinate;
+const std::string kContrastStageShaderString = R"(
+    uniform float $contrast;
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      gl_FragColor =
-          vec4(((color.rgb - vec3(0.5)) * contrast + vec3(0.5)), color.a);
+    vec4 $apply(vec4 color) {
+      return vec4(((color.rgb - vec3(0.5)) * $contrast + vec3(0.5)), color.a);
     })";
 
 std::shared_ptr<ContrastFilter> ContrastFilter::create() {
   auto ret = std::shared_ptr<ContrastFilter>(new ContrastFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool ContrastFilter::init() {
-  if (!initWithFragmentShaderString(kContrastFragmentShaderString)) {
+  if (!initWithStageShaderString(kContrastStageShaderString)) {
     return false;
   }
 
@@ -52,7 +52,7 @@ void ContrastFilter::setContrast(float contrast) {
   }
 }
 
-bool ContrastFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("contrast", _contrast);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void ContrastFilter::setStageUniforms(GLProgram* program,
+                                      const std::string& prefix) {
+  program->setUniformValue(prefix + "contrast", _contrast);
 }
@@ -6,6 +6,7 @@
  */
 
 #include "crosshatch_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -97,9 +98,11 @@ const std::string kCrosshatchFragmentShaderString = R"(
 
 std::shared_ptr<CrosshatchFilter> CrosshatchFilter::create() {
   auto ret = std::shared_ptr<CrosshatchFilter>(new CrosshatchFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include "directional_non_maximum_suppression_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -94,9 +95,11 @@ std::shared_ptr<DirectionalNonMaximumSuppressionFilter>
 DirectionalNonMaximumSuppressionFilter::create() {
   auto ret = std::shared_ptr<DirectionalNonMaximumSuppressionFilter>(
       new DirectionalNonMaximumSuppressionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -104,10 +107,12 @@ bool DirectionalNonMaximumSuppressionFilter::init() {
   if (initWithFragmentShaderString(
           kDirectionalNonmaximumSuppressionFragmentShaderString)) {
     _texelWidthUniform = _filterProgram->getUniformLocation("texelWidth");
-    _texelHeightUniform = _filterProgram->getUniformLocation("texelWidth");
+    _texelHeightUniform = _filterProgram->getUniformLocation("texelHeight");
 
     _filterProgram->setUniformValue("upperThreshold", (float)0.5);
     _filterProgram->setUniformValue("lowerThreshold", (float)0.1);
+    // the suppressed edges are luminance only
+    _outputFormat = FramebufferFormatR8;
 
     return true;
   }
@@ -119,8 +124,6 @@ bool DirectionalNonMaximumSuppressionFilter::proceed(bool bUpdateTargets,
   float texelWidth = 1.0 / _framebuffer->getWidth();
   float texelHeight = 1.0 / _framebuffer->getHeight();
 
-  std::shared_ptr<Framebuffer> inputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
   RotationMode inputRotation = _inputFramebuffers.begin()->second.rotationMode;
 
   if (rotationSwapsSize(inputRotation)) {
@@ -6,6 +6,7 @@
  */
 
 #include "directional_sobel_edge_detection_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -121,9 +122,11 @@ std::shared_ptr<DirectionalSobelEdgeDetectionFilter>
 DirectionalSobelEdgeDetectionFilter::create() {
   auto ret = std::shared_ptr<DirectionalSobelEdgeDetectionFilter>(
       new DirectionalSobelEdgeDetectionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -0,0 +1,215 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "directional_sobel_non_maximum_suppression_filter.h"
+#include "gpupixel_context.h"
+
+NS_GPUPIXEL_BEGIN
+
+REGISTER_FILTER_CLASS(DirectionalSobelNonMaximumSuppressionFilter)
+
+// The magnitudes are rounded to 8 bits as the gradient texture of the
+// unfused filters rounded them, so ties between neighbors stay ties.
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
+const std::string kDirectionalSobelNonMaximumSuppressionFragmentShaderString =
+    R"(
+        precision mediump float;
+
+        uniform sampler2D inputImageTexture;
+        uniform highp float texelWidth;
+        uniform highp float texelHeight;
+        uniform mediump float upperThreshold;
+        uniform mediump float lowerThreshold;
+
+        varying highp vec2 textureCoordinate;
+        varying highp vec2 vLeftTexCoord;
+        varying highp vec2 vRightTexCoord;
+
+        varying highp vec2 vTopTexCoord;
+        varying highp vec2 vTopLeftTexCoord;
+        varying highp vec2 vTopRightTexCoord;
+
+        varying highp vec2 vBottomTexCoord;
+        varying highp vec2 vBottomLeftTexCoord;
+        varying highp vec2 vBottomRightTexCoord;
+
+        vec2 sobel(float topLeft, float top, float topRight, float left,
+                   float right, float bottomLeft, float bottom,
+                   float bottomRight) {
+          return vec2(-bottomLeft - 2.0 * left - topLeft + bottomRight +
+                          2.0 * right + topRight,
+                      -topLeft - 2.0 * top - topRight + bottomLeft +
+                          2.0 * bottom + bottomRight);
+        }
+
+        float quantize(float magnitude) {
+          return floor(clamp(magnitude, 0.0, 1.0) * 255.0 + 0.5) / 255.0;
+        }
+
+        float gradientMagnitude(highp vec2 coordinate) {
+          highp vec2 widthStep = vec2(texelWidth, 0.0);
+          highp vec2 heightStep = vec2(0.0, texelHeight);
+          vec2 gradient = sobel(
+              texture2D(inputImageTexture, coordinate - widthStep - heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate - heightStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep - heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate - widthStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep).r,
+              texture2D(inputImageTexture, coordinate - widthStep + heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate + heightStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep + heightStep)
+                  .r);
+          return quantize(length(gradient));
+        }
+
+        void main() {
+          vec2 gradient =
+              sobel(texture2D(inputImageTexture, vTopLeftTexCoord).r,
+                    texture2D(inputImageTexture, vTopTexCoord).r,
+                    texture2D(inputImageTexture, vTopRightTexCoord).r,
+                    texture2D(inputImageTexture, vLeftTexCoord).r,
+                    texture2D(inputImageTexture, vRightTexCoord).r,
+                    texture2D(inputImageTexture, vBottomLeftTexCoord).r,
+                    texture2D(inputImageTexture, vBottomTexCoord).r,
+                    texture2D(inputImageTexture, vBottomRightTexCoord).r);
+          float magnitude = quantize(length(gradient));
+          vec2 direction = normalize(gradient);
+          // offset by 1-sin(pi/8) to set to 0 if near axis, 1 if away
+          direction = sign(direction) * floor(abs(direction) + 0.617316);
+          highp vec2 offset = direction * vec2(texelWidth, texelHeight);
+
+          float multiplier =
+              step(gradientMagnitude(textureCoordinate + offset), magnitude);
+          multiplier = multiplier *
+              step(gradientMagnitude(textureCoordinate - offset), magnitude);
+          multiplier = multiplier *
+              smoothstep(lowerThreshold, upperThreshold, magnitude);
+
+          gl_FragColor = vec4(multiplier, multiplier, multiplier, 1.0);
+        })";
+#elif defined(GPUPIXEL_MAC) || defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+const std::string kDirectionalSobelNonMaximumSuppressionFragmentShaderString =
+    R"(
+        uniform sampler2D inputImageTexture;
+        uniform float texelWidth;
+        uniform float texelHeight;
+        uniform float upperThreshold;
+        uniform float lowerThreshold;
+
+        varying vec2 textureCoordinate;
+        varying vec2 vLeftTexCoord;
+        varying vec2 vRightTexCoord;
+
+        varying vec2 vTopTexCoord;
+        varying vec2 vTopLeftTexCoord;
+        varying vec2 vTopRightTexCoord;
+
+        varying vec2 vBottomTexCoord;
+        varying vec2 vBottomLeftTexCoord;
+        varying vec2 vBottomRightTexCoord;
+
+        vec2 sobel(float topLeft, float top, float topRight, float left,
+                   float right, float bottomLeft, float bottom,
+                   float bottomRight) {
+          return vec2(-bottomLeft - 2.0 * left - topLeft + bottomRight +
+                          2.0 * right + topRight,
+                      -topLeft - 2.0 * top - topRight + bottomLeft +
+                          2.0 * bottom + bottomRight);
+        }
+
+        float quantize(float magnitude) {
+          return floor(clamp(magnitude, 0.0, 1.0) * 255.0 + 0.5) / 255.0;
+        }
+
+        float gradientMagnitude(vec2 coordinate) {
+          vec2 widthStep = vec2(texelWidth, 0.0);
+          vec2 heightStep = vec2(0.0, texelHeight);
+          vec2 gradient = sobel(
+              texture2D(inputImageTexture, coordinate - widthStep - heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate - heightStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep - heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate - widthStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep).r,
+              texture2D(inputImageTexture, coordinate - widthStep + heightStep)
+                  .r,
+              texture2D(inputImageTexture, coordinate + heightStep).r,
+              texture2D(inputImageTexture, coordinate + widthStep + heightStep)
+                  .r);
+          return quantize(length(gradient));
+        }
+
+        void main() {
+          vec2 gradient =
+              sobel(texture2D(inputImageTexture, vTopLeftTexCoord).r,
+                    texture2D(inputImageTexture, vTopTexCoord).r,
+                    texture2D(inputImageTexture, vTopRightTexCoord).r,
+                    texture2D(inputImageTexture, vLeftTexCoord).r,
+                    texture2D(inputImageTexture, vRightTexCoord).r,
+                    texture2D(inputImageTexture, vBottomLeftTexCoord).r,
+                    texture2D(inputImageTexture, vBottomTexCoord).r,
+                    texture2D(inputImageTexture, vBottomRightTexCoord).r);
+          float magnitude = quantize(length(gradient));
+          vec2 direction = normalize(gradient);
+          // offset by 1-sin(pi/8) to set to 0 if near axis, 1 if away
+          direction = sign(direction) * floor(abs(direction) + 0.617316);
+          vec2 offset = direction * vec2(texelWidth, texelHeight);
+
+          float multiplier =
+              step(gradientMagnitude(textureCoordinate + offset), magnitude);
+          multiplier = multiplier *
+              step(gradientMagnitude(textureCoordinate - offset), magnitude);
+          multiplier = multiplier *
+              smoothstep(lowerThreshold, upperThreshold, magnitude);
+
+          gl_FragColor = vec4(multiplier, multiplier, multiplier, 1.0);
+        })";
+#endif
+
+std::shared_ptr<DirectionalSobelNonMaximumSuppressionFilter>
+DirectionalSobelNonMaximumSuppressionFilter::create() {
+  auto ret = std::shared_ptr<DirectionalSobelNonMaximumSuppressionFilter>(
+      new DirectionalSobelNonMaximumSuppressionFilter());
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
+  return ret;
+}
+
+bool DirectionalSobelNonMaximumSuppressionFilter::init() {
+  if (!initWithFragmentShaderString(
+          kDirectionalSobelNonMaximumSuppressionFragmentShaderString)) {
+    return false;
+  }
+  _outputFormat = FramebufferFormatR8;
+  return true;
+}
+
+bool DirectionalSobelNonMaximumSuppressionFilter::proceed(bool bUpdateTargets,
+                                                          int64_t frameTime) {
+  _filterProgram->setUniformValue("upperThreshold", _upperThreshold);
+  _filterProgram->setUniformValue("lowerThreshold", _lowerThreshold);
+  return NearbySampling3x3Filter::proceed(bUpdateTargets, frameTime);
+}
+
+void DirectionalSobelNonMaximumSuppressionFilter::setUpperThreshold(
+    float upperThreshold) {
+  _upperThreshold = upperThreshold;
+}
+
+void DirectionalSobelNonMaximumSuppressionFilter::setLowerThreshold(
+    float lowerThreshold) {
+  _lowerThreshold = lowerThreshold;
+}
+
+NS_GPUPIXEL_END
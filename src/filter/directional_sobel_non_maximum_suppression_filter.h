@@ -0,0 +1,38 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include "gpupixel_macros.h"
+#include "nearby_sampling3x3_filter.h"
+
+NS_GPUPIXEL_BEGIN
+// DirectionalSobelEdgeDetectionFilter followed by
+// DirectionalNonMaximumSuppressionFilter in one pass. The gradients of the
+// two neighbors along the direction are computed again instead of being
+// stored, so no gradient texture is written or read back. The output is
+// luminance only.
+class GPUPIXEL_API DirectionalSobelNonMaximumSuppressionFilter
+    : public NearbySampling3x3Filter {
+ public:
+  static std::shared_ptr<DirectionalSobelNonMaximumSuppressionFilter> create();
+  bool init();
+  virtual bool proceed(bool bUpdateTargets = true,
+                       int64_t frameTime = 0) override;
+
+  void setUpperThreshold(float upperThreshold);
+  void setLowerThreshold(float lowerThreshold);
+
+ protected:
+  DirectionalSobelNonMaximumSuppressionFilter()
+      : _upperThreshold(0.5), _lowerThreshold(0.1){};
+
+  float _upperThreshold;
+  float _lowerThreshold;
+};
+
+NS_GPUPIXEL_END
@@ -6,6 +6,7 @@
  */
 
 #include "emboss_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -13,9 +14,11 @@ USING_NS_GPUPIXEL
 
 std::shared_ptr<EmbossFilter> EmbossFilter::create() {
   auto ret = std::shared_ptr<EmbossFilter>(new EmbossFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
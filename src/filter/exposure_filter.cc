@@ -6,28 +6,29 @@
  */
 
 #include "exposure_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
-const std::string kExposureFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp float exposure;
-    varying highp vec2 textureCoordinate;
+const std::string kExposureStageShaderString = R"(
+    uniform float $exposure;
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      gl_FragColor = vec4(color.rgb * pow(2.0, exposure), color.a);
+    vec4 $apply(vec4 color) {
+      return vec4(color.rgb * pow(2.0, $exposure), color.a);
     })";
 
 std::shared_ptr<ExposureFilter> ExposureFilter::create() {
   auto ret = std::shared_ptr<ExposureFilter>(new ExposureFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool ExposureFilter::init() {
-  if (!initWithFragmentShaderString(kExposureFragmentShaderString)) {
+  if (!initWithStageShaderString(kExposureStageShaderString)) {
     return false;
   }
 
@@ -49,7 +50,7 @@ void ExposureFilter::setExposure(float exposure) {
   }
 }
 
-bool ExposureFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("exposure", _exposure);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void ExposureFilter::setStageUniforms(GLProgram* program,
+                                      const std::string& prefix) {
+  program->setUniformValue(prefix + "exposure", _exposure);
 }
@@ -6,6 +6,7 @@
  */
 
 #include "face_makeup_filter.h"
+#include <typeinfo>
 #include "gpupixel_context.h"
 #include "source_image.h"
 #include "face_detector.h"
@@ -168,9 +169,11 @@ FaceMakeupFilter::~FaceMakeupFilter() {}
 
 std::shared_ptr<FaceMakeupFilter> FaceMakeupFilter::create() {
   auto ret = std::shared_ptr<FaceMakeupFilter>(new FaceMakeupFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -188,6 +191,9 @@ bool FaceMakeupFilter::init() {
   // base render program
   _filterProgram2 = GLProgram::createByShaderString(kDefaultVertexShader,
                                                     kDefaultFragmentShader);
+  if (!_filterProgram2) {
+    return false;
+  }
   _filterPositionAttribute2 = _filterProgram2->getAttribLocation("position");
   _filterTexCoordAttribute2 =
       _filterProgram2->getAttribLocation("inputTextureCoordinate");
@@ -222,40 +228,31 @@ void FaceMakeupFilter::setImageTexture(std::shared_ptr<SourceImage> texture) {
 
 
 bool FaceMakeupFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  static const GLfloat imageVertices[] = {
-    -1.0f, -1.0f,
-    1.0f, -1.0f,
-    -1.0f, 1.0f,
-    1.0f, 1.0f,
-  };
-
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
   _framebuffer->active();
   // render origin frame --- begin -----//
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram2);
-  CHECK_GL(glClearColor(_backgroundColor.r, _backgroundColor.g,
-                        _backgroundColor.b, _backgroundColor.a));
+  _context->setActiveShaderProgram(_filterProgram2);
+  _context->getGLStateCache()->clearColor(
+      _backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+      _backgroundColor.a);
   CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
 
-  CHECK_GL(glActiveTexture(GL_TEXTURE4));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[0].frameBuffer->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      4, _inputFramebuffers[0].frameBuffer->getTexture());
   _filterProgram2->setUniformValue("inputImageTexture", 4);
 
-  // vertex
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute2));
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute2, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-
-  CHECK_GL(glEnableVertexAttribArray(_filterTexCoordAttribute2));
-  CHECK_GL(glVertexAttribPointer(_filterTexCoordAttribute2, 2, GL_FLOAT, 0, 0,
-                                 _getTexureCoordinate(NoRotation)));
-
-  CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute2, _filterTexCoordAttribute2, NoRotation);
+  quad->draw();
 
   // render image --- begin --- //
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  _context->setActiveShaderProgram(_filterProgram);
+  // the face mesh changes every frame and is drawn from client memory
+  quad->unbind();
 
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute));
+  _context->getGLStateCache()->enableVertexAttribArray(
+      _filterPositionAttribute);
   if (face_land_marks_.size() != 0) {
     CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
                                    face_land_marks_.data()));
@@ -271,7 +268,8 @@ bool FaceMakeupFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
         (coord[i * 2 + 1] * 1280 - texture_bounds_.y) / texture_bounds_.height;
   }
   // texcoord attribute
-  CHECK_GL(glEnableVertexAttribArray(_filterTexCoordAttribute));
+  _context->getGLStateCache()->enableVertexAttribArray(
+      _filterTexCoordAttribute);
   CHECK_GL(glVertexAttribPointer(_filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
                                  textureCoordinates.data()));
 
@@ -279,14 +277,13 @@ bool FaceMakeupFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
 
   _filterProgram->setUniformValue("blendMode", 15);
 
-  std::shared_ptr<Framebuffer> fb = _inputFramebuffers[0].frameBuffer;
-  CHECK_GL(glActiveTexture(GL_TEXTURE0));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, fb->getTexture()));
+  Framebuffer* fb = _inputFramebuffers[0].frameBuffer.get();
+  _context->getGLStateCache()->bindTexture(0, fb->getTexture());
   _filterProgram->setUniformValue("inputImageTexture", 0);  // origin image
 
-  glActiveTexture(GL_TEXTURE3);
   // assert(image_texture_);
-  glBindTexture(GL_TEXTURE_2D, image_texture_->getFramebuffer()->getTexture());
+  _context->getGLStateCache()->bindTexture(
+      3, image_texture_->getFramebuffer()->getTexture());
   _filterProgram->setUniformValue("inputImageTexture2", 3);
 
   if (has_face_) {
@@ -295,6 +292,7 @@ bool FaceMakeupFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
                    face_indexs.data());
   }
   _framebuffer->inactive();
+  profiler->endScope(profileScope);
 
   return Source::proceed(bUpdateTargets, frameTime);
 }
@@ -213,9 +213,11 @@ FaceReshapeFilter::~FaceReshapeFilter() {}
 
 std::shared_ptr<FaceReshapeFilter> FaceReshapeFilter::create() {
   auto ret = std::shared_ptr<FaceReshapeFilter>(new FaceReshapeFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
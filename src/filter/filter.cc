@@ -6,6 +6,7 @@
  */
 
 #include "filter.h"
+#include <typeinfo>
 #include "gpupixel.h"
 #include "gpupixel_context.h"
 
@@ -21,7 +22,10 @@ std::map<std::string, std::function<std::shared_ptr<Filter>()>> initFilterFactor
 }
 std::map<std::string, std::function<std::shared_ptr<Filter>()>> Filter::_filterFactories = initFilterFactory();
 
-Filter::Filter() : _filterProgram(0), _filterClassName("") {
+Filter::Filter()
+    : _filterProgram(0),
+      _filterClassName(""),
+      _outputFormat(FramebufferFormatRGBA8) {
   _backgroundColor.r = 0.0;
   _backgroundColor.g = 0.0;
   _backgroundColor.b = 0.0;
@@ -48,18 +52,23 @@ std::shared_ptr<Filter> Filter::createWithShaderString(
     const std::string& vertexShaderSource,
     const std::string& fragmentShaderSource) {
   auto filter = std::shared_ptr<Filter>(new Filter());
-  if (!filter->initWithShaderString(vertexShaderSource, fragmentShaderSource)) {
-    // todo(Jeayo)
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!filter->initWithShaderString(vertexShaderSource,
+                                      fragmentShaderSource)) {
+      filter.reset();
+    }
+  });
   return filter;
 }
 
 std::shared_ptr<Filter> Filter::createWithFragmentShaderString(
     const std::string& fragmentShaderSource) {
   auto filter = std::shared_ptr<Filter>(new Filter());
-  if (!filter->initWithFragmentShaderString(fragmentShaderSource)) {
-    // todo(Jeayo)
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!filter->initWithFragmentShaderString(fragmentShaderSource)) {
+      filter.reset();
+    }
+  });
   return filter;
 }
 
@@ -67,12 +76,32 @@ bool Filter::initWithShaderString(const std::string& vertexShaderSource,
                                   const std::string& fragmentShaderSource,
                                   int inputNumber /* = 1*/) {
   _inputNum = inputNumber;
-  _filterProgram =
-      GLProgram::createByShaderString(vertexShaderSource, fragmentShaderSource);
-  _filterPositionAttribute = _filterProgram->getAttribLocation("position");
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute));
-  return true;
+  bool ret = true;
+  // setters like setRadius() rebuild the program from the caller's thread
+  _context->runSync([&] {
+    GLProgram* program = GLProgram::createByShaderString(vertexShaderSource,
+                                                         fragmentShaderSource);
+    // a rebuild that fails keeps drawing with the program it replaces
+    if (!program) {
+      ret = false;
+      return;
+    }
+    if (_filterProgram) {
+      delete _filterProgram;
+    }
+    _filterProgram = program;
+    _filterPositionAttribute = _filterProgram->getAttribLocation("position");
+    _filterInputTextureUniforms.clear();
+    _filterTexCoordAttributes.clear();
+    for (int i = 0; i < inputNumber; ++i) {
+      _filterInputTextureUniforms.push_back(
+          _filterProgram->getUniformLocation(_getInputTextureUniformName(i)));
+      _filterTexCoordAttributes.push_back(_filterProgram->getAttribLocation(
+          _getInputTexCoordAttributeName(i)));
+    }
+    _context->setActiveShaderProgram(_filterProgram);
+  });
+  return ret;
 }
 
 bool Filter::initWithFragmentShaderString(
@@ -119,130 +148,85 @@ std::string Filter::_getVertexShaderString(int inputNumber) const {
 
 bool Filter::proceed(bool bUpdateTargets /* = true*/,
                      int64_t frametime /* = 0*/) {
-  static const GLfloat imageVertices[] = {
-      -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f,
-  };
-
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  _context->setActiveShaderProgram(_filterProgram);
   _framebuffer->active();
-  CHECK_GL(glClearColor(_backgroundColor.r, _backgroundColor.g,
-                        _backgroundColor.b, _backgroundColor.a));
+  _context->getGLStateCache()->clearColor(
+      _backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+      _backgroundColor.a);
   CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+  std::vector<FullscreenQuad::TexCoordAttribute> texCoordAttributes;
   for (std::map<int, InputFrameBufferInfo>::const_iterator it =
            _inputFramebuffers.begin();
        it != _inputFramebuffers.end(); ++it) {
     int texIdx = it->first;
     std::shared_ptr<Framebuffer> fb = it->second.frameBuffer;
-    CHECK_GL(glActiveTexture(GL_TEXTURE0 + texIdx));
-    CHECK_GL(glBindTexture(GL_TEXTURE_2D, fb->getTexture()));
+    _context->getGLStateCache()->bindTexture(texIdx, fb->getTexture());
+    bool resolved = texIdx < (int)_filterInputTextureUniforms.size();
     _filterProgram->setUniformValue(
-        texIdx == 0 ? "inputImageTexture"
-                    : Util::str_format("inputImageTexture%d", texIdx),
+        resolved ? _filterInputTextureUniforms[texIdx]
+                 : (GLint)_filterProgram->getUniformLocation(
+                       _getInputTextureUniformName(texIdx)),
         texIdx);
     // texcoord attribute
-    GLuint filterTexCoordAttribute = _filterProgram->getAttribLocation(
-        texIdx == 0 ? "inputTextureCoordinate"
-                    : Util::str_format("inputTextureCoordinate%d", texIdx));
-    CHECK_GL(glEnableVertexAttribArray(filterTexCoordAttribute));
-    CHECK_GL(
-        glVertexAttribPointer(filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
-                              _getTexureCoordinate(it->second.rotationMode)));
+    GLint filterTexCoordAttribute =
+        resolved ? _filterTexCoordAttributes[texIdx]
+                 : _filterProgram->getAttribLocation(
+                       _getInputTexCoordAttributeName(texIdx));
+    texCoordAttributes.push_back(
+        {filterTexCoordAttribute, it->second.rotationMode});
   }
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-  CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute, texCoordAttributes);
+  quad->draw();
 
   _framebuffer->inactive();
+  profiler->endScope(profileScope);
 
   return Source::proceed(bUpdateTargets, frametime);
 }
 
+void Filter::updateTargets(int64_t frameTime) {
+  // drawing is done, let the inputs go back to the cache before the targets
+  // fetch their outputs
+  unPrepear();
+  Source::updateTargets(frameTime);
+}
+
+std::string Filter::_getInputTextureUniformName(int texIdx) const {
+  return texIdx == 0 ? "inputImageTexture"
+                     : Util::str_format("inputImageTexture%d", texIdx);
+}
+
+std::string Filter::_getInputTexCoordAttributeName(int texIdx) const {
+  return texIdx == 0 ? "inputTextureCoordinate"
+                     : Util::str_format("inputTextureCoordinate%d", texIdx);
+}
+
+TextureAttributes Filter::_getOutputTextureAttributes() {
+  TextureAttributes attributes = Framebuffer::defaultTextureAttribures;
+  if (_outputFormat != FramebufferFormatRGBA8 &&
+      _context->isFramebufferFormatSupported(_outputFormat)) {
+    attributes = Framebuffer::getFormatTextureAttributes(_outputFormat);
+  }
+  if (_usesCompute()) {
+    attributes = GLCompute::getImageTextureAttributes(attributes);
+  }
+  return attributes;
+}
+
+bool Filter::_canComputeLines() const {
+  if (_inputFramebuffers.size() != 1 || _framebufferScale != 1.0 ||
+      !_context->getGLCompute()->isAvailable()) {
+    return false;
+  }
+  return _inputFramebuffers.begin()->second.rotationMode == NoRotation;
+}
+
 const GLfloat* Filter::_getTexureCoordinate(
     const RotationMode& rotationMode) const {
-  static const GLfloat noRotationTextureCoordinates[] = {
-    0.0f, 0.0f,
-    1.0f, 0.0f,
-    0.0f, 1.0f,
-    1.0f, 1.0f,
-  };
-
-  static const GLfloat rotateLeftTextureCoordinates[] = {
-    1.0f, 0.0f,
-    1.0f, 1.0f,
-    0.0f, 0.0f,
-    0.0f, 1.0f,
-  };
-
-  static const GLfloat rotateRightTextureCoordinates[] = {
-    0.0f, 1.0f,
-    0.0f, 0.0f,
-    1.0f, 1.0f,
-    1.0f, 0.0f,
-  };
-
-  static const GLfloat verticalFlipTextureCoordinates[] = {
-    0.0f, 1.0f,
-    1.0f, 1.0f,
-    0.0f, 0.0f,
-    1.0f, 0.0f,
-  };
-
-  static const GLfloat horizontalFlipTextureCoordinates[] = {
-    1.0f, 0.0f,
-    0.0f, 0.0f,
-    1.0f, 1.0f,
-    0.0f, 1.0f,
-  };
-
-  static const GLfloat rotateRightVerticalFlipTextureCoordinates[] = {
-    0.0f, 0.0f,
-    0.0f, 1.0f,
-    1.0f, 0.0f,
-    1.0f, 1.0f,
-  };
-
-  static const GLfloat rotateRightHorizontalFlipTextureCoordinates[] = {
-    1.0f, 1.0f,
-    1.0f, 0.0f,
-    0.0f, 1.0f,
-    0.0f, 0.0f,
-  };
-
-  static const GLfloat rotate180TextureCoordinates[] = {
-    1.0f, 1.0f,
-    0.0f, 1.0f,
-    1.0f, 0.0f,
-    0.0f, 0.0f,
-  };
-
-  switch (rotationMode) {
-    case NoRotation:
-      return noRotationTextureCoordinates;
-      break;
-    case RotateLeft:
-      return rotateLeftTextureCoordinates;
-      break;
-    case RotateRight:
-      return rotateRightTextureCoordinates;
-      break;
-    case FlipVertical:
-      return verticalFlipTextureCoordinates;
-      break;
-    case FlipHorizontal:
-      return horizontalFlipTextureCoordinates;
-      break;
-    case RotateRightFlipVertical:
-      return rotateRightVerticalFlipTextureCoordinates;
-      break;
-    case RotateRightFlipHorizontal:
-      return rotateRightHorizontalFlipTextureCoordinates;
-      break;
-    case Rotate180:
-      return rotate180TextureCoordinates;
-      break;
-    default:
-      break;
-  }
+  return FullscreenQuad::getTextureCoordinates(rotationMode);
 }
 
 void Filter::update(int64_t frameTime) {
@@ -250,31 +234,33 @@ void Filter::update(int64_t frameTime) {
     return;
   }
 
-  if (GPUPixelContext::getInstance()->isCapturingFrame &&
-      this == GPUPixelContext::getInstance()->captureUpToFilter.get()) {
-    int captureWidth = GPUPixelContext::getInstance()->captureWidth;
-    int captureHeight = GPUPixelContext::getInstance()->captureHeight;
+  if (_context->isCapturingFrame && this == _context->captureUpToFilter.get()) {
+    int captureWidth = _context->captureWidth;
+    int captureHeight = _context->captureHeight;
 
+    // read back as RGBA8 whatever the output format
     if (!_framebuffer || (_framebuffer->getWidth() != captureWidth ||
-                          _framebuffer->getHeight() != captureHeight)) {
-      _framebuffer = GPUPixelContext::getInstance()
-                         ->getFramebufferCache()
-                         ->fetchFramebuffer(captureWidth, captureHeight);
+                          _framebuffer->getHeight() != captureHeight) ||
+        _framebuffer->getTextureAttributes().internalFormat !=
+            Framebuffer::defaultTextureAttribures.internalFormat) {
+      _framebuffer = _context->getFramebufferCache()->fetchFramebuffer(
+          captureWidth, captureHeight);
     }
 
     proceed(false);
 
     _framebuffer->active();
-    GPUPixelContext::getInstance()->capturedFrameData =
+    _context->capturedFrameData =
         new unsigned char[captureWidth * captureHeight * 4];
     CHECK_GL(glReadPixels(0, 0, captureWidth, captureHeight, GL_RGBA,
-                          GL_UNSIGNED_BYTE,
-                          GPUPixelContext::getInstance()->capturedFrameData));
+                          GL_UNSIGNED_BYTE, _context->capturedFrameData));
     _framebuffer->inactive();
   } else {
     // todo(Jeayo)
-    std::shared_ptr<Framebuffer> firstInputFramebuffer =
-        _inputFramebuffers.begin()->second.frameBuffer;
+    // not a shared_ptr, the input must not outlive the draw while
+    // proceed() runs the rest of the chain
+    Framebuffer* firstInputFramebuffer =
+        _inputFramebuffers.begin()->second.frameBuffer.get();
     RotationMode firstInputRotation =
         _inputFramebuffers.begin()->second.rotationMode;
     if (!firstInputFramebuffer) {
@@ -294,13 +280,17 @@ void Filter::update(int64_t frameTime) {
       rotatedFramebufferHeight =
           int(rotatedFramebufferHeight * _framebufferScale);
     }
+    TextureAttributes attributes = _getOutputTextureAttributes();
     if (!_framebuffer ||
         (_framebuffer->getWidth() != rotatedFramebufferWidth ||
-         _framebuffer->getHeight() != rotatedFramebufferHeight)) {
-      _framebuffer = GPUPixelContext::getInstance()
-                         ->getFramebufferCache()
-                         ->fetchFramebuffer(rotatedFramebufferWidth,
-                                            rotatedFramebufferHeight);
+         _framebuffer->getHeight() != rotatedFramebufferHeight) ||
+        _framebuffer->getTextureAttributes().internalFormat !=
+            attributes.internalFormat ||
+        _framebuffer->getTextureAttributes().immutable !=
+            attributes.immutable) {
+      _framebuffer = _context->getFramebufferCache()->fetchFramebuffer(
+          rotatedFramebufferWidth, rotatedFramebufferHeight, false,
+          attributes);
     }
     proceed(true, frameTime);
   }
@@ -386,10 +376,12 @@ bool Filter::setProperty(const std::string& name, int value) {
     return false;
   }
   IntProperty* property = ((IntProperty*)rawProperty);
-  property->value = value;
-  if (property->setCallback) {
-    property->setCallback(value);
-  }
+  _context->runSync([&] {
+    property->value = value;
+    if (property->setCallback) {
+      property->setCallback(value);
+    }
+  });
   return true;
 }
 
@@ -406,10 +398,12 @@ bool Filter::setProperty(const std::string& name, float value) {
     return false;
   }
   FloatProperty* property = ((FloatProperty*)rawProperty);
-  if (property->setCallback) {
-    property->setCallback(value);
-  }
-  property->value = value;
+  _context->runSync([&] {
+    if (property->setCallback) {
+      property->setCallback(value);
+    }
+    property->value = value;
+  });
 
   return true;
 }
@@ -427,10 +421,12 @@ bool Filter::setProperty(const std::string& name, std::vector<float> value) {
     return false;
   }
   VectorProperty* property = ((VectorProperty*)rawProperty);
-  if (property->setCallback) {
-    property->setCallback(value);
-  }
-  property->value = value;
+  _context->runSync([&] {
+    if (property->setCallback) {
+      property->setCallback(value);
+    }
+    property->value = value;
+  });
 
   return true;
 }
@@ -448,10 +444,12 @@ bool Filter::setProperty(const std::string& name, std::string value) {
     return false;
   }
   StringProperty* property = ((StringProperty*)rawProperty);
-  property->value = value;
-  if (property->setCallback) {
-    property->setCallback(value);
-  }
+  _context->runSync([&] {
+    property->value = value;
+    if (property->setCallback) {
+      property->setCallback(value);
+    }
+  });
   return true;
 }
 
@@ -72,10 +72,18 @@ class GPUPIXEL_API Filter : public Source, public Target {
 
   virtual bool proceed(bool bUpdateTargets = true,
                        int64_t frametime = 0) override;
+  virtual void updateTargets(int64_t frameTime) override;
 
   GLProgram* getProgram() const { return _filterProgram; };
 
-  // property setters & getters
+  // The format of the output framebuffer, RGBA8 by default. Filters whose
+  // output is luminance only render to R8 to save bandwidth. Formats the
+  // context cannot render to fall back to RGBA8.
+  void setOutputFormat(FramebufferFormat format) { _outputFormat = format; }
+  FramebufferFormat getOutputFormat() const { return _outputFormat; }
+
+  // property setters & getters. setProperty() runs the setter on the render
+  // thread, between frames, see Source.
   bool registerProperty(const std::string& name,
                         int defaultValue,
                         const std::string& comment = "",
@@ -122,6 +130,9 @@ bool registerProperty(
  protected:
   GLProgram* _filterProgram;
   GLuint _filterPositionAttribute;
+  // per input index, resolved when the program is built
+  std::vector<GLint> _filterInputTextureUniforms;
+  std::vector<GLuint> _filterTexCoordAttributes;
   std::string _filterClassName;
   struct {
     float r;
@@ -129,10 +140,21 @@ bool registerProperty(
     float b;
     float a;
   } _backgroundColor;
+  FramebufferFormat _outputFormat;
 
   Filter();
 
   std::string _getVertexShaderString(int inputNumber) const;
+  std::string _getInputTextureUniformName(int texIdx) const;
+  std::string _getInputTexCoordAttributeName(int texIdx) const;
+  // the attributes of _outputFormat, or the default ones if unsupported,
+  // made writable as image when the next pass runs a compute shader
+  TextureAttributes _getOutputTextureAttributes();
+  // whether the next pass runs a compute shader, see GLCompute
+  virtual bool _usesCompute() { return false; }
+  // one input of the size of the output read unrotated, as line passes of
+  // GLCompute need it
+  bool _canComputeLines() const;
 
   const GLfloat* _getTexureCoordinate(const RotationMode& rotationMode) const;
 
@@ -15,24 +15,29 @@ NS_GPUPIXEL_BEGIN
 FilterGroup::FilterGroup() : _terminalFilter(0) {}
 
 FilterGroup::~FilterGroup() {
-  removeAllFilters();
+  // see Source::~Source()
+  _filters.clear();
   _terminalFilter = 0;
 }
 
 std::shared_ptr<FilterGroup> FilterGroup::create() {
   auto ret = std::shared_ptr<FilterGroup>(new FilterGroup());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 std::shared_ptr<FilterGroup> FilterGroup::create(
     std::vector<std::shared_ptr<Filter>> filters) {
   auto ret = std::shared_ptr<FilterGroup>(new FilterGroup());
-  if (ret && !ret->init(filters)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(filters)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -45,6 +50,7 @@ bool FilterGroup::init(std::vector<std::shared_ptr<Filter>> filters) {
     return true;
   }
   _filters = filters;
+  _context->invalidateFrameGraphs();
   setTerminalFilter(_predictTerminalFilter(filters[filters.size() - 1]));
   return true;
 }
@@ -59,23 +65,38 @@ bool FilterGroup::hasFilter(const std::shared_ptr<Filter> filter) const {
 }
 
 void FilterGroup::addFilter(std::shared_ptr<Filter> filter) {
-  if (hasFilter(filter)) {
-    return;
-  }
+  _context->runSync([&] {
+    if (hasFilter(filter)) {
+      return;
+    }
 
-  _filters.push_back(filter);
-  setTerminalFilter(_predictTerminalFilter(filter));
+    _filters.push_back(filter);
+    setTerminalFilter(_predictTerminalFilter(filter));
+  });
 }
 
 void FilterGroup::removeFilter(std::shared_ptr<Filter> filter) {
-  auto itr = std::find(_filters.begin(), _filters.end(), filter);
-  if (itr != _filters.end()) {
-    _filters.erase(itr);
-  }
+  _context->runSync([&] {
+    auto itr = std::find(_filters.begin(), _filters.end(), filter);
+    if (itr != _filters.end()) {
+      _filters.erase(itr);
+      _context->invalidateFrameGraphs();
+    }
+  });
 }
 
 void FilterGroup::removeAllFilters() {
-  _filters.clear();
+  _context->runSync([&] {
+    _filters.clear();
+    _context->invalidateFrameGraphs();
+  });
+}
+
+void FilterGroup::setTerminalFilter(std::shared_ptr<Filter> filter) {
+  _context->runSync([&] {
+    _terminalFilter = filter;
+    _context->invalidateFrameGraphs();
+  });
 }
 
 std::shared_ptr<Filter> FilterGroup::_predictTerminalFilter(
@@ -146,9 +167,8 @@ bool FilterGroup::proceed(bool bUpdateTargets, int64_t frameTime) {
 
 void FilterGroup::update(int64_t frameTime) {
   proceed();
-  if (GPUPixelContext::getInstance()->isCapturingFrame &&
-      this == GPUPixelContext::getInstance()->captureUpToFilter.get()) {
-    GPUPixelContext::getInstance()->captureUpToFilter = _terminalFilter;
+  if (_context->isCapturingFrame && this == _context->captureUpToFilter.get()) {
+    _context->captureUpToFilter = _terminalFilter;
   }
 
   for (auto& filter : _filters) {
@@ -9,6 +9,7 @@
 
 #include <vector>
 #include "filter.h"
+#include "frame_graph.h"
 #include "gpupixel_macros.h"
 #include "source.h"
 #include "target.h"
@@ -32,8 +33,9 @@ class GPUPIXEL_API FilterGroup : public Filter {
   // Manually specify the terminal filter, which is the final output filter of
   // sequence Most often, it's not necessary to specify the terminal filter
   // manually, as the terminal filter will be specified automatically.
-  void setTerminalFilter(std::shared_ptr<Filter> filter) {
-    _terminalFilter = filter;
+  void setTerminalFilter(std::shared_ptr<Filter> filter);
+  const std::vector<std::shared_ptr<Filter>>& getFilters() const {
+    return _filters;
   }
 
   virtual std::shared_ptr<Source> addTarget(
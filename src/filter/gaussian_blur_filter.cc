@@ -6,6 +6,7 @@
  */
 
 #include "gaussian_blur_filter.h"
+#include "gpupixel_context.h"
 #include <cmath>
 #include "util.h"
 
@@ -19,9 +20,11 @@ std::shared_ptr<GaussianBlurFilter> GaussianBlurFilter::create(
     int radius /* = 4*/,
     float sigma /* = 2.0*/) {
   auto ret = std::shared_ptr<GaussianBlurFilter>(new GaussianBlurFilter());
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -6,11 +6,19 @@
  */
 
 #include "gaussian_blur_mono_filter.h"
+#include "gpupixel_context.h"
+#include <algorithm>
 #include <cmath>
+#include <map>
+#include <mutex>
+#include <typeinfo>
 #include "util.h"
 
 NS_GPUPIXEL_BEGIN
 
+// pairs of taps whose coordinates the vertex shader passes as varyings
+static const int kMaxVaryingOffsets = 7;
+
 REGISTER_FILTER_CLASS(GaussianBlurMonoFilter)
 
 GaussianBlurMonoFilter::GaussianBlurMonoFilter(Type type /* = HORIZONTAL*/)
@@ -22,19 +30,25 @@ std::shared_ptr<GaussianBlurMonoFilter> GaussianBlurMonoFilter::create(
     float sigma /* = 2.0*/) {
   auto ret =
       std::shared_ptr<GaussianBlurMonoFilter>(new GaussianBlurMonoFilter(type));
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
-bool GaussianBlurMonoFilter::init(int radius, float sigma) {
-  if (Filter::initWithShaderString(
-          _generateOptimizedVertexShaderString(radius, sigma),
-          _generateOptimizedFragmentShaderString(radius, sigma))) {
-    return true;
+GaussianBlurMonoFilter::~GaussianBlurMonoFilter() {
+  if (computeProgram_) {
+    delete computeProgram_;
+    computeProgram_ = nullptr;
   }
-  return false;
+}
+
+bool GaussianBlurMonoFilter::init(int radius, float sigma) {
+  _radius = radius;
+  _sigma = sigma;
+  return _updateProgram();
 }
 
 void GaussianBlurMonoFilter::setRadius(int radius) {
@@ -43,13 +57,7 @@ void GaussianBlurMonoFilter::setRadius(int radius) {
   }
 
   _radius = radius;
-
-  if (_filterProgram) {
-    delete _filterProgram;
-    _filterProgram = 0;
-  }
-  initWithShaderString(_generateOptimizedVertexShaderString(_radius, _sigma),
-                       _generateOptimizedFragmentShaderString(_radius, _sigma));
+  _updateProgram();
 }
 
 void GaussianBlurMonoFilter::setSigma(float sigma) {
@@ -75,16 +83,174 @@ void GaussianBlurMonoFilter::setSigma(float sigma) {
             // radius sizes, due to the optimizations I use
   }
   _radius = calculatedSampleRadius;
+  _updateProgram();
+}
 
-  if (_filterProgram) {
-    delete _filterProgram;
-    _filterProgram = 0;
+bool GaussianBlurMonoFilter::_updateProgram() {
+  if (_filterProgram && programRadius_ == _radius && programSigma_ == _sigma) {
+    return true;
   }
-  initWithShaderString(_generateOptimizedVertexShaderString(_radius, _sigma),
-                       _generateOptimizedFragmentShaderString(_radius, _sigma));
+  programRadius_ = _radius;
+  programSigma_ = _sigma;
+
+  std::string vertexShaderSource;
+  std::string fragmentShaderSource;
+  if (_radius <= kMaxKernelRadius) {
+    bool built = _filterProgram && kernel_;
+    kernel_ = _getKernel(_radius, _sigma);
+    if (built) {
+      return true;
+    }
+    vertexShaderSource = generateKernelVertexShaderString();
+    fragmentShaderSource = _generateKernelFragmentShaderString();
+  } else {
+    kernel_.reset();
+    vertexShaderSource = _generateOptimizedVertexShaderString(_radius, _sigma);
+    fragmentShaderSource =
+        _generateOptimizedFragmentShaderString(_radius, _sigma);
+  }
+
+  return initWithShaderString(vertexShaderSource, fragmentShaderSource,
+                              _inputNum);
+}
+
+std::shared_ptr<const GaussianBlurMonoFilter::Kernel>
+GaussianBlurMonoFilter::_getKernel(int radius, float sigma) {
+  // shared by the blurs of every context
+  static std::mutex mutex;
+  static std::map<std::pair<int, float>, std::shared_ptr<const Kernel>>
+      kernels;
+  std::unique_lock<std::mutex> lock(mutex);
+  std::shared_ptr<const Kernel>& cached = kernels[{radius, sigma}];
+  if (cached) {
+    return cached;
+  }
+
+  auto kernel = std::make_shared<Kernel>();
+  kernel->centerWeight = 1.0;
+  if (radius >= 1 && sigma > 0.0) {
+    std::vector<float> standardGaussianWeights(radius + 1);
+    float sumOfWeights = 0.0;
+    for (int i = 0; i < radius + 1; ++i) {
+      standardGaussianWeights[i] =
+          (1.0 / sqrt(2.0 * M_PI * pow(sigma, 2.0))) *
+          exp(-pow(i, 2.0) / (2.0 * pow(sigma, 2.0)));
+      sumOfWeights += i == 0 ? standardGaussianWeights[i]
+                             : 2.0 * standardGaussianWeights[i];
+    }
+    for (int i = 0; i < radius + 1; ++i) {
+      standardGaussianWeights[i] /= sumOfWeights;
+    }
+
+    kernel->centerWeight = standardGaussianWeights[0];
+    for (int i = 0; i < radius / 2 + (radius % 2); ++i) {
+      // an odd radius leaves the last pair with one texel
+      float firstWeight = standardGaussianWeights[i * 2 + 1];
+      float secondWeight =
+          i * 2 + 2 <= radius ? standardGaussianWeights[i * 2 + 2] : 0.0;
+      float optimizedWeight = firstWeight + secondWeight;
+      kernel->weights.push_back(optimizedWeight);
+      kernel->offsets.push_back(
+          (firstWeight * (i * 2 + 1) + secondWeight * (i * 2 + 2)) /
+          optimizedWeight);
+    }
+  }
+  cached = kernel;
+  return cached;
+}
+
+std::string GaussianBlurMonoFilter::generateKernelVertexShaderString() {
+  std::string shaderStr = Util::str_format(
+      "attribute vec4 position;\n"
+      "attribute vec4 inputTextureCoordinate;\n"
+      "uniform float texelWidthOffset;\n"
+      "uniform float texelHeightOffset;\n"
+      "uniform float blurOffsets[%d];\n"
+      "varying vec2 blurCoordinates[%d];\n"
+      "void main() {\n"
+      "  gl_Position = position;\n"
+      "  vec2 texelSpacing = vec2(texelWidthOffset, texelHeightOffset);\n"
+      "  blurCoordinates[0] = inputTextureCoordinate.xy;\n",
+      kMaxKernelOffsets, kMaxVaryingOffsets * 2 + 1);
+  for (int i = 0; i < kMaxVaryingOffsets; ++i) {
+    shaderStr += Util::str_format(
+        "  blurCoordinates[%d] =\n"
+        "      inputTextureCoordinate.xy + texelSpacing * blurOffsets[%d];\n"
+        "  blurCoordinates[%d] =\n"
+        "      inputTextureCoordinate.xy - texelSpacing * blurOffsets[%d];\n",
+        i * 2 + 1, i, i * 2 + 2, i);
+  }
+  shaderStr += "}\n";
+  return shaderStr;
+}
+
+std::string GaussianBlurMonoFilter::generateKernelFragmentShaderString(
+    const std::string& sumType,
+    const std::string& swizzle,
+    const std::string& output) {
+  std::string shaderStr = Util::str_format(
+      "#ifdef GL_ES\n"
+      "#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+      "precision highp float;\n"
+      "#else\n"
+      "precision mediump float;\n"
+      "#endif\n"
+      "#endif\n"
+      "uniform sampler2D inputImageTexture;\n"
+      "uniform float texelWidthOffset;\n"
+      "uniform float texelHeightOffset;\n"
+      "uniform float blurCenterWeight;\n"
+      "uniform float blurWeights[%d];\n"
+      "uniform float blurOffsets[%d];\n"
+      "uniform int blurOffsetCount;\n"
+      "varying vec2 blurCoordinates[%d];\n"
+      "void main() {\n"
+      "  %s sum =\n"
+      "      texture2D(inputImageTexture, blurCoordinates[0])%s *\n"
+      "      blurCenterWeight;\n",
+      kMaxKernelOffsets, kMaxKernelOffsets, kMaxVaryingOffsets * 2 + 1,
+      sumType.c_str(), swizzle.c_str());
+  // the branches skip the reads of the pairs a smaller kernel does not have
+  for (int i = 0; i < kMaxVaryingOffsets; ++i) {
+    shaderStr += Util::str_format(
+        "  if (blurOffsetCount > %d) {\n"
+        "    sum += texture2D(inputImageTexture, blurCoordinates[%d])%s *\n"
+        "           blurWeights[%d];\n"
+        "    sum += texture2D(inputImageTexture, blurCoordinates[%d])%s *\n"
+        "           blurWeights[%d];\n"
+        "  }\n",
+        i, i * 2 + 1, swizzle.c_str(), i, i * 2 + 2, swizzle.c_str(), i);
+  }
+  // past the varyings the coordinates depend on the fragment
+  shaderStr += Util::str_format(
+      "  vec2 texelSpacing = vec2(texelWidthOffset, texelHeightOffset);\n"
+      "  for (int i = %d; i < %d; ++i) {\n"
+      "    if (i >= blurOffsetCount) {\n"
+      "      break;\n"
+      "    }\n"
+      "    vec2 offset = texelSpacing * blurOffsets[i];\n"
+      "    vec2 coordinate = blurCoordinates[0];\n"
+      "    sum += texture2D(inputImageTexture, coordinate + offset)%s *\n"
+      "           blurWeights[i];\n"
+      "    sum += texture2D(inputImageTexture, coordinate - offset)%s *\n"
+      "           blurWeights[i];\n"
+      "  }\n"
+      "  gl_FragColor = %s;\n"
+      "}\n",
+      kMaxVaryingOffsets, kMaxKernelOffsets, swizzle.c_str(), swizzle.c_str(),
+      output.c_str());
+  return shaderStr;
+}
+
+std::string GaussianBlurMonoFilter::_generateKernelFragmentShaderString() {
+  return generateKernelFragmentShaderString("vec4", "", "sum");
 }
 
 bool GaussianBlurMonoFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
+  if (_usesCompute() && _updateComputeProgram()) {
+    return _proceedCompute(bUpdateTargets, frameTime);
+  }
+
   RotationMode inputRotation = _inputFramebuffers.begin()->second.rotationMode;
 
   if (rotationSwapsSize(inputRotation)) {
@@ -112,9 +278,132 @@ bool GaussianBlurMonoFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
           (float)(horizontalTexelSpacing_ / _framebuffer->getHeight()));
     }
   }
+  if (kernel_) {
+    // the unused pairs stay 0, a constant upload once the kernel is set
+    GLfloat weights[kMaxKernelOffsets] = {0};
+    GLfloat offsets[kMaxKernelOffsets] = {0};
+    std::copy(kernel_->weights.begin(), kernel_->weights.end(), weights);
+    std::copy(kernel_->offsets.begin(), kernel_->offsets.end(), offsets);
+    _filterProgram->setUniformValue("blurCenterWeight", kernel_->centerWeight);
+    _filterProgram->setUniformValue("blurWeights", weights, kMaxKernelOffsets);
+    _filterProgram->setUniformValue("blurOffsets", offsets, kMaxKernelOffsets);
+    _filterProgram->setUniformValue("blurOffsetCount",
+                                    (int)kernel_->offsets.size());
+  }
   return Filter::proceed(bUpdateTargets, frameTime);
 }
 
+bool GaussianBlurMonoFilter::_usesCompute() {
+  float spacing =
+      _type == HORIZONTAL ? verticalTexelSpacing_ : horizontalTexelSpacing_;
+  return _canUseCompute() && spacing == 1.0 && _canComputeLines() &&
+         !_getComputeWeights().empty();
+}
+
+const std::vector<float>& GaussianBlurMonoFilter::_getComputeWeights() {
+  if (computeRadius_ == _radius && computeSigma_ == _sigma) {
+    return computeWeights_;
+  }
+  computeRadius_ = _radius;
+  computeSigma_ = _sigma;
+
+  // a pair read at offset o interpolates the texel at floor(o) and the one
+  // after it, the kernel reads each with its share of the pair weight
+  std::shared_ptr<const Kernel> kernel = _getKernel(_radius, _sigma);
+  computeWeights_.assign(1, kernel->centerWeight);
+  for (size_t i = 0; i < kernel->offsets.size(); ++i) {
+    int texel = (int)kernel->offsets[i];
+    float fraction = kernel->offsets[i] - texel;
+    if (texel + 1 > (int)computeWeights_.size() - 1) {
+      computeWeights_.resize(texel + 2, 0.0);
+    }
+    computeWeights_[texel] += kernel->weights[i] * (1.0 - fraction);
+    computeWeights_[texel + 1] += kernel->weights[i] * fraction;
+  }
+  while (computeWeights_.size() > 1 && computeWeights_.back() == 0.0) {
+    computeWeights_.pop_back();
+  }
+  if ((int)computeWeights_.size() - 1 > GLCompute::kMaxLineApron) {
+    computeWeights_.clear();
+  }
+  return computeWeights_;
+}
+
+void GaussianBlurMonoFilter::_resetCompute() {
+  if (computeProgram_) {
+    delete computeProgram_;
+    computeProgram_ = nullptr;
+  }
+  computeImageFormat_.clear();
+  computeRadius_ = -1;
+  computeSigma_ = -1.0;
+}
+
+std::string GaussianBlurMonoFilter::generateComputeShaderString(
+    const std::string& imageFormat,
+    const std::string& tileType,
+    const std::string& read,
+    const std::string& output) {
+  std::string declarations = Util::str_format(
+      "uniform float blurWeights[%d];\n"
+      "uniform int blurRadius;\n",
+      GLCompute::kMaxLineApron + 1);
+  std::string body = Util::str_format(
+      "  %s result = tile[center] * blurWeights[0];\n"
+      "  for (int i = 1; i <= blurRadius; ++i) {\n"
+      "    result += (tile[center - i] + tile[center + i]) * blurWeights[i];\n"
+      "  }\n",
+      tileType.c_str());
+  return GLCompute::generateLineShaderString(imageFormat, tileType, read,
+                                             declarations, body, output);
+}
+
+std::string GaussianBlurMonoFilter::_generateComputeShaderString(
+    const std::string& imageFormat) {
+  return generateComputeShaderString(
+      imageFormat, "vec4", "texelFetch(inputImageTexture, texel, 0)",
+      "result");
+}
+
+bool GaussianBlurMonoFilter::_updateComputeProgram() {
+  std::string imageFormat =
+      GLCompute::getImageFormat(_framebuffer->getTextureAttributes());
+  // a framebuffer fetched for a capture is no image
+  if (imageFormat.empty()) {
+    return false;
+  }
+  // a program that failed to link is not retried for the same format
+  if (imageFormat != computeImageFormat_) {
+    if (computeProgram_) {
+      delete computeProgram_;
+    }
+    computeProgram_ = GLProgram::createByComputeShaderString(
+        _generateComputeShaderString(imageFormat));
+    computeImageFormat_ = imageFormat;
+  }
+  return computeProgram_ != nullptr;
+}
+
+bool GaussianBlurMonoFilter::_proceedCompute(bool bUpdateTargets,
+                                             int64_t frameTime) {
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  const std::vector<float>& weights = _getComputeWeights();
+  // the unused texels stay 0 like the pairs of the uniform program
+  GLfloat uniformWeights[GLCompute::kMaxLineApron + 1] = {0};
+  std::copy(weights.begin(), weights.end(), uniformWeights);
+  int radius = (int)weights.size() - 1;
+  computeProgram_->setUniformValue("blurWeights", uniformWeights,
+                                   GLCompute::kMaxLineApron + 1);
+  computeProgram_->setUniformValue("blurRadius", radius);
+  _context->getGLCompute()->dispatchLines(
+      computeProgram_, _inputFramebuffers.begin()->second.frameBuffer.get(),
+      _framebuffer.get(), _type == HORIZONTAL, radius);
+  profiler->endScope(profileScope);
+
+  return Source::proceed(bUpdateTargets, frameTime);
+}
+
 void GaussianBlurMonoFilter::setTexelSpacingMultiplier(float value) {
   verticalTexelSpacing_ = value;
   horizontalTexelSpacing_ = value;
@@ -276,8 +565,8 @@ std::string GaussianBlurMonoFilter::_generateOptimizedVertexShaderString(
       "\
                attribute vec4 position;\n\
                attribute vec4 inputTextureCoordinate;\n\
-               float texelWidthOffset;\n\
-               float texelHeightOffset;\n\
+               uniform float texelWidthOffset;\n\
+               uniform float texelHeightOffset;\n\
                varying vec2 blurCoordinates[%d];\n\
                void main()\n\
                {\n\
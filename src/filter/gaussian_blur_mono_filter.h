@@ -7,17 +7,34 @@
 
 #pragma once
 
+#include <memory>
+#include <vector>
 #include "filter_group.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
+// Up to kMaxKernelRadius the blur runs one program whatever the radius and
+// sigma, the kernel is passed as uniform arrays and changing it builds
+// nothing. The first 7 pairs of taps are read from varyings, the others
+// from coordinates computed in the fragment shader. Larger radii generate
+// a program for the kernel, shared through the program cache with every
+// blur of the same kernel.
+//
+// Where the context runs compute shaders, a blur of the input at its size
+// and up to GLCompute::kMaxLineApron texels wide is a line pass instead,
+// the taps of the kernel read from shared memory, see GLCompute.
 class GPUPIXEL_API GaussianBlurMonoFilter : public Filter {
  public:
   enum Type { HORIZONTAL, VERTICAL };
 
+  // pairs of taps the uniform arrays hold
+  static const int kMaxKernelOffsets = 16;
+  static const int kMaxKernelRadius = kMaxKernelOffsets * 2;
+
   static std::shared_ptr<GaussianBlurMonoFilter> create(Type type = HORIZONTAL,
                                                         int radius = 4,
                                                         float sigma = 2.0);
+  ~GaussianBlurMonoFilter();
   bool init(int radius, float sigma);
 
   void setRadius(int radius);
@@ -28,7 +45,44 @@ class GPUPIXEL_API GaussianBlurMonoFilter : public Filter {
   void setTexelSpacingMultiplier(float value);
 
  protected:
+  // The center texel is weighted by centerWeight. Pair i reads the two
+  // texels on either side interpolated at +-offsets[i], weighted by
+  // weights[i] each.
+  struct Kernel {
+    float centerWeight;
+    std::vector<float> weights;
+    std::vector<float> offsets;
+  };
+
   GaussianBlurMonoFilter(Type type = HORIZONTAL);
+  // builds the program for _radius and _sigma unless it has it already
+  bool _updateProgram();
+  // the kernel of |radius| and |sigma| for the uniform program
+  virtual std::shared_ptr<const Kernel> _getKernel(int radius, float sigma);
+  // shaders of the uniform program, |sumType| accumulates texture reads
+  // swizzled by |swizzle| and |output| is written from "sum"
+  static std::string generateKernelVertexShaderString();
+  static std::string generateKernelFragmentShaderString(
+      const std::string& sumType,
+      const std::string& swizzle,
+      const std::string& output);
+  virtual std::string _generateKernelFragmentShaderString();
+
+  // false for subclasses whose shaders do more than the blur
+  virtual bool _canUseCompute() const { return true; }
+  bool _usesCompute() override;
+  // The line pass of GLCompute, the tile holds |tileType| read by |read|
+  // and |output| is written from "result".
+  static std::string generateComputeShaderString(
+      const std::string& imageFormat,
+      const std::string& tileType,
+      const std::string& read,
+      const std::string& output);
+  virtual std::string _generateComputeShaderString(
+      const std::string& imageFormat);
+  // drops the compute program and weights, for subclasses changing them
+  void _resetCompute();
+
   Type _type;
   int _radius;
   float _sigma;
@@ -36,7 +90,27 @@ class GPUPIXEL_API GaussianBlurMonoFilter : public Filter {
   float verticalTexelSpacing_ = 1.0;
   float horizontalTexelSpacing_ = 1.0;
 
+  // the kernel of the uniform program, null with a generated one
+  std::shared_ptr<const Kernel> kernel_;
+  // what the program or the kernel was set up for
+  int programRadius_ = -1;
+  float programSigma_ = -1.0;
+
  private:
+  // the weight of every texel from the center on, empty when the kernel is
+  // wider than a line pass reads
+  const std::vector<float>& _getComputeWeights();
+  // false when the framebuffer is no image or the program does not link,
+  // the uniform program blurs then
+  bool _updateComputeProgram();
+  bool _proceedCompute(bool bUpdateTargets, int64_t frameTime);
+
+  GLProgram* computeProgram_ = nullptr;
+  std::string computeImageFormat_;
+  std::vector<float> computeWeights_;
+  int computeRadius_ = -1;
+  float computeSigma_ = -1.0;
+
   virtual std::string _generateVertexShaderString(int radius, float sigma);
   virtual std::string _generateFragmentShaderString(int radius, float sigma);
 
@@ -6,6 +6,7 @@
  */
 
 #include "glass_sphere_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -119,9 +120,11 @@ const std::string kGlassSphereFragmentShaderString = R"(
 
 std::shared_ptr<GlassSphereFilter> GlassSphereFilter::create() {
   auto ret = std::shared_ptr<GlassSphereFilter>(new GlassSphereFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
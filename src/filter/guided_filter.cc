@@ -0,0 +1,171 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "guided_filter.h"
+#include <cmath>
+#include "gpupixel_context.h"
+
+NS_GPUPIXEL_BEGIN
+
+REGISTER_FILTER_CLASS(GuidedUnitFilter)
+
+const std::string kGuidedSquareFragmentShaderString = R"(
+    #ifdef GL_ES
+    precision highp float;
+    #endif
+    uniform sampler2D inputImageTexture;
+    varying vec2 textureCoordinate;
+
+    void main() {
+      vec3 color = texture2D(inputImageTexture, textureCoordinate).rgb;
+      gl_FragColor = vec4(color * color, 1.0);
+    })";
+
+const std::string kGuidedUnitFragmentShaderString = R"(
+    #ifdef GL_ES
+    precision highp float;
+    #endif
+    uniform sampler2D inputImageTexture;
+    uniform sampler2D inputImageTexture1;
+    uniform sampler2D inputImageTexture2;
+    uniform float epsilon;
+    varying vec2 textureCoordinate;
+    varying vec2 textureCoordinate1;
+    varying vec2 textureCoordinate2;
+
+    void main() {
+      vec4 color = texture2D(inputImageTexture, textureCoordinate);
+      vec3 mean = texture2D(inputImageTexture1, textureCoordinate1).rgb;
+      vec3 meanOfSquares =
+          texture2D(inputImageTexture2, textureCoordinate2).rgb;
+      vec3 variance = max(meanOfSquares - mean * mean, 0.0);
+      vec3 a = variance / (variance + epsilon);
+      gl_FragColor = vec4(mean + a * (color.rgb - mean), color.a);
+    })";
+
+GuidedUnitFilter::GuidedUnitFilter() : _epsilon(0.01) {}
+
+std::shared_ptr<GuidedUnitFilter> GuidedUnitFilter::create() {
+  auto ret = std::shared_ptr<GuidedUnitFilter>(new GuidedUnitFilter());
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
+  return ret;
+}
+
+bool GuidedUnitFilter::init() {
+  return initWithFragmentShaderString(kGuidedUnitFragmentShaderString, 3);
+}
+
+bool GuidedUnitFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
+  _filterProgram->setUniformValue("epsilon", _epsilon);
+  return Filter::proceed(bUpdateTargets, frameTime);
+}
+
+void GuidedUnitFilter::setEpsilon(float epsilon) {
+  _epsilon = epsilon;
+}
+
+REGISTER_FILTER_CLASS(GuidedFilter)
+
+GuidedFilter::GuidedFilter() : _radius(8), _downSampling(1.0) {}
+
+GuidedFilter::~GuidedFilter() {}
+
+std::shared_ptr<GuidedFilter> GuidedFilter::create(int radius /* = 8*/,
+                                                   float epsilon /* = 0.01*/) {
+  auto ret = std::shared_ptr<GuidedFilter>(new GuidedFilter());
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, epsilon)) {
+      ret.reset();
+    }
+  });
+  return ret;
+}
+
+bool GuidedFilter::init(int radius, float epsilon) {
+  if (!FilterGroup::init()) {
+    return false;
+  }
+
+  _squareFilter =
+      Filter::createWithFragmentShaderString(kGuidedSquareFragmentShaderString);
+  _meanHBlurFilter =
+      BoxMonoBlurFilter::create(GaussianBlurMonoFilter::HORIZONTAL, 4, 0.0);
+  _meanVBlurFilter =
+      BoxMonoBlurFilter::create(GaussianBlurMonoFilter::VERTICAL, 4, 0.0);
+  _squareHBlurFilter =
+      BoxMonoBlurFilter::create(GaussianBlurMonoFilter::HORIZONTAL, 4, 0.0);
+  _squareVBlurFilter =
+      BoxMonoBlurFilter::create(GaussianBlurMonoFilter::VERTICAL, 4, 0.0);
+  _unitFilter = GuidedUnitFilter::create();
+  if (!_squareFilter || !_meanHBlurFilter || !_meanVBlurFilter ||
+      !_squareHBlurFilter || !_squareVBlurFilter || !_unitFilter) {
+    return false;
+  }
+
+  // the variance is the difference of two close values, 8 bits lose it
+  std::shared_ptr<Filter> statistics[] = {_squareFilter, _meanHBlurFilter,
+                                          _meanVBlurFilter, _squareHBlurFilter,
+                                          _squareVBlurFilter};
+  for (auto& filter : statistics) {
+    filter->setOutputFormat(FramebufferFormatRGBA16F);
+  }
+
+  _meanHBlurFilter->addTarget(_meanVBlurFilter)->addTarget(_unitFilter, 1);
+  _squareFilter->addTarget(_squareHBlurFilter)
+      ->addTarget(_squareVBlurFilter)
+      ->addTarget(_unitFilter, 2);
+  addFilter(_meanHBlurFilter);
+  addFilter(_squareFilter);
+  addFilter(_unitFilter);
+  setTerminalFilter(_unitFilter);
+
+  _radius = radius;
+  _updateRadius();
+  setEpsilon(epsilon);
+
+  registerProperty("radius", radius, "The half width of the box in texels.",
+                   [this](int& radius) { setRadius(radius); });
+  registerProperty("epsilon", epsilon,
+                   "The variance below which the image is smoothed.",
+                   [this](float& epsilon) { setEpsilon(epsilon); });
+  return true;
+}
+
+void GuidedFilter::setRadius(int radius) {
+  _radius = radius;
+  _updateRadius();
+}
+
+void GuidedFilter::setEpsilon(float epsilon) {
+  _unitFilter->setEpsilon(epsilon);
+}
+
+void GuidedFilter::setDownSampling(float downSampling) {
+  if (downSampling < 1.0) {
+    downSampling = 1.0;
+  }
+  _downSampling = downSampling;
+  // the squares are taken at the input size, the horizontal blurs shrink
+  _meanHBlurFilter->setFramebufferScale(1.0 / downSampling);
+  _squareHBlurFilter->setFramebufferScale(1.0 / downSampling);
+  _updateRadius();
+}
+
+void GuidedFilter::_updateRadius() {
+  // the radius counts texels of the smaller outputs
+  int radius = (int)std::round(_radius / _downSampling);
+  _meanHBlurFilter->setRadius(radius);
+  _meanVBlurFilter->setRadius(radius);
+  _squareHBlurFilter->setRadius(radius);
+  _squareVBlurFilter->setRadius(radius);
+}
+
+NS_GPUPIXEL_END
@@ -0,0 +1,72 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include "box_mono_blur_filter.h"
+#include "filter_group.h"
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+// Input 0 is the image, input 1 its box mean and input 2 the box mean of
+// its squares. Each channel is its own guide: the output is
+// mean + a * (image - mean) with a = variance / (variance + epsilon).
+class GPUPIXEL_API GuidedUnitFilter : public Filter {
+ public:
+  static std::shared_ptr<GuidedUnitFilter> create();
+  bool init();
+  virtual bool proceed(bool bUpdateTargets = true,
+                       int64_t frameTime = 0) override;
+
+  void setEpsilon(float epsilon);
+
+ protected:
+  GuidedUnitFilter();
+
+  float _epsilon;
+};
+
+// Edge preserving smoothing by the guided filter of He et al., with the
+// image guiding itself. The means of the image and of its squares are
+// the only statistics it needs, two box blurs of two passes each. From
+// BoxMonoBlurFilter::kMinPrefixSumRadius on they are prefix sums, so the
+// cost no longer depends on the radius. The statistics are kept in half
+// floats where the context renders to them.
+//
+// Smoothing is stronger where the variance of the box is small compared
+// to |epsilon|, edges with a larger variance are kept.
+class GPUPIXEL_API GuidedFilter : public FilterGroup {
+ public:
+  static std::shared_ptr<GuidedFilter> create(int radius = 8,
+                                              float epsilon = 0.01);
+  ~GuidedFilter();
+  bool init(int radius, float epsilon);
+
+  // the half width of the box in texels of the input
+  void setRadius(int radius);
+  void setEpsilon(float epsilon);
+  // Computes the statistics at 1 / |downSampling| of the input size over
+  // the same area of the image, 1 by default.
+  void setDownSampling(float downSampling);
+
+ protected:
+  GuidedFilter();
+  void _updateRadius();
+
+  int _radius;
+  float _downSampling;
+
+ private:
+  std::shared_ptr<Filter> _squareFilter;
+  std::shared_ptr<BoxMonoBlurFilter> _meanHBlurFilter;
+  std::shared_ptr<BoxMonoBlurFilter> _meanVBlurFilter;
+  std::shared_ptr<BoxMonoBlurFilter> _squareHBlurFilter;
+  std::shared_ptr<BoxMonoBlurFilter> _squareVBlurFilter;
+  std::shared_ptr<GuidedUnitFilter> _unitFilter;
+};
+
+NS_GPUPIXEL_END
@@ -6,6 +6,7 @@
  */
 
 #include "halftone_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -72,9 +73,11 @@ const std::string kHalftoneFragmentShaderString = R"(
 
 std::shared_ptr<HalftoneFilter> HalftoneFilter::create() {
   auto ret = std::shared_ptr<HalftoneFilter>(new HalftoneFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include "hsb_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -32,9 +33,11 @@ REGISTER_FILTER_CLASS(HSBFilter)
 
 std::shared_ptr<HSBFilter> HSBFilter::create() {
   auto ret = std::shared_ptr<HSBFilter>(new HSBFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
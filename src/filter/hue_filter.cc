@@ -6,6 +6,7 @@
  */
 
 #include "hue_filter.h"
+#include "gpupixel_context.h"
 #include "math_toolbox.h"
 
 USING_NS_GPUPIXEL
@@ -13,57 +14,52 @@ USING_NS_GPUPIXEL
 // Adapted from
 // http://stackoverflow.com/questions/9234724/how-to-change-hue-of-a-texture-with-glsl
 // - see for code and discussion
-const std::string kHueFragmentShaderString = R"(
-    precision highp float; uniform sampler2D inputImageTexture;
-    uniform mediump float hueAdjustment;
-    varying highp vec2 textureCoordinate;
-    const highp vec4 kRGBToYPrime = vec4(0.299, 0.587, 0.114, 0.0);
-    const highp vec4 kRGBToI = vec4(0.595716, -0.274453, -0.321263, 0.0);
-    const highp vec4 kRGBToQ = vec4(0.211456, -0.522591, 0.31135, 0.0);
-    const highp vec4 kYIQToR = vec4(1.0, 0.9563, 0.6210, 0.0);
-    const highp vec4 kYIQToG = vec4(1.0, -0.2721, -0.6474, 0.0);
-    const highp vec4 kYIQToB = vec4(1.0, -1.1070, 1.7046, 0.0);
-
-    void main() {
-      // Sample the input pixel
-      highp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-
+const std::string kHueStageShaderString = R"(
+    uniform float $hueAdjustment;
+    const vec4 $kRGBToYPrime = vec4(0.299, 0.587, 0.114, 0.0);
+    const vec4 $kRGBToI = vec4(0.595716, -0.274453, -0.321263, 0.0);
+    const vec4 $kRGBToQ = vec4(0.211456, -0.522591, 0.31135, 0.0);
+    const vec4 $kYIQToR = vec4(1.0, 0.9563, 0.6210, 0.0);
+    const vec4 $kYIQToG = vec4(1.0, -0.2721, -0.6474, 0.0);
+    const vec4 $kYIQToB = vec4(1.0, -1.1070, 1.7046, 0.0);
+
+    vec4 $apply(vec4 color) {
       // Convert to YIQ
-      highp float YPrime = dot(color, kRGBToYPrime);
-      highp float I = dot(color, kRGBToI);
-      highp float Q = dot(color, kRGBToQ);
+      float YPrime = dot(color, $kRGBToYPrime);
+      float I = dot(color, $kRGBToI);
+      float Q = dot(color, $kRGBToQ);
 
       // Calculate the hue and chroma
-      highp float hue = atan(Q, I);
-      highp float chroma = sqrt(I * I + Q * Q);
+      float hue = atan(Q, I);
+      float chroma = sqrt(I * I + Q * Q);
 
       // Make the user's adjustments
-      hue += (-hueAdjustment);  // why negative rotation?
+      hue += (-$hueAdjustment);  // why negative rotation?
 
       // Convert back to YIQ
       Q = chroma * sin(hue);
       I = chroma * cos(hue);
 
       // Convert back to RGB
-      highp vec4 yIQ = vec4(YPrime, I, Q, 0.0);
-      color.r = dot(yIQ, kYIQToR);
-      color.g = dot(yIQ, kYIQToG);
-      color.b = dot(yIQ, kYIQToB);
-
-      // Save the result
-      gl_FragColor = color;
+      vec4 yIQ = vec4(YPrime, I, Q, 0.0);
+      color.r = dot(yIQ, $kYIQToR);
+      color.g = dot(yIQ, $kYIQToG);
+      color.b = dot(yIQ, $kYIQToB);
+      return color;
     })";
 
 std::shared_ptr<HueFilter> HueFilter::create() {
   auto ret = std::shared_ptr<HueFilter>(new HueFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool HueFilter::init() {
-  if (!initWithFragmentShaderString(kHueFragmentShaderString)) {
+  if (!initWithStageShaderString(kHueStageShaderString)) {
     return false;
   }
 
@@ -81,7 +77,7 @@ void HueFilter::setHueAdjustment(float hueAdjustment) {
   _hueAdjustment = fmodf(hueAdjustment, 360.0) * M_PI / 180;
 }
 
-bool HueFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("hueAdjustment", _hueAdjustment);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void HueFilter::setStageUniforms(GLProgram* program,
+                                 const std::string& prefix) {
+  program->setUniformValue(prefix + "hueAdjustment", _hueAdjustment);
 }
@@ -6,6 +6,7 @@
  */
 
 #include "ios_blur_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -18,9 +19,11 @@ IOSBlurFilter::~IOSBlurFilter() {}
 
 std::shared_ptr<IOSBlurFilter> IOSBlurFilter::create() {
   auto ret = std::shared_ptr<IOSBlurFilter>(new IOSBlurFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -6,15 +6,18 @@
  */
 
 #include "lipstick_filter.h"
+#include "gpupixel_context.h"
 #include "face_detector.h"
 #include "source_image.h"
 
 NS_GPUPIXEL_BEGIN
 std::shared_ptr<LipstickFilter> LipstickFilter::create() {
   auto ret = std::shared_ptr<LipstickFilter>(new LipstickFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
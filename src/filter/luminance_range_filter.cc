@@ -6,6 +6,7 @@
  */
 
 #include "luminance_range_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -44,9 +45,11 @@ const std::string kLuminanceRangeFragmentShaderString = R"(
 
 std::shared_ptr<LuminanceRangeFilter> LuminanceRangeFilter::create() {
   auto ret = std::shared_ptr<LuminanceRangeFilter>(new LuminanceRangeFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
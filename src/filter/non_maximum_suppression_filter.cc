@@ -6,6 +6,7 @@
  */
 
 #include "non_maximum_suppression_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -58,9 +59,11 @@ std::shared_ptr<NonMaximumSuppressionFilter>
 NonMaximumSuppressionFilter::create() {
   auto ret = std::shared_ptr<NonMaximumSuppressionFilter>(
       new NonMaximumSuppressionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
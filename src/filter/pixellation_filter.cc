@@ -6,6 +6,7 @@
  */
 
 #include "pixellation_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -27,9 +28,11 @@ const std::string kPixellationFragmentShaderString = R"(
 
 std::shared_ptr<PixellationFilter> PixellationFilter::create() {
   auto ret = std::shared_ptr<PixellationFilter>(new PixellationFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -58,8 +61,8 @@ void PixellationFilter::setPixelSize(float pixelSize) {
 
 bool PixellationFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
   float aspectRatio = 1.0;
-  std::shared_ptr<Framebuffer> firstInputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
+  Framebuffer* firstInputFramebuffer =
+      _inputFramebuffers.begin()->second.frameBuffer.get();
   aspectRatio = firstInputFramebuffer->getHeight() /
                 (float)(firstInputFramebuffer->getWidth());
   _filterProgram->setUniformValue("aspectRatio", aspectRatio);
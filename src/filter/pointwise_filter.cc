@@ -0,0 +1,330 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "pointwise_filter.h"
+#include <atomic>
+#include <cmath>
+#include <typeinfo>
+#include "gpupixel_context.h"
+
+NS_GPUPIXEL_BEGIN
+
+// one source for every platform, the stages carry no precision qualifiers
+const std::string kPointwiseFragmentShaderHeader = R"(
+    #ifdef GL_ES
+    #ifdef GL_FRAGMENT_PRECISION_HIGH
+    precision highp float;
+    #else
+    precision mediump float;
+    #endif
+    #endif
+    uniform sampler2D inputImageTexture;
+    varying vec2 textureCoordinate;
+)";
+
+// Texel (r, g) of tile b holds the color of lattice point (r, g, b) when
+// opaque, tiles laid out row by row. The two slices around the blue of the
+// color are read bilinearly and mixed, alpha is scaled by the baked one.
+const std::string kLutFragmentShaderString = R"(
+    #ifdef GL_ES
+    #ifdef GL_FRAGMENT_PRECISION_HIGH
+    precision highp float;
+    #else
+    precision mediump float;
+    #endif
+    #endif
+    uniform sampler2D inputImageTexture;
+    uniform sampler2D lutTexture;
+    uniform float lutSize;
+    uniform vec2 lutGrid;
+    varying vec2 textureCoordinate;
+
+    vec2 tileOrigin(float slice) {
+      float row = floor(slice / lutGrid.x);
+      return vec2(slice - row * lutGrid.x, row) * lutSize;
+    }
+
+    void main() {
+      vec4 color = texture2D(inputImageTexture, textureCoordinate);
+      float blue = color.b * (lutSize - 1.0);
+      float slice = min(floor(blue), lutSize - 2.0);
+      vec2 texel = color.rg * (lutSize - 1.0) + 0.5;
+      vec2 atlasSize = lutGrid * lutSize;
+      vec4 low =
+          texture2D(lutTexture, (tileOrigin(slice) + texel) / atlasSize);
+      vec4 high =
+          texture2D(lutTexture, (tileOrigin(slice + 1.0) + texel) / atlasSize);
+      vec4 result = mix(low, high, blue - slice);
+      gl_FragColor = vec4(result.rgb, color.a * result.a);
+    })";
+
+static std::atomic<int> s_lutSize(0);
+static std::atomic<int> s_lutMinStages(4);
+static const int kMaxLutSize = 128;
+
+PointwiseFilter::PointwiseFilter()
+    : _fusedStages(nullptr),
+      _fusedProgram(nullptr),
+      _latticeProgram(nullptr),
+      _fusedPositionAttribute(-1),
+      _fusedTexCoordAttribute(-1),
+      _fusedInputTextureUniform(-1),
+      _lutProgram(nullptr),
+      _lutSize(0),
+      _lutColumns(0),
+      _lutRevision(0) {}
+
+PointwiseFilter::~PointwiseFilter() {
+  if (_fusedProgram) {
+    delete _fusedProgram;
+    _fusedProgram = nullptr;
+  }
+  if (_latticeProgram) {
+    delete _latticeProgram;
+    _latticeProgram = nullptr;
+  }
+  if (_lutProgram) {
+    delete _lutProgram;
+    _lutProgram = nullptr;
+  }
+}
+
+void PointwiseFilter::setLutBaking(int lutSize, int minStages /* = 4*/) {
+  if (lutSize != 0 && (lutSize < 2 || lutSize > kMaxLutSize)) {
+    Util::Log("WARNING", "PointwiseFilter: lookup table size %d out of range",
+              lutSize);
+    return;
+  }
+  s_lutSize = lutSize;
+  s_lutMinStages = minStages;
+}
+
+int PointwiseFilter::getLutSize() {
+  return s_lutSize;
+}
+
+static std::string getStagePrefix(int stage) {
+  return Util::str_format("s%d_", stage);
+}
+
+// appends the declarations of the stages, returns the statements applying
+// them to "color" in order
+static std::string appendStages(std::string& shader,
+                                const std::vector<std::string>& stageSources) {
+  std::string apply;
+  for (size_t i = 0; i < stageSources.size(); ++i) {
+    // a filter drawn alone keeps the plain names
+    std::string prefix =
+        stageSources.size() > 1 ? getStagePrefix((int)i) : "";
+    const std::string& source = stageSources[i];
+    size_t begin = 0;
+    size_t end = 0;
+    while ((end = source.find('$', begin)) != std::string::npos) {
+      shader.append(source, begin, end - begin);
+      shader += prefix;
+      begin = end + 1;
+    }
+    shader.append(source, begin, std::string::npos);
+    shader += "\n";
+    // as the framebuffers between unfused filters do
+    apply += Util::str_format("  color = clamp(%sapply(color), 0.0, 1.0);\n",
+                              prefix.c_str());
+  }
+  return apply;
+}
+
+std::string PointwiseFilter::generateFragmentShaderString(
+    const std::vector<std::string>& stageSources) {
+  std::string shader = kPointwiseFragmentShaderHeader;
+  std::string apply = appendStages(shader, stageSources);
+  shader +=
+      "void main() {\n"
+      "  vec4 color = texture2D(inputImageTexture, textureCoordinate);\n";
+  shader += apply;
+  shader += "  gl_FragColor = color;\n}\n";
+  return shader;
+}
+
+std::string PointwiseFilter::generateLatticeShaderString(
+    const std::vector<std::string>& stageSources) {
+  std::string shader = kPointwiseFragmentShaderHeader;
+  shader +=
+      "uniform float lutSize;\n"
+      "uniform float lutColumns;\n";
+  std::string apply = appendStages(shader, stageSources);
+  shader +=
+      "void main() {\n"
+      "  vec2 texel = floor(gl_FragCoord.xy);\n"
+      "  vec2 tile = floor(texel / lutSize);\n"
+      "  vec3 lattice = vec3(texel - tile * lutSize,\n"
+      "                      tile.y * lutColumns + tile.x);\n"
+      "  vec4 color = vec4(min(lattice / (lutSize - 1.0), 1.0), 1.0);\n";
+  shader += apply;
+  shader += "  gl_FragColor = color;\n}\n";
+  return shader;
+}
+
+bool PointwiseFilter::initWithStageShaderString(
+    const std::string& stageShaderSource) {
+  _stageSource = stageShaderSource;
+  return initWithFragmentShaderString(
+      generateFragmentShaderString({stageShaderSource}));
+}
+
+bool PointwiseFilter::proceed(bool bUpdateTargets /* = true*/,
+                              int64_t frameTime /* = 0*/) {
+  if (_fusedStages && _fusedStages->size() > 1) {
+    return _proceedFused(bUpdateTargets, frameTime);
+  }
+  setStageUniforms(_filterProgram, "");
+  return Filter::proceed(bUpdateTargets, frameTime);
+}
+
+bool PointwiseFilter::_shouldBake() const {
+  if (s_lutSize == 0 || (int)_fusedStages->size() < s_lutMinStages) {
+    return false;
+  }
+  for (auto stage : *_fusedStages) {
+    if (!stage->isBakeable()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PointwiseFilter::_proceedFused(bool bUpdateTargets, int64_t frameTime) {
+  const std::vector<PointwiseFilter*>& stages = *_fusedStages;
+  bool changed = stages.size() != _fusedSources.size();
+  for (size_t i = 0; !changed && i < stages.size(); ++i) {
+    changed = stages[i]->getStageShaderString() != _fusedSources[i];
+  }
+  if (changed) {
+    // identical chains elsewhere share the programs, see ProgramCache
+    _fusedSources.clear();
+    _fusedPrefixes.clear();
+    for (size_t i = 0; i < stages.size(); ++i) {
+      _fusedSources.push_back(stages[i]->getStageShaderString());
+      _fusedPrefixes.push_back(getStagePrefix((int)i));
+    }
+    delete _fusedProgram;
+    _fusedProgram = nullptr;
+    delete _latticeProgram;
+    _latticeProgram = nullptr;
+    _lutSize = 0;
+  }
+
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope(typeid(*this).name());
+  bool bake = _shouldBake();
+  if (bake) {
+    if (!_bakeLut(s_lutSize)) {
+      profiler->endScope(profileScope);
+      return false;
+    }
+  } else {
+    if (!_fusedProgram) {
+      _fusedProgram = GLProgram::createByShaderString(
+          kDefaultVertexShader, generateFragmentShaderString(_fusedSources));
+      if (!_fusedProgram) {
+        profiler->endScope(profileScope);
+        return false;
+      }
+      _fusedPositionAttribute = _fusedProgram->getAttribLocation("position");
+      _fusedTexCoordAttribute =
+          _fusedProgram->getAttribLocation("inputTextureCoordinate");
+      _fusedInputTextureUniform =
+          _fusedProgram->getUniformLocation("inputImageTexture");
+    }
+    // the table would be stale by the time baking is on again
+    _lutFramebuffer.reset();
+    _lutSize = 0;
+    for (size_t i = 0; i < stages.size(); ++i) {
+      stages[i]->setStageUniforms(_fusedProgram, _fusedPrefixes[i]);
+    }
+  }
+
+  _framebuffer->active();
+  _context->getGLStateCache()->clearColor(
+      _backgroundColor.r, _backgroundColor.g, _backgroundColor.b,
+      _backgroundColor.a);
+  CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+  const InputFrameBufferInfo& input = _inputFramebuffers.begin()->second;
+  _context->getGLStateCache()->bindTexture(0, input.frameBuffer->getTexture());
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  if (bake) {
+    _context->setActiveShaderProgram(_lutProgram);
+    _context->getGLStateCache()->bindTexture(1,
+                                             _lutFramebuffer->getTexture());
+    _lutProgram->setUniformValue("inputImageTexture", 0);
+    _lutProgram->setUniformValue("lutTexture", 1);
+    _lutProgram->setUniformValue("lutSize", (float)_lutSize);
+    int rows = (_lutSize + _lutColumns - 1) / _lutColumns;
+    _lutProgram->setUniformValue("lutGrid",
+                                 Vector2((float)_lutColumns, (float)rows));
+    quad->bind(_lutProgram->getAttribLocation("position"),
+               _lutProgram->getAttribLocation("inputTextureCoordinate"),
+               input.rotationMode);
+  } else {
+    _context->setActiveShaderProgram(_fusedProgram);
+    _fusedProgram->setUniformValue(_fusedInputTextureUniform, 0);
+    quad->bind(_fusedPositionAttribute, _fusedTexCoordAttribute,
+               input.rotationMode);
+  }
+  quad->draw();
+  _framebuffer->inactive();
+  profiler->endScope(profileScope);
+
+  return Source::proceed(bUpdateTargets, frameTime);
+}
+
+bool PointwiseFilter::_bakeLut(int lutSize) {
+  const std::vector<PointwiseFilter*>& stages = *_fusedStages;
+  if (!_latticeProgram) {
+    _latticeProgram = GLProgram::createByShaderString(
+        kDefaultVertexShader, generateLatticeShaderString(_fusedSources));
+  }
+  if (!_lutProgram) {
+    _lutProgram = GLProgram::createByShaderString(kDefaultVertexShader,
+                                                  kLutFragmentShaderString);
+  }
+  if (!_latticeProgram || !_lutProgram) {
+    return false;
+  }
+  // only uniforms that really change count, see GLProgram::getRevision()
+  for (size_t i = 0; i < stages.size(); ++i) {
+    stages[i]->setStageUniforms(_latticeProgram, _fusedPrefixes[i]);
+  }
+  if (_lutSize == lutSize && _lutFramebuffer &&
+      _lutRevision == _latticeProgram->getRevision()) {
+    return true;
+  }
+
+  TRACE_SCOPE("PointwiseFilter::bakeLut");
+  int columns = (int)std::ceil(std::sqrt((double)lutSize));
+  int rows = (lutSize + columns - 1) / columns;
+  if (!_lutFramebuffer || _lutSize != lutSize) {
+    _lutFramebuffer = _context->getFramebufferCache()->fetchFramebuffer(
+        columns * lutSize, rows * lutSize);
+  }
+  _latticeProgram->setUniformValue("lutSize", (float)lutSize);
+  _latticeProgram->setUniformValue("lutColumns", (float)columns);
+  _context->setActiveShaderProgram(_latticeProgram);
+  _lutFramebuffer->active();
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_latticeProgram->getAttribLocation("position"),
+             _latticeProgram->getAttribLocation("inputTextureCoordinate"),
+             NoRotation);
+  quad->draw();
+  _lutFramebuffer->inactive();
+
+  _lutSize = lutSize;
+  _lutColumns = columns;
+  _lutRevision = _latticeProgram->getRevision();
+  return true;
+}
+
+NS_GPUPIXEL_END
@@ -0,0 +1,97 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "filter.h"
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+
+// A filter whose output pixel depends on the input pixel at the same place
+// only. Its shader is written as a stage: declarations and a function
+// "vec4 $apply(vec4 color)", where "$" stands for a prefix keeping the names
+// of several stages apart in one shader.
+//
+// The frame graph fuses a chain of pointwise filters whose intermediate
+// outputs nobody else reads. The last filter of the chain then draws every
+// stage in a single pass, the others draw nothing.
+//
+// Long chains, or ones whose properties rarely change, can be baked instead:
+// the chain is evaluated once over a lattice of colors into a lookup table,
+// which frames then read with a single interpolated lookup. The table is a
+// 2D atlas of blue slices, as GLES 2 has no 3D textures, and is baked again
+// only when a uniform of a stage or the chain itself changes. A baked chain
+// scales alpha by the alpha it gives the opaque color, the color stages do
+// not read alpha.
+class GPUPIXEL_API PointwiseFilter : public Filter {
+ public:
+  virtual ~PointwiseFilter();
+
+  bool initWithStageShaderString(const std::string& stageShaderSource);
+  virtual bool proceed(bool bUpdateTargets = true,
+                       int64_t frameTime = 0) override;
+
+  const std::string& getStageShaderString() const { return _stageSource; }
+  // sets the uniforms of the stage, |prefix| replacing the "$" of the names
+  virtual void setStageUniforms(GLProgram* /*program*/,
+                                const std::string& /*prefix*/) {}
+  // false for stages a smoothly interpolated table can not stand for
+  virtual bool isBakeable() const { return true; }
+
+  // Set by the frame graph while this filter draws the chain ending with it,
+  // first stage first. Null draws the filter alone.
+  void setFusedStages(const std::vector<PointwiseFilter*>* stages) {
+    _fusedStages = stages;
+  }
+
+  // the fragment shader applying |stageSources| in order
+  static std::string generateFragmentShaderString(
+      const std::vector<std::string>& stageSources);
+  // the fragment shader evaluating |stageSources| over the lattice of a
+  // lookup table atlas
+  static std::string generateLatticeShaderString(
+      const std::vector<std::string>& stageSources);
+
+  // Fused chains of at least |minStages| bakeable stages are baked into a
+  // lookup table of |lutSize|^3 colors, 2 to 128. A size of 0, the default,
+  // turns baking off.
+  static void setLutBaking(int lutSize, int minStages = 4);
+  static int getLutSize();
+
+ protected:
+  PointwiseFilter();
+
+  std::string _stageSource;
+  const std::vector<PointwiseFilter*>* _fusedStages;
+
+ private:
+  bool _proceedFused(bool bUpdateTargets, int64_t frameTime);
+  bool _shouldBake() const;
+  // false when a program of the table does not link
+  bool _bakeLut(int lutSize);
+
+  // the programs of the chain last drawn, rebuilt when its stages change
+  GLProgram* _fusedProgram;
+  GLProgram* _latticeProgram;
+  std::vector<std::string> _fusedSources;
+  std::vector<std::string> _fusedPrefixes;
+  GLint _fusedPositionAttribute;
+  GLint _fusedTexCoordAttribute;
+  GLint _fusedInputTextureUniform;
+
+  // the baked table and what it was baked from, a size of 0 bakes it again
+  GLProgram* _lutProgram;
+  std::shared_ptr<Framebuffer> _lutFramebuffer;
+  int _lutSize;
+  int _lutColumns;
+  uint64_t _lutRevision;
+};
+
+NS_GPUPIXEL_END
@@ -6,43 +6,31 @@
  */
 
 #include "posterize_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
 REGISTER_FILTER_CLASS(PosterizeFilter)
 
-#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
-const std::string kPosterizeFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform highp float colorLevels;
-    varying highp vec2 textureCoordinate;
+const std::string kPosterizeStageShaderString = R"(
+    uniform float $colorLevels;
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-
-      gl_FragColor = floor((color * colorLevels) + vec4(0.5)) / colorLevels;
+    vec4 $apply(vec4 color) {
+      return floor((color * $colorLevels) + vec4(0.5)) / $colorLevels;
     })";
-#elif defined(GPUPIXEL_MAC) || defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
-const std::string kPosterizeFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform float colorLevels;
-    varying vec2 textureCoordinate;
-
-    void main() {
-      vec4 color = texture2D(inputImageTexture, textureCoordinate);
-
-      gl_FragColor = floor((color * colorLevels) + vec4(0.5)) / colorLevels;
-    })";
-#endif
 
 std::shared_ptr<PosterizeFilter> PosterizeFilter::create() {
   auto ret = std::shared_ptr<PosterizeFilter>(new PosterizeFilter());
-  if (ret && !ret->init()) {
-    // todo zhaoyou
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      // todo zhaoyou
+    }
+  });
   return ret;
 }
 
 bool PosterizeFilter::init() {
-  if (!initWithFragmentShaderString(kPosterizeFragmentShaderString)) {
+  if (!initWithStageShaderString(kPosterizeStageShaderString)) {
     return false;
   }
 
@@ -64,7 +52,7 @@ void PosterizeFilter::setColorLevels(int colorLevels) {
   }
 }
 
-bool PosterizeFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("colorLevels", (float)_colorLevels);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void PosterizeFilter::setStageUniforms(GLProgram* program,
+                                       const std::string& prefix) {
+  program->setUniformValue(prefix + "colorLevels", (float)_colorLevels);
 }
@@ -7,16 +7,18 @@
 
 #pragma once
 
-#include "filter.h"
+#include "pointwise_filter.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API PosterizeFilter : public Filter {
+class GPUPIXEL_API PosterizeFilter : public PointwiseFilter {
  public:
   static std::shared_ptr<PosterizeFilter> create();
   bool init();
-  virtual bool proceed(bool bUpdateTargets = true,
-                       int64_t frameTime = 0) override;
+  virtual void setStageUniforms(GLProgram* program,
+                                const std::string& prefix) override;
+  // the steps would be smeared by the interpolation of a table
+  virtual bool isBakeable() const override { return false; }
 
   void setColorLevels(int colorLevels);
 
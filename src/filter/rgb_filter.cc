@@ -6,33 +6,34 @@
  */
 
 #include "rgb_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
 REGISTER_FILTER_CLASS(RGBFilter)
 
-const std::string kRGBFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform highp float redAdjustment;
-    uniform highp float greenAdjustment;
-    uniform highp float blueAdjustment;
-    varying highp vec2 textureCoordinate;
+const std::string kRGBStageShaderString = R"(
+    uniform float $redAdjustment;
+    uniform float $greenAdjustment;
+    uniform float $blueAdjustment;
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      gl_FragColor = vec4(color.r * redAdjustment, color.g * greenAdjustment,
-                          color.b * blueAdjustment, color.a);
+    vec4 $apply(vec4 color) {
+      return vec4(color.r * $redAdjustment, color.g * $greenAdjustment,
+                  color.b * $blueAdjustment, color.a);
     })";
 
 std::shared_ptr<RGBFilter> RGBFilter::create() {
   auto ret = std::shared_ptr<RGBFilter>(new RGBFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool RGBFilter::init() {
-  if (!initWithFragmentShaderString(kRGBFragmentShaderString)) {
+  if (!initWithStageShaderString(kRGBStageShaderString)) {
     return false;
   }
 
@@ -81,9 +82,9 @@ void RGBFilter::setBlueAdjustment(float blueAdjustment) {
     _blueAdjustment = 0.0;
   }
 }
-bool RGBFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("redAdjustment", _redAdjustment);
-  _filterProgram->setUniformValue("greenAdjustment", _greenAdjustment);
-  _filterProgram->setUniformValue("blueAdjustment", _blueAdjustment);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void RGBFilter::setStageUniforms(GLProgram* program,
+                                 const std::string& prefix) {
+  program->setUniformValue(prefix + "redAdjustment", _redAdjustment);
+  program->setUniformValue(prefix + "greenAdjustment", _greenAdjustment);
+  program->setUniformValue(prefix + "blueAdjustment", _blueAdjustment);
 }
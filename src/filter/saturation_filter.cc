@@ -6,35 +6,36 @@
  */
 
 #include "saturation_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
-const std::string kSaturationFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp float saturation;
-    varying highp vec2 textureCoordinate;
+const std::string kSaturationStageShaderString = R"(
+    uniform float $saturation;
 
     // Values from "Graphics Shaders: Theory and Practice" by Bailey and
     // Cunningham
-    const mediump vec3 luminanceWeighting = vec3(0.2125, 0.7154, 0.0721);
+    const vec3 $luminanceWeighting = vec3(0.2125, 0.7154, 0.0721);
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      lowp float luminance = dot(color.rgb, luminanceWeighting);
-      lowp vec3 greyScaleColor = vec3(luminance);
+    vec4 $apply(vec4 color) {
+      float luminance = dot(color.rgb, $luminanceWeighting);
+      vec3 greyScaleColor = vec3(luminance);
 
-      gl_FragColor = vec4(mix(greyScaleColor, color.rgb, saturation), color.a);
+      return vec4(mix(greyScaleColor, color.rgb, $saturation), color.a);
     })";
 
 std::shared_ptr<SaturationFilter> SaturationFilter::create() {
   auto ret = std::shared_ptr<SaturationFilter>(new SaturationFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool SaturationFilter::init() {
-  if (!initWithFragmentShaderString(kSaturationFragmentShaderString)) {
+  if (!initWithStageShaderString(kSaturationStageShaderString)) {
     return false;
   }
 
@@ -57,7 +58,7 @@ void SaturationFilter::setSaturation(float saturation) {
   }
 }
 
-bool SaturationFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("saturation", _saturation);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void SaturationFilter::setStageUniforms(GLProgram* program,
+                                        const std::string& prefix) {
+  program->setUniformValue(prefix + "saturation", _saturation);
 }
@@ -6,6 +6,7 @@
  */
 
 #include "single_component_gaussian_blur_filter.h"
+#include "gpupixel_context.h"
 #include <cmath>
 #include "util.h"
 
@@ -21,9 +22,11 @@ SingleComponentGaussianBlurFilter::create(int radius /* = 4*/,
                                           float sigma /* = 2.0*/) {
   auto ret = std::shared_ptr<SingleComponentGaussianBlurFilter>(
       new SingleComponentGaussianBlurFilter());
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -56,4 +59,10 @@ void SingleComponentGaussianBlurFilter::setSigma(float sigma) {
   _vBlurFilter->setSigma(sigma);
 }
 
+void SingleComponentGaussianBlurFilter::setLuminanceInput(
+    bool luminanceInput) {
+  // the vertical pass reads the luminance the horizontal one wrote
+  _hBlurFilter->setLuminanceInput(luminanceInput);
+}
+
 NS_GPUPIXEL_END
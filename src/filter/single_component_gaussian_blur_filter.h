@@ -22,6 +22,8 @@ class GPUPIXEL_API SingleComponentGaussianBlurFilter : public FilterGroup {
   bool init(int radius, float sigma);
   void setRadius(int radius);
   void setSigma(float sigma);
+  // see SingleComponentGaussianBlurMonoFilter::setLuminanceInput()
+  void setLuminanceInput(bool luminanceInput);
 
  protected:
   SingleComponentGaussianBlurFilter();
@@ -6,6 +6,7 @@
  */
 
 #include "single_component_gaussian_blur_mono_filter.h"
+#include "gpupixel_context.h"
 #include <cmath>
 
 NS_GPUPIXEL_BEGIN
@@ -14,7 +15,10 @@ REGISTER_FILTER_CLASS(SingleComponentGaussianBlurMonoFilter)
 
 SingleComponentGaussianBlurMonoFilter::SingleComponentGaussianBlurMonoFilter(
     Type type /* = HORIZONTAL*/)
-    : GaussianBlurMonoFilter(type) {}
+    : GaussianBlurMonoFilter(type), luminanceInput_(false) {
+  // the blur is luminance only
+  _outputFormat = FramebufferFormatR8;
+}
 
 std::shared_ptr<SingleComponentGaussianBlurMonoFilter>
 SingleComponentGaussianBlurMonoFilter::create(Type type /* = HORIZONTAL*/,
@@ -22,12 +26,108 @@ SingleComponentGaussianBlurMonoFilter::create(Type type /* = HORIZONTAL*/,
                                               float sigma /* = 2.0*/) {
   auto ret = std::shared_ptr<SingleComponentGaussianBlurMonoFilter>(
       new SingleComponentGaussianBlurMonoFilter(type));
-  if (ret && !ret->init(radius, sigma)) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init(radius, sigma)) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
+void SingleComponentGaussianBlurMonoFilter::setLuminanceInput(
+    bool luminanceInput) {
+  if (luminanceInput == luminanceInput_) {
+    return;
+  }
+  luminanceInput_ = luminanceInput;
+  // the shaders and the kernel change with the radius kept
+  kernel_.reset();
+  programRadius_ = -1;
+  _updateProgram();
+  _resetCompute();
+}
+
+std::shared_ptr<const GaussianBlurMonoFilter::Kernel>
+SingleComponentGaussianBlurMonoFilter::_getKernel(int radius, float sigma) {
+  if (!luminanceInput_ || radius < 1 || sigma <= 0.0 ||
+      radius > kMaxKernelOffsets) {
+    return GaussianBlurMonoFilter::_getKernel(radius, sigma);
+  }
+
+  // Every texel is read at its center, an interpolated read would mix
+  // luminances that were not rounded yet.
+  auto kernel = std::make_shared<Kernel>();
+  std::vector<float> standardGaussianWeights(radius + 1);
+  float sumOfWeights = 0.0;
+  for (int i = 0; i < radius + 1; ++i) {
+    standardGaussianWeights[i] = (1.0 / sqrt(2.0 * M_PI * pow(sigma, 2.0))) *
+                                 exp(-pow(i, 2.0) / (2.0 * pow(sigma, 2.0)));
+    sumOfWeights += i == 0 ? standardGaussianWeights[i]
+                           : 2.0 * standardGaussianWeights[i];
+  }
+  kernel->centerWeight = standardGaussianWeights[0] / sumOfWeights;
+  for (int i = 1; i < radius + 1; ++i) {
+    kernel->weights.push_back(standardGaussianWeights[i] / sumOfWeights);
+    kernel->offsets.push_back(i);
+  }
+  return kernel;
+}
+
+std::string SingleComponentGaussianBlurMonoFilter::_readLuminance(
+    const std::string& shader) {
+  // Every read of the red channel becomes a read of the luminance, rounded
+  // to 8 bits as the framebuffer of a GrayscaleFilter would round it.
+  std::string shaderStr;
+  size_t begin = 0;
+  size_t end = 0;
+  const std::string read = "texture2D(inputImageTexture, ";
+  while ((end = shader.find(read, begin)) != std::string::npos) {
+    shaderStr.append(shader, begin, end - begin);
+    shaderStr += "luminance(";
+    begin = shader.find(").r", end) + 3;
+    shaderStr.append(shader, end + read.size(), begin - 2 - end - read.size());
+  }
+  shaderStr.append(shader, begin, std::string::npos);
+
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
+  const std::string luminance =
+      "highp float luminance(highp vec2 coordinate) {\n"
+      "  highp vec3 color = texture2D(inputImageTexture, coordinate).rgb;\n"
+      "  highp float value = dot(color, vec3(0.2125, 0.7154, 0.0721));\n"
+      "  return floor(value * 255.0 + 0.5) / 255.0;\n"
+      "}\n";
+#else
+  const std::string luminance =
+      "float luminance(vec2 coordinate) {\n"
+      "  vec3 color = texture2D(inputImageTexture, coordinate).rgb;\n"
+      "  float value = dot(color, vec3(0.2125, 0.7154, 0.0721));\n"
+      "  return floor(value * 255.0 + 0.5) / 255.0;\n"
+      "}\n";
+#endif
+  shaderStr.insert(shaderStr.find("void main"), luminance);
+  return shaderStr;
+}
+
+std::string
+SingleComponentGaussianBlurMonoFilter::_generateKernelFragmentShaderString() {
+  std::string shaderStr = generateKernelFragmentShaderString(
+      "float", ".r", "vec4(sum, sum, sum, 1.0)");
+  return luminanceInput_ ? _readLuminance(shaderStr) : shaderStr;
+}
+
+std::string
+SingleComponentGaussianBlurMonoFilter::_generateComputeShaderString(
+    const std::string& imageFormat) {
+  // the tile holds the luminance rounded as _readLuminance() rounds it
+  const std::string read =
+      luminanceInput_
+          ? "floor(dot(texelFetch(inputImageTexture, texel, 0).rgb,\n"
+            "            vec3(0.2125, 0.7154, 0.0721)) * 255.0 + 0.5) / 255.0"
+          : "texelFetch(inputImageTexture, texel, 0).r";
+  return generateComputeShaderString(imageFormat, "float", read,
+                                     "vec4(result, result, result, 1.0)");
+}
+
 std::string
 SingleComponentGaussianBlurMonoFilter::_generateOptimizedVertexShaderString(
     int radius,
@@ -177,8 +277,7 @@ SingleComponentGaussianBlurMonoFilter::_generateOptimizedFragmentShaderString(
       numberOfOptimizedOffsets * 2 + 1);
 #endif
   shaderStr += Util::str_format(
-      "gl_FragColor += texture2D(inputImageTexture, "
-      "blurCoordinates[0]) * %f;\n",
+      "sum += texture2D(inputImageTexture, blurCoordinates[0]).r * %f;\n",
       standardGaussianWeights[0]);
   for (int i = 0; i < numberOfOptimizedOffsets; ++i) {
     float firstWeight = standardGaussianWeights[i * 2 + 1];
@@ -196,9 +295,14 @@ SingleComponentGaussianBlurMonoFilter::_generateOptimizedFragmentShaderString(
   // If the number of required samples exceeds the amount we can pass in via
   // varyings, we have to do dependent texture reads in the fragment shader
   if (trueNumberOfOptimizedOffsets > numberOfOptimizedOffsets) {
+#if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_ANDROID)
     shaderStr += Util::str_format(
         "highp vec2 texelSpacing = vec2(texelWidthOffset, "
         "texelHeightOffset);\n");
+#elif defined(GPUPIXEL_MAC) || defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
+    shaderStr += Util::str_format(
+        "vec2 texelSpacing = vec2(texelWidthOffset, texelHeightOffset);\n");
+#endif
 
     for (int i = numberOfOptimizedOffsets; i < trueNumberOfOptimizedOffsets;
          i++) {
@@ -228,7 +332,7 @@ SingleComponentGaussianBlurMonoFilter::_generateOptimizedFragmentShaderString(
 
   delete[] standardGaussianWeights;
   standardGaussianWeights = 0;
-  return shaderStr;
+  return luminanceInput_ ? _readLuminance(shaderStr) : shaderStr;
 }
 
 NS_GPUPIXEL_END
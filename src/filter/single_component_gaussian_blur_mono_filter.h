@@ -17,10 +17,21 @@ class GPUPIXEL_API SingleComponentGaussianBlurMonoFilter
   static std::shared_ptr<SingleComponentGaussianBlurMonoFilter>
   create(Type type = HORIZONTAL, int radius = 4, float sigma = 2.0);
 
+  // Blurs the luminance of the rgb input instead of its red channel, which
+  // saves a GrayscaleFilter in front of the blur.
+  void setLuminanceInput(bool luminanceInput);
+
  protected:
   SingleComponentGaussianBlurMonoFilter(Type type = HORIZONTAL);
 
+  bool luminanceInput_;
+
  private:
+  std::shared_ptr<const Kernel> _getKernel(int radius, float sigma) override;
+  static std::string _readLuminance(const std::string& shader);
+  std::string _generateKernelFragmentShaderString() override;
+  std::string _generateComputeShaderString(
+      const std::string& imageFormat) override;
   std::string _generateOptimizedVertexShaderString(int radius,
                                                    float sigma) override;
   std::string _generateOptimizedFragmentShaderString(int radius,
@@ -6,6 +6,7 @@
  */
 
 #include "sketch_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -55,9 +56,11 @@ SketchFilter::~SketchFilter() {}
 
 std::shared_ptr<SketchFilter> SketchFilter::create() {
   auto ret = std::shared_ptr<SketchFilter>(new SketchFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
 
   return ret;
 }
@@ -84,9 +87,11 @@ bool SketchFilter::init() {
 
 std::shared_ptr<_SketchFilter> _SketchFilter::create() {
   auto ret = std::shared_ptr<_SketchFilter>(new _SketchFilter());
-  if (!ret || !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!ret || !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -106,8 +111,6 @@ bool _SketchFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
   float texelWidth = 1.0 / _framebuffer->getWidth();
   float texelHeight = 1.0 / _framebuffer->getHeight();
 
-  std::shared_ptr<Framebuffer> inputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
   RotationMode inputRotation = _inputFramebuffers.begin()->second.rotationMode;
   if (rotationSwapsSize(inputRotation)) {
     texelWidth = 1.0 / _framebuffer->getHeight();
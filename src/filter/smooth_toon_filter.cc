@@ -6,6 +6,7 @@
  */
 
 #include "smooth_toon_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -17,9 +18,11 @@ SmoothToonFilter::~SmoothToonFilter() {}
 
 std::shared_ptr<SmoothToonFilter> SmoothToonFilter::create() {
   auto ret = std::shared_ptr<SmoothToonFilter>(new SmoothToonFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
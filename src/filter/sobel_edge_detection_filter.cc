@@ -6,6 +6,7 @@
  */
 
 #include "sobel_edge_detection_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -59,9 +60,11 @@ SobelEdgeDetectionFilter::~SobelEdgeDetectionFilter() {}
 std::shared_ptr<SobelEdgeDetectionFilter> SobelEdgeDetectionFilter::create() {
   auto ret =
       std::shared_ptr<SobelEdgeDetectionFilter>(new SobelEdgeDetectionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
 
   return ret;
 }
@@ -89,9 +92,11 @@ bool SobelEdgeDetectionFilter::init() {
 std::shared_ptr<_SobelEdgeDetectionFilter> _SobelEdgeDetectionFilter::create() {
   auto ret = std::shared_ptr<_SobelEdgeDetectionFilter>(
       new _SobelEdgeDetectionFilter());
-  if (!ret || !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!ret || !ret->init()) {
+      ret.reset();
+    }
+  });
 
   return ret;
 }
@@ -113,8 +118,6 @@ bool _SobelEdgeDetectionFilter::proceed(bool bUpdateTargets,
   float texelWidth = 1.0 / _framebuffer->getWidth();
   float texelHeight = 1.0 / _framebuffer->getHeight();
 
-  std::shared_ptr<Framebuffer> inputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
   RotationMode inputRotation = _inputFramebuffers.begin()->second.rotationMode;
   if (rotationSwapsSize(inputRotation)) {
     texelWidth = 1.0 / _framebuffer->getHeight();
@@ -6,6 +6,7 @@
  */
 
 #include "sphere_refraction_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -81,9 +82,11 @@ const std::string kSphereRefractionShaderString = R"(
 std::shared_ptr<SphereRefractionFilter> SphereRefractionFilter::create() {
   auto ret =
       std::shared_ptr<SphereRefractionFilter>(new SphereRefractionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
@@ -125,8 +128,8 @@ bool SphereRefractionFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
   _filterProgram->setUniformValue("refractiveIndex", _refractiveIndex);
 
   float aspectRatio = 1.0;
-  std::shared_ptr<Framebuffer> firstInputFramebuffer =
-      _inputFramebuffers.begin()->second.frameBuffer;
+  Framebuffer* firstInputFramebuffer =
+      _inputFramebuffers.begin()->second.frameBuffer.get();
   aspectRatio = firstInputFramebuffer->getHeight() /
                 (float)(firstInputFramebuffer->getWidth());
   _filterProgram->setUniformValue("aspectRatio", aspectRatio);
@@ -6,6 +6,7 @@
  */
 
 #include "toon_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
@@ -59,9 +60,11 @@ const std::string kToonFragmentShaderString = R"(
 
 std::shared_ptr<ToonFilter> ToonFilter::create() {
   auto ret = std::shared_ptr<ToonFilter>(new ToonFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
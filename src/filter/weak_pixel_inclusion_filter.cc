@@ -6,6 +6,7 @@
  */
 
 #include "weak_pixel_inclusion_filter.h"
+#include "gpupixel_context.h"
 
 NS_GPUPIXEL_BEGIN
 
@@ -94,14 +95,18 @@ const std::string kWeakPixelInclusionFragmentShaderString = R"(
 std::shared_ptr<WeakPixelInclusionFilter> WeakPixelInclusionFilter::create() {
   auto ret =
       std::shared_ptr<WeakPixelInclusionFilter>(new WeakPixelInclusionFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool WeakPixelInclusionFilter::init() {
   if (initWithFragmentShaderString(kWeakPixelInclusionFragmentShaderString)) {
+    // the edges are luminance only
+    _outputFormat = FramebufferFormatR8;
     return true;
   }
   return false;
@@ -6,31 +6,31 @@
  */
 
 #include "white_balance_filter.h"
+#include "gpupixel_context.h"
 
 USING_NS_GPUPIXEL
 
 REGISTER_FILTER_CLASS(WhiteBalanceFilter)
 
-const std::string kWhiteBalanceFragmentShaderString = R"(
-    uniform sampler2D inputImageTexture; uniform lowp float temperature;
-    uniform lowp float tint;
-    varying highp vec2 textureCoordinate;
-    const lowp vec3 warmFilter = vec3(0.93, 0.54, 0.0);
-    const mediump mat3 RGBtoYIQ =
+const std::string kWhiteBalanceStageShaderString = R"(
+    uniform float $temperature;
+    uniform float $tint;
+    const vec3 $warmFilter = vec3(0.93, 0.54, 0.0);
+    const mat3 $RGBtoYIQ =
         mat3(0.299, 0.587, 0.114,
              0.596, -0.274, -0.322,
              0.212, -0.523, 0.311);
-    const mediump mat3 YIQtoRGB =
+    const mat3 $YIQtoRGB =
         mat3(1.0, 0.956, 0.621,
              1.0, -0.272, -0.647,
              1.0, -1.105, 1.702);
 
-    void main() {
-      lowp vec4 color = texture2D(inputImageTexture, textureCoordinate);
-      mediump vec3 yiq = RGBtoYIQ * color.rgb;  // adjusting tint
-      yiq.b = clamp(yiq.b + tint * 0.5226 * 0.1, -0.5226, 0.5226);
-      lowp vec3 rgb = YIQtoRGB * yiq;
-      lowp vec3 processed = vec3(
+    vec4 $apply(vec4 color) {
+      vec3 yiq = $RGBtoYIQ * color.rgb;  // adjusting tint
+      yiq.b = clamp(yiq.b + $tint * 0.5226 * 0.1, -0.5226, 0.5226);
+      vec3 rgb = $YIQtoRGB * yiq;
+      vec3 warmFilter = $warmFilter;
+      vec3 processed = vec3(
           (rgb.r < 0.5
                ? (2.0 * rgb.r * warmFilter.r)
                : (1.0 - 2.0 * (1.0 - rgb.r) *
@@ -40,19 +40,21 @@ const std::string kWhiteBalanceFragmentShaderString = R"(
           (rgb.b < 0.5 ? (2.0 * rgb.b * warmFilter.b)
                        : (1.0 - 2.0 * (1.0 - rgb.b) * (1.0 - warmFilter.b))));
 
-      gl_FragColor = vec4(mix(rgb, processed, temperature), color.a);
+      return vec4(mix(rgb, processed, $temperature), color.a);
     })";
 
 std::shared_ptr<WhiteBalanceFilter> WhiteBalanceFilter::create() {
   auto ret = std::shared_ptr<WhiteBalanceFilter>(new WhiteBalanceFilter());
-  if (ret && !ret->init()) {
-    ret.reset();
-  }
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (ret && !ret->init()) {
+      ret.reset();
+    }
+  });
   return ret;
 }
 
 bool WhiteBalanceFilter::init() {
-  if (!initWithFragmentShaderString(kWhiteBalanceFragmentShaderString)) {
+  if (!initWithStageShaderString(kWhiteBalanceStageShaderString)) {
     return false;
   }
 
@@ -80,8 +82,8 @@ void WhiteBalanceFilter::setTint(float tint) {
   _tint = tint / 100.0;
 }
 
-bool WhiteBalanceFilter::proceed(bool bUpdateTargets, int64_t frameTime) {
-  _filterProgram->setUniformValue("temperature", _temperature);
-  _filterProgram->setUniformValue("tint", _tint);
-  return Filter::proceed(bUpdateTargets, frameTime);
+void WhiteBalanceFilter::setStageUniforms(GLProgram* program,
+                                          const std::string& prefix) {
+  program->setUniformValue(prefix + "temperature", _temperature);
+  program->setUniformValue(prefix + "tint", _tint);
 }
@@ -7,16 +7,16 @@
 
 #pragma once
 
-#include "filter.h"
+#include "pointwise_filter.h"
 #include "gpupixel_macros.h"
 
 NS_GPUPIXEL_BEGIN
-class GPUPIXEL_API WhiteBalanceFilter : public Filter {
+class GPUPIXEL_API WhiteBalanceFilter : public PointwiseFilter {
  public:
   static std::shared_ptr<WhiteBalanceFilter> create();
   bool init();
-  virtual bool proceed(bool bUpdateTargets = true,
-                       int64_t frameTime = 0) override;
+  virtual void setStageUniforms(GLProgram* program,
+                                const std::string& prefix) override;
 
   void setTemperature(float temperature);
   void setTint(float tint);
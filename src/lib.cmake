@@ -204,6 +204,10 @@ IF(${CURRENT_OS} STREQUAL "linux" OR ${CURRENT_OS} STREQUAL "wasm")
 						vnn_core
 						vnn_kit
 						vnn_face)
+	IF(${CURRENT_OS} STREQUAL "linux")
+		# headless context backend
+		TARGET_LINK_LIBRARIES(${PROJECT_NAME} EGL)
+	ENDIF()
 ELSEIF(${CURRENT_OS} STREQUAL "windows")
 	TARGET_LINK_LIBRARIES(
 						${PROJECT_NAME} 
@@ -271,4 +275,4 @@ MACRO(EXPORT_INCLUDE)
 				)
 ENDMACRO()
 
-EXPORT_INCLUDE()
\ No newline at end of file
+EXPORT_INCLUDE()
\ No newline at end of file
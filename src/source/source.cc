@@ -6,6 +6,8 @@
  */
 
 #include "source.h"
+#include <typeinfo>
+#include "frame_graph.h"
 #include "gpupixel_context.h"
 #include "util.h"
 
@@ -15,26 +17,42 @@
 
 NS_GPUPIXEL_BEGIN
 
+// nesting of updateTargets() on this thread, 0 outside of a frame
+static thread_local int s_updateDepth = 0;
+
 Source::Source()
-    : _framebuffer(0),
+    : _context(GPUPixelContext::getInstance()),
+      _framebuffer(0),
       _outputRotation(RotationMode::NoRotation),
-      _framebufferScale(1.0) {}
+      _framebufferScale(1.0),
+      _retainFramebuffer(false),
+      _releaseFramebufferAfterUpdate(false) {}
 
 Source::~Source() {
-  removeAllTargets();
+  // no running frame reaches a source being destroyed, and the context may
+  // be gone already
+  _targets.clear();
 }
 
 std::shared_ptr<Source> Source::addTarget(std::shared_ptr<Target> target) {
-  int targetTexIdx = target->getNextAvailableTextureIndex();
-  return addTarget(target, targetTexIdx);
+  std::shared_ptr<Source> ret;
+  _context->runSync([&] {
+    int targetTexIdx = target->getNextAvailableTextureIndex();
+    ret = addTarget(target, targetTexIdx);
+  });
+  return ret;
 }
 
 std::shared_ptr<Source> Source::addTarget(std::shared_ptr<Target> target,
                                           int texIdx) {
-  if (!hasTarget(target)) {
-    _targets[target] = texIdx;
-    target->setInputFramebuffer(_framebuffer, RotationMode::NoRotation, texIdx);
-  }
+  _context->runSync([&] {
+    if (!hasTarget(target)) {
+      _context->invalidateFrameGraphs();
+      _targets[target] = texIdx;
+      target->setInputFramebuffer(_framebuffer, RotationMode::NoRotation,
+                                  texIdx);
+    }
+  });
   return std::dynamic_pointer_cast<Source>(target);
 }
 
@@ -55,14 +73,22 @@ bool Source::hasTarget(const std::shared_ptr<Target> target) const {
 }
 
 void Source::removeTarget(std::shared_ptr<Target> target) {
-  auto itr = _targets.find(target);
-  if (itr != _targets.end()) {
-    _targets.erase(itr);
-  }
+  _context->runSync([&] {
+    auto itr = _targets.find(target);
+    if (itr != _targets.end()) {
+      _context->invalidateFrameGraphs();
+      _targets.erase(itr);
+    }
+  });
 }
 
 void Source::removeAllTargets() {
-  _targets.clear();
+  _context->runSync([&] {
+    if (!_targets.empty()) {
+      _context->invalidateFrameGraphs();
+    }
+    _targets.clear();
+  });
 }
 
 bool Source::proceed(bool bUpdateTargets /* = true*/,
@@ -74,50 +100,121 @@ bool Source::proceed(bool bUpdateTargets /* = true*/,
 }
 
 void Source::updateTargets(int64_t frameTime) {
+  bool isRoot = s_updateDepth == 0;
+  if (isRoot) {
+    if (!_frameGraph) {
+      _frameGraph = std::make_shared<FrameGraph>();
+    }
+    if (_frameGraph->isStale()) {
+      _frameGraph->build(this);
+    }
+    // capturing redirects the output of one filter, run it the long way
+    if (!_context->isCapturingFrame) {
+      s_updateDepth++;
+      _frameGraph->execute(frameTime);
+      s_updateDepth--;
+      _context->endFrame();
+      return;
+    }
+  } else if (FrameGraph::onSourceUpdated(this)) {
+    return;
+  }
+
+  // once every consumer holds the output, a transient one is owned by them
+  // alone and returns to the cache after the last of them has drawn
+  for (auto& it : _targets) {
+    it.first->setInputFramebuffer(_framebuffer, _outputRotation, it.second);
+  }
+  if (!isRoot && _releaseFramebufferAfterUpdate) {
+    _framebuffer.reset();
+  }
+
+  s_updateDepth++;
   for (auto& it : _targets) {
     auto target = it.first;
-    target->setInputFramebuffer(_framebuffer, _outputRotation,
-                                _targets[target]);
     if (target->isPrepared()) {
+      TRACE_SCOPE(typeid(*target).name());
+      _context->getGLDebug()->setCurrentPass(typeid(*target).name());
       target->update(frameTime);
       target->unPrepear();
     }
   }
+  s_updateDepth--;
+  if (isRoot) {
+    _context->endFrame();
+  }
 }
 
 unsigned char* Source::captureAProcessedFrameData(
     std::shared_ptr<Filter> upToFilter,
     int width /* = 0*/,
     int height /* = 0*/) {
-  if (GPUPixelContext::getInstance()->isCapturingFrame) {
-    return 0;
-  }
-
-  if (width <= 0 || height <= 0) {
-    if (!_framebuffer) {
-      return 0;
+  unsigned char* processedFrameData = 0;
+  // queued frames read the capture state, set it between two of them
+  _context->runSync([&] {
+    if (_context->isCapturingFrame) {
+      return;
     }
-    width = getRotatedFramebufferWidth();
-    height = getRotatedFramebufferHeight();
-  }
 
-  GPUPixelContext::getInstance()->isCapturingFrame = true;
-  GPUPixelContext::getInstance()->captureWidth = width;
-  GPUPixelContext::getInstance()->captureHeight = height;
-  GPUPixelContext::getInstance()->captureUpToFilter = upToFilter;
+    if (width <= 0 || height <= 0) {
+      if (!_framebuffer) {
+        return;
+      }
+      width = getRotatedFramebufferWidth();
+      height = getRotatedFramebufferHeight();
+    }
 
-  proceed(true);
-  unsigned char* processedFrameData =
-      GPUPixelContext::getInstance()->capturedFrameData;
+    _context->isCapturingFrame = true;
+    _context->captureWidth = width;
+    _context->captureHeight = height;
+    _context->captureUpToFilter = upToFilter;
 
-  GPUPixelContext::getInstance()->capturedFrameData = 0;
-  GPUPixelContext::getInstance()->captureWidth = 0;
-  GPUPixelContext::getInstance()->captureHeight = 0;
-  GPUPixelContext::getInstance()->isCapturingFrame = false;
+    proceed(true);
+    processedFrameData = _context->capturedFrameData;
 
+    _context->capturedFrameData = 0;
+    _context->captureWidth = 0;
+    _context->captureHeight = 0;
+    _context->isCapturingFrame = false;
+  });
   return processedFrameData;
 }
 
+void Source::warmUp(int width, int height) {
+  if (width <= 0 || height <= 0) {
+    return;
+  }
+  _context->runSync([=] {
+    if (_context->isCapturingFrame) {
+      return;
+    }
+    TRACE_SCOPE("Source::warmUp");
+    // a source without a frame of that size yet draws from a blank one,
+    // which then waits in the cache for its first upload
+    std::shared_ptr<Framebuffer> framebuffer = _framebuffer;
+    if (!_framebuffer || _framebuffer->getWidth() != width ||
+        _framebuffer->getHeight() != height) {
+      _framebuffer =
+          _context->getFramebufferCache()->fetchFramebuffer(width, height);
+      _framebuffer->active();
+      _context->getGLStateCache()->clearColor(0.0, 0.0, 0.0, 1.0);
+      CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
+      _framebuffer->inactive();
+    }
+
+    _context->isWarmingUp = true;
+    // outputs kept between frames need more framebuffers from the second
+    // frame on
+    for (int i = 0; i < 2; ++i) {
+      Source::proceed(true, 0);
+    }
+    _context->isWarmingUp = false;
+    _framebuffer = framebuffer;
+    // drivers finish compiling on the first draw, have them do it now
+    CHECK_GL(glFinish());
+  });
+}
+
 void Source::setFramebuffer(
     std::shared_ptr<Framebuffer> fb,
     RotationMode outputRotation /* = RotationMode::NoRotation*/) {
@@ -164,4 +261,13 @@ std::shared_ptr<Framebuffer> Source::getFramebuffer() const {
 
 void Source::releaseFramebuffer(bool returnToCache /* = true*/) {}
 
+void Source::setRetainFramebuffer(bool retain) {
+  _context->runSync([&] {
+    if (_retainFramebuffer != retain) {
+      _retainFramebuffer = retain;
+      _context->invalidateFrameGraphs();
+    }
+  });
+}
+
 NS_GPUPIXEL_END
@@ -18,7 +18,16 @@
 
 NS_GPUPIXEL_BEGIN
 class GPUPIXEL_API Filter;
+class GPUPixelContext;
+class FrameGraph;
 
+// Frames run on the render thread of the context, see
+// GPUPixelContext::runSync(). Edits of the graph, addTarget(),
+// removeTarget(), removeAllTargets(), setRetainFramebuffer() and the filter
+// group edits, as well as Filter::setProperty(), are handed to the render
+// thread and take effect between frames; they may be called from any
+// thread. The plain setters of the filters store values the next frame
+// reads, call them on the render thread while frames run on it.
 class GPUPIXEL_API Source {
  public:
   Source();
@@ -41,6 +50,11 @@ class GPUPIXEL_API Source {
       RotationMode outputRotation = RotationMode::NoRotation);
   virtual std::shared_ptr<Framebuffer> getFramebuffer() const;
   virtual void releaseFramebuffer(bool returnToCache = true);
+  // Outputs consumed only by other filters go back to the framebuffer cache
+  // during the frame. Retain the output to read it with getFramebuffer()
+  // after the frame has run.
+  void setRetainFramebuffer(bool retain);
+  bool isRetainFramebuffer() const { return _retainFramebuffer; }
 
   void setFramebufferScale(float framebufferScale) {
     _framebufferScale = framebufferScale;
@@ -55,13 +69,30 @@ class GPUPIXEL_API Source {
       std::shared_ptr<Filter> upToFilter,
       int width = 0,
       int height = 0);
+  // Runs blank frames of |width| x |height| through the targets: the frame
+  // graph is built, every program is drawn with once, and the framebuffers
+  // of the chain are allocated into the cache. Programs are compiled when
+  // their filters are created, not here; drawing once only makes drivers
+  // that defer work to the first draw do it now. Targets deliver nothing
+  // from these frames. Blocks until the GPU is done.
+  void warmUp(int width, int height);
   int RegLandmarkCallback(FaceDetectorCallback callback);
+
+  // context current on the creating thread, all rendering happens on it
+  GPUPixelContext* getContext() const { return _context; }
  protected:
+  friend class FrameGraph;
+
+  GPUPixelContext* _context;
   std::shared_ptr<Framebuffer> _framebuffer;
   RotationMode _outputRotation;
   std::map<std::shared_ptr<Target>, int> _targets;
   float _framebufferScale;
   std::shared_ptr<FaceDetector> _face_detector;
+  bool _retainFramebuffer;
+  // set by the frame graph of the root source
+  bool _releaseFramebufferAfterUpdate;
+  std::shared_ptr<FrameGraph> _frameGraph;
 };
 
 NS_GPUPIXEL_END
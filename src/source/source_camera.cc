@@ -46,7 +46,7 @@ void SourceCamera::setFrameData(
   if (!_framebuffer || (_framebuffer->getWidth() != width ||
                         _framebuffer->getHeight() != height)) {
     _framebuffer =
-        GPUPixelContext::getInstance()->getFramebufferCache()->fetchFramebuffer(
+        _context->getFramebufferCache()->fetchFramebuffer(
             width, height, true);
   }
   if(_face_detector) {
@@ -56,7 +56,8 @@ void SourceCamera::setFrameData(
   }
   this->setFramebuffer(_framebuffer, outputRotation);
 
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->getFramebuffer()->getTexture()));
+  _context->getGLStateCache()->bindTexture(
+      this->getFramebuffer()->getTexture());
 #if defined(GPUPIXEL_IOS)
   CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_BGRA,
                         GL_UNSIGNED_BYTE, pixels));
@@ -64,7 +65,7 @@ void SourceCamera::setFrameData(
   CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
                         GL_UNSIGNED_BYTE, pixels));
 #endif
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+  _context->getGLStateCache()->bindTexture(0);
 }
 
 #if defined(GPUPIXEL_IOS)
@@ -315,7 +316,7 @@ void SourceCamera::_updateOutputRotation() {
     didOutputSampleBuffer:(CMSampleBufferRef)sampleBuffer
            fromConnection:(AVCaptureConnection*)connection {
   if (_sourceCamera) {
-    GPUPixelContext::getInstance()->runSync([&] {
+    _sourceCamera->getContext()->runSync([&] {
       CVImageBufferRef imageBuffer = CMSampleBufferGetImageBuffer(sampleBuffer);
       CVPixelBufferLockBaseAddress(imageBuffer, 0);
       _sourceCamera->setFrameData((int)CVPixelBufferGetWidth(imageBuffer),
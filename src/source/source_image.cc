@@ -42,51 +42,55 @@ std::shared_ptr<SourceImage> SourceImage::create(const std::string name) {
 }
 
 void SourceImage::init(int width, int height, int channel_count, const unsigned char* pixels) {
+  _context->runSync([&] {
     this->setFramebuffer(0);
     if (!_framebuffer || (_framebuffer->getWidth() != width ||
-                            _framebuffer->getHeight() != height)) {
-        _framebuffer =
-                GPUPixelContext::getInstance()->getFramebufferCache()->fetchFramebuffer(
-                        width, height, true);
+                          _framebuffer->getHeight() != height)) {
+      _framebuffer = _context->getFramebufferCache()->fetchFramebuffer(
+          width, height, true);
     }
     this->setFramebuffer(_framebuffer);
-    CHECK_GL(glBindTexture(GL_TEXTURE_2D, this->getFramebuffer()->getTexture()));
-  if(channel_count == 3) {
-    CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
-                          GL_UNSIGNED_BYTE, pixels));
-   
-    int rgba_size = width * height * 4;
-    uint8_t* rgba = new uint8_t[rgba_size];
-    
-    for (int i = 0; i < width * height; i++) {
-        rgba[i * 4 + 0] = pixels[i * 3 + 0];  // Red
-        rgba[i * 4 + 1] = pixels[i * 3 + 1];  // Green
-        rgba[i * 4 + 2] = pixels[i * 3 + 2];  // Blue
-        rgba[i * 4 + 3] = 255;              // Alpha (fully opaque)
+    _context->getGLStateCache()->bindTexture(
+        this->getFramebuffer()->getTexture());
+    if(channel_count == 3) {
+      CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB,
+                            GL_UNSIGNED_BYTE, pixels));
+
+      int rgba_size = width * height * 4;
+      uint8_t* rgba = new uint8_t[rgba_size];
+
+      for (int i = 0; i < width * height; i++) {
+          rgba[i * 4 + 0] = pixels[i * 3 + 0];  // Red
+          rgba[i * 4 + 1] = pixels[i * 3 + 1];  // Green
+          rgba[i * 4 + 2] = pixels[i * 3 + 2];  // Blue
+          rgba[i * 4 + 3] = 255;              // Alpha (fully opaque)
+      }
+
+      image_bytes.assign(rgba, rgba + width * height *4);
+
+      delete[] rgba;
+    } else if(channel_count == 4) {
+      CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+                            GL_UNSIGNED_BYTE, pixels));
+      image_bytes.assign(pixels, pixels + width * height *4);
     }
-    
-    image_bytes.assign(rgba, rgba + width * height *4);
-    
-    delete[] rgba;
-  } else if(channel_count == 4) {
-    CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
-                          GL_UNSIGNED_BYTE, pixels));
-    image_bytes.assign(pixels, pixels + width * height *4);
-  }
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+    _context->getGLStateCache()->bindTexture(0);
+  });
 }
 
 void SourceImage::Render() {
   GPUPIXEL_FRAME_TYPE type;
-  if(_face_detector) {
-    _face_detector->Detect(image_bytes.data(),
-                           _framebuffer->getWidth(),
-                           _framebuffer->getHeight(),
-                           GPUPIXEL_MODE_FMT_PICTURE,
-                           GPUPIXEL_FRAME_TYPE_RGBA8888);
-  }
-  
-  Source::proceed();
+  _context->runSync([&] {
+    if(_face_detector) {
+      _face_detector->Detect(image_bytes.data(),
+                             _framebuffer->getWidth(),
+                             _framebuffer->getHeight(),
+                             GPUPIXEL_MODE_FMT_PICTURE,
+                             GPUPIXEL_FRAME_TYPE_RGBA8888);
+    }
+
+    Source::proceed();
+  });
 }
 
 unsigned char* SourceImage::getPixels() const {
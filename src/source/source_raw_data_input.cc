@@ -9,6 +9,8 @@
 #include "gpupixel_context.h"
 #include "util.h"
 #include "face_detector.h"
+#include <cstring>
+#include <vector>
 USING_NS_GPUPIXEL
 
 const std::string kI420VertexShaderString = R"(
@@ -73,23 +75,32 @@ const std::string kI420FragmentShaderString = R"(
 std::shared_ptr<SourceRawDataInput> SourceRawDataInput::create() {
   auto sourceRawDataInput =
       std::shared_ptr<SourceRawDataInput>(new SourceRawDataInput());
-  if (sourceRawDataInput->init()) {
-    return sourceRawDataInput;
-  }
-  return nullptr;
+  GPUPixelContext::getInstance()->runSync([&] {
+    if (!sourceRawDataInput->init()) {
+      sourceRawDataInput.reset();
+    }
+  });
+  return sourceRawDataInput;
 }
 
 SourceRawDataInput::SourceRawDataInput() {}
 
 SourceRawDataInput::~SourceRawDataInput() {
-  GPUPixelContext::getInstance()->runSync(
-      [=] { glDeleteTextures(4, _textures); });
+  _context->runSync([=] {
+    for (int i = 0; i < 4; ++i) {
+      _context->getGLStateCache()->onTextureDeleted(_textures[i]);
+    }
+    glDeleteTextures(4, _textures);
+  });
 }
 
 bool SourceRawDataInput::init() {
   _filterProgram = GLProgram::createByShaderString(kI420VertexShaderString,
                                                    kI420FragmentShaderString);
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  if (!_filterProgram) {
+    return false;
+  }
+  _context->setActiveShaderProgram(_filterProgram);
 
   //
   _filterPositionAttribute = _filterProgram->getAttribLocation("position");
@@ -105,7 +116,7 @@ bool SourceRawDataInput::init() {
   }
 
   for (int i = 0; i < 4; ++i) {
-    glBindTexture(GL_TEXTURE_2D, _textures[i]);
+    _context->getGLStateCache()->bindTexture(_textures[i]);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -122,11 +133,19 @@ void SourceRawDataInput::uploadBytes(const uint8_t* pixels,
                                      int height,
                                      int stride,
                                      int64_t ts) {
-  GPUPixelContext::getInstance()->runSync([=] {
+  // the caller may reuse |pixels| once this returns, the frame is rendered
+  // later on the render thread
+  TRACE_FRAME(ts);
+  TRACE_SCOPE("SourceRawDataInput copy");
+  auto frame = std::make_shared<std::vector<uint8_t>>(
+      pixels, pixels + (size_t)stride * height * 4);
+  _context->runAsync([=] {
+    TRACE_FRAME(ts);
+    const uint8_t* data = frame->data();
     if(_face_detector) {
-      _face_detector->Detect(pixels, width, height, GPUPIXEL_MODE_FMT_VIDEO,GPUPIXEL_FRAME_TYPE_RGBA8888);
+      _face_detector->Detect(data, width, height, GPUPIXEL_MODE_FMT_VIDEO,GPUPIXEL_FRAME_TYPE_RGBA8888);
     }
-    genTextureWithRGBA(pixels, width, height, stride, ts); 
+    genTextureWithRGBA(data, width, height, stride, ts);
   });
 }
 
@@ -143,13 +162,25 @@ void SourceRawDataInput::uploadBytes(int width,
                                      const uint8_t* dataV,
                                      int strideV,
                                      int64_t ts) {
-  GPUPixelContext::getInstance()->runSync([=] {
+  TRACE_FRAME(ts);
+  TRACE_SCOPE("SourceRawDataInput copy");
+  size_t sizeY = (size_t)strideY * height;
+  size_t sizeU = (size_t)strideU * ((height + 1) / 2);
+  size_t sizeV = (size_t)strideV * ((height + 1) / 2);
+  auto frame = std::make_shared<std::vector<uint8_t>>(sizeY + sizeU + sizeV);
+  memcpy(frame->data(), dataY, sizeY);
+  memcpy(frame->data() + sizeY, dataU, sizeU);
+  memcpy(frame->data() + sizeY + sizeU, dataV, sizeV);
+  _context->runAsync([=] {
+    TRACE_FRAME(ts);
+    const uint8_t* y = frame->data();
+    const uint8_t* u = y + sizeY;
+    const uint8_t* v = u + sizeU;
     if(_face_detector) {
-      _face_detector->Detect(dataY, width, height, GPUPIXEL_MODE_FMT_VIDEO, GPUPIXEL_FRAME_TYPE_YUVI420);
+      _face_detector->Detect(y, width, height, GPUPIXEL_MODE_FMT_VIDEO, GPUPIXEL_FRAME_TYPE_YUVI420);
     }
 
-    genTextureWithI420(width, height, dataY, strideY, dataU, strideU, dataV,
-                       strideV, ts);
+    genTextureWithI420(width, height, y, strideY, u, strideU, v, strideV, ts);
   });
 }
 
@@ -162,48 +193,39 @@ int SourceRawDataInput::genTextureWithI420(int width,
                                            const uint8_t* dataV,
                                            int strideV,
                                            int64_t ts) {
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope("SourceRawDataInput upload I420");
   if (!_framebuffer || (_framebuffer->getWidth() != width ||
                         _framebuffer->getHeight() != height)) {
     _framebuffer =
-        GPUPixelContext::getInstance()->getFramebufferCache()->fetchFramebuffer(
-            width, height);
+        _context->getFramebufferCache()->fetchFramebuffer(width, height);
   }
 
   this->setFramebuffer(_framebuffer, NoRotation);
 
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  _context->setActiveShaderProgram(_filterProgram);
   this->getFramebuffer()->active();
 
-  GLfloat imageVertices[]{
-      -1.0, -1.0,  // left down
-      1.0,  -1.0,  // right down
-      -1.0, 1.0,   // left up
-      1.0,  1.0    // right up
-  };
-
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-
-  CHECK_GL(glEnableVertexAttribArray(_filterTexCoordAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
-                                 _getTexureCoordinate(_rotation)));
-
   const uint8_t* pixels[3] = {dataY, dataU, dataV};
   const int widths[3] = {width, width / 2, width / 2};
   const int heights[3] = {height, height / 2, height / 2};
 
-  for (int i = 0; i < 3; ++i) {
-    glActiveTexture(GL_TEXTURE0 + i);
-    glBindTexture(GL_TEXTURE_2D, _textures[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, widths[i], heights[i], 0,
-                 GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels[i]);
+  {
+    TRACE_SCOPE("SourceRawDataInput upload I420");
+    for (int i = 0; i < 3; ++i) {
+      _context->getGLStateCache()->bindTexture(i, _textures[i]);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, widths[i], heights[i], 0,
+                   GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels[i]);
+    }
   }
   
   _filterProgram->setUniformValue("texture_type", 0);
   // draw frame buffer
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute, _filterTexCoordAttribute, _rotation);
+  quad->draw();
   this->getFramebuffer()->inactive();
+  profiler->endScope(profileScope);
 
   Source::proceed(true, ts);
   return 0;
@@ -214,52 +236,43 @@ int SourceRawDataInput::genTextureWithRGBA(const uint8_t* pixels,
                                            int height,
                                            int stride,
                                            int64_t ts) {
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope("SourceRawDataInput upload RGBA");
   if (!_framebuffer || (_framebuffer->getWidth() != stride ||
                         _framebuffer->getHeight() != height)) {
     _framebuffer =
-        GPUPixelContext::getInstance()->getFramebufferCache()->fetchFramebuffer(
-            stride, height);
+        _context->getFramebufferCache()->fetchFramebuffer(stride, height);
   }
   this->setFramebuffer(_framebuffer, NoRotation);
 
   GLuint texture = _textures[3];
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, texture));
+  _context->getGLStateCache()->bindTexture(texture);
 
+  {
+    TRACE_SCOPE("SourceRawDataInput upload RGBA");
 #if defined(GPUPIXEL_IOS) || defined(GPUPIXEL_MAC)
-  CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, stride, height, 0, GL_BGRA,
-                        GL_UNSIGNED_BYTE, pixels));
+    CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, stride, height, 0,
+                          GL_BGRA, GL_UNSIGNED_BYTE, pixels));
 #else
-  CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, stride, height, 0, GL_RGBA,
-                        GL_UNSIGNED_BYTE, pixels));
+    CHECK_GL(glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, stride, height, 0,
+                          GL_RGBA, GL_UNSIGNED_BYTE, pixels));
 #endif
+  }
 
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  _context->setActiveShaderProgram(_filterProgram);
   this->getFramebuffer()->active();
 
-  GLfloat imageVertices[]{
-    -1.0f, -1.0f,
-    1.0f, -1.0f,
-    -1.0f, 1.0f,
-    1.0f, 1.0f,
-  };
-
   _filterProgram->setUniformValue("texture_type", 1);
 
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-
-  CHECK_GL(glEnableVertexAttribArray(_filterTexCoordAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
-                                 _getTexureCoordinate(_rotation)));
-
-  CHECK_GL(glActiveTexture(GL_TEXTURE4));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, texture));
+  _context->getGLStateCache()->bindTexture(4, texture);
   _filterProgram->setUniformValue("inputImageTexture", 4);
 
   // draw frame buffer
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute, _filterTexCoordAttribute, _rotation);
+  quad->draw();
   this->getFramebuffer()->inactive();
+  profiler->endScope(profileScope);
 
   Source::proceed(true, ts);
   return 0;
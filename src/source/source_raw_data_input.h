@@ -15,6 +15,9 @@ class GPUPIXEL_API SourceRawDataInput : public Filter {
  public:
   ~SourceRawDataInput();
   static std::shared_ptr<SourceRawDataInput> create();
+  // Copies the frame and returns without waiting for the filter chain, which
+  // runs on the render thread of the context. Blocks only while the context
+  // already has its maximum of pending frames.
   void uploadBytes(const uint8_t* pixels,
                    int width,
                    int height,
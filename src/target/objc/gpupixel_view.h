@@ -15,6 +15,10 @@
 #import "gpupixel_target.h"
 #include "target_view.h"
 
+// Frames are drawn and presented on the render thread of the context, see
+// GPUPixelContext::runSync(). The view itself, its size and its window, is
+// only used on the main thread: on macOS the frame is presented through the
+// NSOpenGLContext of the view, without locking its focus.
 #if defined(GPUPIXEL_IOS)
 @interface GPUPixelView : UIView <GPUPixelTarget>
 #else
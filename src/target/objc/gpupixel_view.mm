@@ -11,6 +11,7 @@
 #include "filter.h"
 
 #import <AVFoundation/AVFoundation.h>
+#include <atomic>
 
 @interface GPUPixelView()
 {
@@ -18,6 +19,7 @@
     gpupixel::RotationMode inputRotation;
     GLuint displayFramebuffer;
     GLuint displayRenderbuffer;
+    gpupixel::GPUPixelContext* context;
     gpupixel::GLProgram* displayProgram;
     GLuint positionAttribLocation;
     GLuint texCoordAttribLocation;
@@ -28,6 +30,10 @@
     CGSize lastBoundsSize;
     
     GLfloat backgroundColorRed, backgroundColorGreen, backgroundColorBlue, backgroundColorAlpha;
+#if defined(GPUPIXEL_MAC)
+    // set on the main thread, read by the render thread before drawing
+    std::atomic<bool> hasDrawable;
+#endif
 }
 
 @end
@@ -63,6 +69,7 @@
 - (void)commonInit;
 {
     inputRotation = gpupixel::NoRotation;
+    context = gpupixel::GPUPixelContext::getInstance();
 #if defined(GPUPIXEL_IOS)
     self.opaque = YES;
     self.hidden = NO;
@@ -71,24 +78,23 @@
     eaglLayer.drawableProperties = [NSDictionary dictionaryWithObjectsAndKeys:[NSNumber numberWithBool:NO], kEAGLDrawablePropertyRetainedBacking, kEAGLColorFormatRGBA8, kEAGLDrawablePropertyColorFormat, nil];
     
 #else
-    [self setOpenGLContext:gpupixel::GPUPixelContext::getInstance()->getOpenGLContext()];
+    [self setOpenGLContext:context->getOpenGLContext()];
     if ([self respondsToSelector:@selector(setWantsBestResolutionOpenGLSurface:)])
     {
         [self  setWantsBestResolutionOpenGLSurface:YES];
     }
     //    inputRotation = kGPUImageNoRotation;
     self.hidden = NO;
+    hasDrawable = false;
 #endif
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
+    context->runSync([&]{
         displayProgram = gpupixel::GLProgram::createByShaderString(gpupixel::kDefaultVertexShader, gpupixel::kDefaultFragmentShader);
         
         positionAttribLocation = displayProgram->getAttribLocation("position");
         texCoordAttribLocation = displayProgram->getAttribLocation("inputTextureCoordinate");
         colorMapUniformLocation = displayProgram->getUniformLocation("inputImageTexture");
         
-        gpupixel::GPUPixelContext::getInstance()->setActiveShaderProgram(displayProgram);
-        glEnableVertexAttribArray(positionAttribLocation);
-        glEnableVertexAttribArray(texCoordAttribLocation);
+        context->setActiveShaderProgram(displayProgram);
         
         [self setBackgroundColorRed:0.0 green:0.0 blue:0.0 alpha:0.0];
         _fillMode = gpupixel::TargetView::FillMode::PreserveAspectRatio;
@@ -111,8 +117,18 @@
     return [CAEAGLLayer class];
 }
 #else
+- (void)viewDidMoveToWindow {
+    [super viewDidMoveToWindow];
+    [self updateHasDrawable];
+}
+
+- (void)updateHasDrawable {
+    hasDrawable = self.window != nil && !CGSizeEqualToSize(self.bounds.size, CGSizeZero);
+}
+
 - (void)reshape {
     [super reshape];
+    [self updateHasDrawable];
     CGSize viewSize = self.bounds.size;
     if ([self respondsToSelector:@selector(convertSizeToBacking:)])
     {
@@ -139,15 +155,15 @@
 
 - (void)createDisplayFramebuffer;
 {
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
+    context->runSync([&]{
 #if defined(GPUPIXEL_IOS)
         glGenRenderbuffers(1, &displayRenderbuffer);
         glBindRenderbuffer(GL_RENDERBUFFER, displayRenderbuffer);
         
-        [gpupixel::GPUPixelContext::getInstance()->getEglContext() renderbufferStorage:GL_RENDERBUFFER fromDrawable:(CAEAGLLayer*)self.layer];
+        [context->getEglContext() renderbufferStorage:GL_RENDERBUFFER fromDrawable:(CAEAGLLayer*)self.layer];
         
         glGenFramebuffers(1, &displayFramebuffer);
-        glBindFramebuffer(GL_FRAMEBUFFER, displayFramebuffer);
+        context->getGLStateCache()->bindFramebuffer(displayFramebuffer);
         glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
                                   GL_RENDERBUFFER, displayRenderbuffer);
         
@@ -172,10 +188,11 @@
 
 - (void)destroyDisplayFramebuffer;
 {
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
+    context->runSync([&]{
 #if defined(GPUPIXEL_IOS)
         if (displayFramebuffer)
         {
+            context->getGLStateCache()->onFramebufferDeleted(displayFramebuffer);
             glDeleteFramebuffers(1, &displayFramebuffer);
             displayFramebuffer = 0;
         }
@@ -199,24 +216,24 @@
         [self createDisplayFramebuffer];
     }
     
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
-        glBindFramebuffer(GL_FRAMEBUFFER, displayFramebuffer);
-        glViewport(0, 0, framebufferWidth, framebufferHeight);
+    context->runSync([&]{
+        context->getGLStateCache()->bindFramebuffer(displayFramebuffer);
+        context->getGLStateCache()->viewport(0, 0, framebufferWidth, framebufferHeight);
     });
 #else
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    context->runSync([&]{
+        context->getGLStateCache()->bindFramebuffer(0);
         glBindRenderbuffer(GL_RENDERBUFFER, 0);
-        glViewport(0, 0, self.sizeInPixels.width, self.sizeInPixels.height);
+        context->getGLStateCache()->viewport(0, 0, self.sizeInPixels.width, self.sizeInPixels.height);
     });
 #endif
 }
  
 - (void)presentFramebuffer {
-    gpupixel::GPUPixelContext::getInstance()->runSync([&] {
+    context->runSync([&] {
 #if defined(GPUPIXEL_IOS)
         glBindRenderbuffer(GL_RENDERBUFFER, displayRenderbuffer);
-        gpupixel::GPUPixelContext::getInstance()->presentBufferForDisplay();
+        context->presentBufferForDisplay();
 #else
         [self.openGLContext flushBuffer];
 #endif
@@ -232,19 +249,27 @@
 }
 
 - (void)update:(float)frameTime {
-    gpupixel::GPUPixelContext::getInstance()->runSync([&]{
-        gpupixel::GPUPixelContext::getInstance()->setActiveShaderProgram(displayProgram);
+    // the view keeps showing the last frame
+    if (context->isWarmingUp) {
+        return;
+    }
+    context->runSync([&]{
+        context->setActiveShaderProgram(displayProgram);
         [self setDisplayFramebuffer];
-        glClearColor(backgroundColorRed, backgroundColorGreen, backgroundColorBlue, backgroundColorAlpha);
+        context->getGLStateCache()->clearColor(backgroundColorRed, backgroundColorGreen, backgroundColorBlue, backgroundColorAlpha);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 #if defined(GPUPIXEL_MAC)
         // Re-render onscreen, flipped to a normal orientation
-        CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+        context->getGLStateCache()->bindFramebuffer(0);
         CHECK_GL(glBindRenderbuffer(GL_RENDERBUFFER, 0));
 #endif
-        CHECK_GL(glActiveTexture(GL_TEXTURE0));
-        CHECK_GL(glBindTexture(GL_TEXTURE_2D, inputFramebuffer->getTexture()));
-        CHECK_GL(glUniform1i(colorMapUniformLocation, 0));
+        context->getGLStateCache()->bindTexture(0, inputFramebuffer->getTexture());
+        displayProgram->setUniformValue(colorMapUniformLocation, 0);
+
+        // the display vertices are drawn from client memory
+        context->getFullscreenQuad()->unbind();
+        context->getGLStateCache()->enableVertexAttribArray(positionAttribLocation);
+        context->getGLStateCache()->enableVertexAttribArray(texCoordAttribLocation);
 
         CHECK_GL(glVertexAttribPointer(positionAttribLocation, 2, GL_FLOAT, 0, 0, displayVertices));
         CHECK_GL(glVertexAttribPointer(texCoordAttribLocation,
@@ -254,27 +279,16 @@
                                     0,
                                     [self textureCoordinatesForRotation:inputRotation]));
 #if defined(GPUPIXEL_IOS)
-                 CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
-                 [self presentFramebuffer];
+        CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+        [self presentFramebuffer];
 #else
-                 BOOL canLockFocus = YES;
-                 if ([self respondsToSelector:@selector(lockFocusIfCanDraw)])
-                 {
-            canLockFocus = [self lockFocusIfCanDraw];
-        }
-                 else
-                 {
-            [self lockFocus];
-        }
-                 
-                 if (canLockFocus)
-                 {
+        // AppKit locks the focus of a view on the main thread only, the
+        // NSOpenGLContext presents to the drawable of the view without it
+        if (hasDrawable) {
             CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
-            
             [self presentFramebuffer];
-            CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
-            [self unlockFocus];
         }
+        context->getGLStateCache()->bindTexture(0);
 #endif
     });
 }
@@ -13,6 +13,8 @@
 #include <map>
 
 NS_GPUPIXEL_BEGIN
+class FrameGraph;
+
 GPUPIXEL_API enum RotationMode {
   NoRotation = 0,
   RotateLeft,
@@ -38,6 +40,8 @@ class GPUPIXEL_API Target {
   virtual int getNextAvailableTextureIndex() const;
   // virtual void setInputSizeWithIdx(int width, int height, int textureIdx) {};
  protected:
+  friend class FrameGraph;
+
   struct InputFrameBufferInfo {
     std::shared_ptr<Framebuffer> frameBuffer;
     RotationMode rotationMode;
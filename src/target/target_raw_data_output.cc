@@ -39,9 +39,12 @@ std::shared_ptr<TargetRawDataOutput> TargetRawDataOutput::create() {
   return sourceRawDataOutput;
 }
 
-TargetRawDataOutput::TargetRawDataOutput() {
-  initWithShaderString(kRGBToI420VertexShaderString,
-                       kRGBToI420FragmentShaderString);
+TargetRawDataOutput::TargetRawDataOutput()
+    : _context(GPUPixelContext::getInstance()) {
+  _context->runSync([=] {
+    initWithShaderString(kRGBToI420VertexShaderString,
+                         kRGBToI420FragmentShaderString);
+  });
 }
 
 TargetRawDataOutput::~TargetRawDataOutput() {
@@ -57,9 +60,10 @@ TargetRawDataOutput::~TargetRawDataOutput() {
   }
   _yuvFrameBuffer = nullptr;
 
-  gpupixel::GPUPixelContext::getInstance()->runSync([=] {
+  _context->runSync([=] {
 #if TARGET_IPHONE_SIMULATOR || TARGET_OS_IPHONE
     if (_framebuffer) {
+      _context->getGLStateCache()->onFramebufferDeleted(_framebuffer);
       CHECK_GL(glDeleteFramebuffers(1, &_framebuffer));
       _framebuffer = 0;
     }
@@ -114,7 +118,10 @@ bool TargetRawDataOutput::initWithShaderString(
     const std::string& fragmentShaderSource) {
   _filterProgram =
       GLProgram::createByShaderString(vertexShaderSource, fragmentShaderSource);
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  if (!_filterProgram) {
+    return false;
+  }
+  _context->setActiveShaderProgram(_filterProgram);
   _filterPositionAttribute = _filterProgram->getAttribLocation("position");
   _filterTexCoordAttribute =
       _filterProgram->getAttribLocation("inputTextureCoordinate");
@@ -123,48 +130,39 @@ bool TargetRawDataOutput::initWithShaderString(
 }
 
 int TargetRawDataOutput::renderToOutput() {
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_filterProgram);
+  if (!_filterProgram) {
+    return 0;
+  }
+  GLStateCache* glState = _context->getGLStateCache();
+  _context->setActiveShaderProgram(_filterProgram);
 #if defined(GPUPIXEL_IOS)
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glState->bindFramebuffer(_framebuffer);
 #else
   _framebuffer->active();
 #endif
 
-  CHECK_GL(glViewport(0, 0, _width, _height));
+  glState->viewport(0, 0, _width, _height);
 
-  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+  glState->clearColor(0.0f, 0.0f, 0.0f, 1.0f);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  GLfloat imageVertices[] = {
-      -1.0, -1.0,  // left down
-      1.0,  -1.0,  // right down
-      -1.0, 1.0,   // left up
-      1.0,  1.0    // right up
-  };
-
-  GLfloat textureVertices[] = {
-      0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-  };
-
-  CHECK_GL(glEnableVertexAttribArray(_filterPositionAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterPositionAttribute, 2, GL_FLOAT, 0, 0,
-                                 imageVertices));
-
-  CHECK_GL(glEnableVertexAttribArray(_filterTexCoordAttribute));
-  CHECK_GL(glVertexAttribPointer(_filterTexCoordAttribute, 2, GL_FLOAT, 0, 0,
-                                 textureVertices));
-
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, _inputFramebuffers[0].frameBuffer->getTexture());
+  glState->bindTexture(0, _inputFramebuffers[0].frameBuffer->getTexture());
 
   CHECK_GL(_filterProgram->setUniformValue("sTexture", 0));
   // draw frame buffer
-  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  FullscreenQuad* quad = _context->getFullscreenQuad();
+  quad->bind(_filterPositionAttribute, _filterTexCoordAttribute, NoRotation);
+  quad->draw();
+  // a warm-up frame only allocates and draws, there is nothing to hand out
 #if defined(GPUPIXEL_IOS)
-  readPixelsFromCVPixelBuffer();
+  if (!_context->isWarmingUp) {
+    readPixelsFromCVPixelBuffer();
+  }
 #else
   // read with pbo
-  readPixelsWithPBO(_width, _height);
+  if (!_context->isWarmingUp) {
+    readPixelsWithPBO(_width, _height);
+  }
   _framebuffer->inactive();
 #endif
   return 0;
@@ -207,14 +205,19 @@ void TargetRawDataOutput::readPixelsFromCVPixelBuffer() {
 
     // process pixels how you like
     if (pixels && i420_callback_) {
-      libyuv::ARGBToI420(pixels, stride, _yuvFrameBuffer, _width,
-                        _yuvFrameBuffer + _width * _height, _width
-                        / 2, _yuvFrameBuffer + _width * _height * 5
-                        / 4, _width / 2, _width, _height);
+      {
+        TRACE_SCOPE("TargetRawDataOutput ARGBToI420");
+        libyuv::ARGBToI420(pixels, stride, _yuvFrameBuffer, _width,
+                           _yuvFrameBuffer + _width * _height, _width / 2,
+                           _yuvFrameBuffer + _width * _height * 5 / 4,
+                           _width / 2, _width, _height);
+      }
+      TRACE_SCOPE("TargetRawDataOutput i420 callback");
       i420_callback_(_yuvFrameBuffer, _width, _height, _frame_ts);
     }
 
     if(pixels_callback_) {
+      TRACE_SCOPE("TargetRawDataOutput pixels callback");
       pixels_callback_(pixels, _width, _height, _frame_ts);
     }
 
@@ -243,8 +246,8 @@ void TargetRawDataOutput::initTextureCache(int width, int height) {
   // in real life check the error return value of course.
   if (textureCache == NULL) {
     CVReturn err = CVOpenGLESTextureCacheCreate(
-        kCFAllocatorDefault, NULL,
-        GPUPixelContext::getInstance()->getEglContext(), NULL, &textureCache);
+        kCFAllocatorDefault, NULL, _context->getEglContext(), NULL,
+        &textureCache);
 
     if (err) {
       // todo(Jeayo)
@@ -270,31 +273,29 @@ void TargetRawDataOutput::initTextureCache(int width, int height) {
   CFRelease(empty);
 
   // set the texture up like any other texture
-  CHECK_GL(glBindTexture(CVOpenGLESTextureGetTarget(renderTexture),
-                         CVOpenGLESTextureGetName(renderTexture)));
+  GLStateCache* glState = _context->getGLStateCache();
+  glState->bindTexture(CVOpenGLESTextureGetName(renderTexture));
 
   CHECK_GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
   CHECK_GL(glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
 
   CHECK_GL(glGenFramebuffers(1, &_framebuffer));
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, _framebuffer));
+  glState->bindFramebuffer(_framebuffer);
 
-  CHECK_GL(glBindTexture(CVOpenGLESTextureGetTarget(renderTexture),
-                         CVOpenGLESTextureGetName(renderTexture)));
+  glState->bindTexture(CVOpenGLESTextureGetName(renderTexture));
 
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
                          CVOpenGLESTextureGetName(renderTexture), 0);
 
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  glState->bindTexture(0);
+  glState->bindFramebuffer(0);
 }
 #else
 void TargetRawDataOutput::initFrameBuffer(int width, int height) {
   if (!_framebuffer || (_framebuffer->getWidth() != width ||
                         _framebuffer->getHeight() != height)) {
     _framebuffer =
-        GPUPixelContext::getInstance()->getFramebufferCache()->fetchFramebuffer(
-            width, height);
+        _context->getFramebufferCache()->fetchFramebuffer(width, height);
   }
 }
 
@@ -310,6 +311,8 @@ void TargetRawDataOutput::initPBO(int width, int height) {
 
 // read pixel with pbo
 void TargetRawDataOutput::readPixelsWithPBO(int width, int height) {
+  GPUProfiler* profiler = _context->getGPUProfiler();
+  int profileScope = profiler->beginScope("TargetRawDataOutput readback");
   index = (index + 1) % 2;
   nextIndex = (index + 1) % 2;
 
@@ -320,28 +323,38 @@ void TargetRawDataOutput::readPixelsWithPBO(int width, int height) {
   // map the PBO to process its data by CPU
   CHECK_GL(glBindBuffer(GL_PIXEL_PACK_BUFFER, pboIds[nextIndex]));
 
+  GLubyte* ptr = nullptr;
+  {
+    TRACE_SCOPE("TargetRawDataOutput map PBO");
 #if defined(GPUPIXEL_MAC) || defined(GPUPIXEL_WIN) || defined(GPUPIXEL_LINUX)
-  GLubyte* ptr = (GLubyte*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    ptr = (GLubyte*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
 #elif defined(GPUPIXEL_ANDROID)
-  GLubyte* ptr = (GLubyte*)glMapBufferRange(
-                  GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT);
+    ptr = (GLubyte*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                     width * height * 4, GL_MAP_READ_BIT);
 #endif
+  }
   if (ptr) {
-       libyuv::ABGRToI420(ptr, width * 4, _yuvFrameBuffer, _width,
-                          _yuvFrameBuffer + _width * _height, _width / 2,
-                          _yuvFrameBuffer + _width * _height * 5 / 4, _width
-                          / 2, _width, _height);
+    {
+      TRACE_SCOPE("TargetRawDataOutput ABGRToI420");
+      libyuv::ABGRToI420(ptr, width * 4, _yuvFrameBuffer, _width,
+                         _yuvFrameBuffer + _width * _height, _width / 2,
+                         _yuvFrameBuffer + _width * _height * 5 / 4,
+                         _width / 2, _width, _height);
+    }
     if (i420_callback_) {
+      TRACE_SCOPE("TargetRawDataOutput i420 callback");
       i420_callback_(_yuvFrameBuffer, _width, _height, _frame_ts);
     }
 
     if(pixels_callback_) {
+      TRACE_SCOPE("TargetRawDataOutput pixels callback");
       pixels_callback_(ptr, _width, _height, _frame_ts);
     }
 
     glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
   }
   glBindBuffer(GL_PIXEL_PACK_BUFFER, GL_NONE);
+  profiler->endScope(profileScope);
 }
 
 #endif
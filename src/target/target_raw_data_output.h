@@ -49,6 +49,7 @@ class GPUPIXEL_API TargetRawDataOutput : public Target {
 
  private:
   std::mutex mtx_;
+  GPUPixelContext* _context;
   GLProgram* _filterProgram;
   GLuint _filterPositionAttribute;
   GLuint _filterTexCoordAttribute;
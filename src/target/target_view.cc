@@ -6,6 +6,7 @@
  */
 
 #include "target_view.h"
+#include <cstring>
 #include "gpupixel_context.h"
 #include "util.h"
 #include "filter.h"
@@ -16,18 +17,36 @@ TargetView::TargetView()
     : _viewWidth(0),
       _viewHeight(0),
       _fillMode(FillMode::PreserveAspectRatio),
+      _context(GPUPixelContext::getInstance()),
       _displayProgram(0),
       _positionAttribLocation(0),
       _texCoordAttribLocation(0),
-      _colorMapUniformLocation(0) {
+      _colorMapUniformLocation(0),
+      _displayVerticesChanged(true),
+      _vertexBuffer(0),
+      _vertexArray(0),
+      _vertexBufferRotation(NoRotation) {
   _backgroundColor.r = 0.0;
   _backgroundColor.g = 0.0;
   _backgroundColor.b = 0.0;
   _backgroundColor.a = 0.0;
-  init();
+  _context->runSync([=] { init(); });
 }
 
 TargetView::~TargetView() {
+  _context->runSync([=] {
+    GLStateCache* glState = _context->getGLStateCache();
+#if !defined(GPUPIXEL_MAC)
+    if (_vertexArray) {
+      glState->onVertexArrayDeleted(_vertexArray);
+      CHECK_GL(glDeleteVertexArrays(1, &_vertexArray));
+    }
+#endif
+    if (_vertexBuffer) {
+      glState->onBufferDeleted(_vertexBuffer);
+      CHECK_GL(glDeleteBuffers(1, &_vertexBuffer));
+    }
+  });
   if (_displayProgram) {
     delete _displayProgram;
     _displayProgram = 0;
@@ -37,14 +56,15 @@ TargetView::~TargetView() {
 void TargetView::init() {
   _displayProgram = GLProgram::createByShaderString(kDefaultVertexShader,
                                                     kDefaultFragmentShader);
+  if (!_displayProgram) {
+    return;
+  }
   _positionAttribLocation = _displayProgram->getAttribLocation("position");
   _texCoordAttribLocation =
       _displayProgram->getAttribLocation("inputTextureCoordinate");
   _colorMapUniformLocation =
       _displayProgram->getUniformLocation("textureCoordinate");
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_displayProgram);
-  CHECK_GL(glEnableVertexAttribArray(_positionAttribLocation));
-  CHECK_GL(glEnableVertexAttribArray(_texCoordAttribLocation));
+  _context->setActiveShaderProgram(_displayProgram);
 };
 
 void TargetView::setInputFramebuffer(
@@ -79,6 +99,8 @@ void TargetView::setFillMode(FillMode fillMode) {
 void TargetView::setMirror(bool mirror) {
   if (_mirror != mirror) {
     _mirror = mirror;
+    // the texture coordinates in the vertex buffer depend on it
+    _displayVerticesChanged = true;
   }
 }
 
@@ -92,25 +114,71 @@ void TargetView::onSizeChanged(int width, int height) {
 }
 
 void TargetView::update(int64_t frameTime) {
-  CHECK_GL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+  // the window keeps showing the last frame
+  if (_context->isWarmingUp || !_displayProgram) {
+    return;
+  }
+  GLStateCache* glState = _context->getGLStateCache();
+  glState->bindFramebuffer(0);
 
-  CHECK_GL(glViewport(0, 0, _viewWidth, _viewHeight));
-  CHECK_GL(glClearColor(_backgroundColor.r, _backgroundColor.g,
-                        _backgroundColor.b, _backgroundColor.a));
+  glState->viewport(0, 0, _viewWidth, _viewHeight);
+  glState->clearColor(_backgroundColor.r, _backgroundColor.g,
+                      _backgroundColor.b, _backgroundColor.a);
   CHECK_GL(glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT));
-  GPUPixelContext::getInstance()->setActiveShaderProgram(_displayProgram);
-  CHECK_GL(glActiveTexture(GL_TEXTURE0));
-  CHECK_GL(glBindTexture(GL_TEXTURE_2D,
-                         _inputFramebuffers[0].frameBuffer->getTexture()));
-  CHECK_GL(glUniform1i(_colorMapUniformLocation, 0));
-  CHECK_GL(glVertexAttribPointer(_positionAttribLocation, 2, GL_FLOAT, 0, 0,
-                                 _displayVertices));
-  CHECK_GL(glVertexAttribPointer(
-      _texCoordAttribLocation, 2, GL_FLOAT, 0, 0,
-      _getTexureCoordinate(_inputFramebuffers[0].rotationMode)));
+  _context->setActiveShaderProgram(_displayProgram);
+  glState->bindTexture(0, _inputFramebuffers[0].frameBuffer->getTexture());
+  _displayProgram->setUniformValue(_colorMapUniformLocation, 0);
+  _updateVertexBuffer(_inputFramebuffers[0].rotationMode);
+#if !defined(GPUPIXEL_MAC)
+  if (_context->getFullscreenQuad()->isVertexArraySupported()) {
+    if (!_vertexArray) {
+      CHECK_GL(glGenVertexArrays(1, &_vertexArray));
+      glState->bindVertexArray(_vertexArray);
+      _setupAttributes();
+    }
+    glState->bindVertexArray(_vertexArray);
+  } else {
+    _setupAttributes();
+  }
+#else
+  _setupAttributes();
+#endif
   CHECK_GL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
 }
 
+void TargetView::_updateVertexBuffer(RotationMode rotationMode) {
+  GLStateCache* glState = _context->getGLStateCache();
+  if (!_vertexBuffer) {
+    CHECK_GL(glGenBuffers(1, &_vertexBuffer));
+    glState->bindArrayBuffer(_vertexBuffer);
+    CHECK_GL(glBufferData(GL_ARRAY_BUFFER, 16 * sizeof(GLfloat), 0,
+                          GL_DYNAMIC_DRAW));
+    _displayVerticesChanged = true;
+  }
+  if (!_displayVerticesChanged && _vertexBufferRotation == rotationMode) {
+    return;
+  }
+  GLfloat vertices[16];
+  memcpy(vertices, _displayVertices, 8 * sizeof(GLfloat));
+  memcpy(vertices + 8, _getTexureCoordinate(rotationMode),
+         8 * sizeof(GLfloat));
+  glState->bindArrayBuffer(_vertexBuffer);
+  CHECK_GL(glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices));
+  _displayVerticesChanged = false;
+  _vertexBufferRotation = rotationMode;
+}
+
+void TargetView::_setupAttributes() {
+  GLStateCache* glState = _context->getGLStateCache();
+  glState->bindArrayBuffer(_vertexBuffer);
+  glState->enableVertexAttribArray(_positionAttribLocation);
+  CHECK_GL(glVertexAttribPointer(_positionAttribLocation, 2, GL_FLOAT, 0, 0,
+                                 0));
+  glState->enableVertexAttribArray(_texCoordAttribLocation);
+  CHECK_GL(glVertexAttribPointer(_texCoordAttribLocation, 2, GL_FLOAT, 0, 0,
+                                 (const GLvoid*)(8 * sizeof(GLfloat))));
+}
+
 void TargetView::_updateDisplayVertices() {
   if (_inputFramebuffers.find(0) == _inputFramebuffers.end() ||
       _inputFramebuffers[0].frameBuffer == 0) {
@@ -154,14 +222,15 @@ void TargetView::_updateDisplayVertices() {
     scaledHeight = _viewHeight / insetFramebufferWidth;
   }
 
-  _displayVertices[0] = -scaledWidth;
-  _displayVertices[1] = -scaledHeight;
-  _displayVertices[2] = scaledWidth;
-  _displayVertices[3] = -scaledHeight;
-  _displayVertices[4] = -scaledWidth;
-  _displayVertices[5] = scaledHeight;
-  _displayVertices[6] = scaledWidth;
-  _displayVertices[7] = scaledHeight;
+  const GLfloat displayVertices[] = {
+      -scaledWidth, -scaledHeight, scaledWidth, -scaledHeight,
+      -scaledWidth, scaledHeight,  scaledWidth, scaledHeight,
+  };
+  // recomputed for every frame, only changes reach the vertex buffer
+  if (memcmp(_displayVertices, displayVertices, sizeof(_displayVertices))) {
+    memcpy(_displayVertices, displayVertices, sizeof(_displayVertices));
+    _displayVerticesChanged = true;
+  }
 }
 
 const GLfloat* TargetView::_getTexureCoordinate(RotationMode rotationMode) {
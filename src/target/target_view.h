@@ -38,6 +38,7 @@ class GPUPIXEL_API TargetView : public Target {
   int _viewHeight;
   FillMode _fillMode;
   bool _mirror = false;
+  GPUPixelContext* _context;
   GLProgram* _displayProgram;
   GLuint _positionAttribLocation;
   GLuint _texCoordAttribLocation;
@@ -50,8 +51,15 @@ class GPUPIXEL_API TargetView : public Target {
   } _backgroundColor;
 
   GLfloat _displayVertices[8];
+  bool _displayVerticesChanged;
+  // display vertices followed by the texture coordinates of the input
+  GLuint _vertexBuffer;
+  GLuint _vertexArray;
+  RotationMode _vertexBufferRotation;
 
   void _updateDisplayVertices();
+  void _updateVertexBuffer(RotationMode rotationMode);
+  void _setupAttributes();
   const GLfloat* _getTexureCoordinate(RotationMode rotationMode);
 };
 
@@ -104,3 +104,69 @@ void DispatchQueue::add(const std::function<void()> & task) {
     }
     cv.notify_one();
 }
+
+SerialDispatchQueue::SerialDispatchQueue(size_t capacity)
+    : running(true), capacity(capacity > 0 ? capacity : 1) {
+    worker = std::thread(&SerialDispatchQueue::run, this);
+    workerId = worker.get_id();
+}
+
+SerialDispatchQueue::~SerialDispatchQueue() {
+    join();
+}
+
+void SerialDispatchQueue::run() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock lk(m);
+            cvTask.wait(lk, [&]() {
+                return !running || !taskQueue.empty();
+            });
+
+            if (taskQueue.empty())
+                break;
+
+            task = std::move(taskQueue.front());
+            taskQueue.pop();
+        }
+        cvSpace.notify_one();
+        task();
+    }
+}
+
+bool SerialDispatchQueue::isQueueThread() const {
+    return std::this_thread::get_id() == workerId;
+}
+
+void SerialDispatchQueue::setCapacity(size_t capacity) {
+    {
+        std::unique_lock lk(m);
+        this->capacity = capacity > 0 ? capacity : 1;
+    }
+    cvSpace.notify_all();
+}
+
+void SerialDispatchQueue::add(std::function<void()> task) {
+    {
+        std::unique_lock lk(m);
+        if (!isQueueThread()) {
+            cvSpace.wait(lk, [&]() {
+                return taskQueue.size() < capacity;
+            });
+        }
+        taskQueue.push(std::move(task));
+    }
+    cvTask.notify_one();
+}
+
+void SerialDispatchQueue::join() {
+    {
+        std::unique_lock lk(m);
+        running = false;
+    }
+    cvTask.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
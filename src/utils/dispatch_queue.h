@@ -110,3 +110,64 @@ public:
      */
     void add(const std::function<void()> & task);
 };
+
+/**
+ * @brief Serial task queue executed on its own thread with a bounded number
+ * of pending tasks.
+ *
+ * `add` blocks the producer while `capacity` tasks are already waiting, so a
+ * producer can not run ahead of the queue thread. Tasks added from the queue
+ * thread itself are never blocked.
+ */
+class SerialDispatchQueue {
+private:
+    bool running;
+    size_t capacity;
+    std::mutex m;
+    std::condition_variable cvTask;
+    std::condition_variable cvSpace;
+    std::queue<std::function<void()>> taskQueue;
+    std::thread worker;
+    std::thread::id workerId;
+
+    /**
+     * Worker thread method. Executes tasks in order until the queue is
+     * stopped.
+     */
+    void run();
+
+public:
+    /**
+     * Create a new `SerialDispatchQueue` and start its thread.
+     * @param capacity the maximum number of pending tasks, at least 1
+     */
+    SerialDispatchQueue(size_t capacity);
+
+    /**
+     * Execute the remaining tasks and stop the thread.
+     */
+    ~SerialDispatchQueue();
+
+    /**
+     * Check if the calling thread is the queue thread.
+     */
+    bool isQueueThread() const;
+
+    /**
+     * Change the maximum number of pending tasks.
+     */
+    void setCapacity(size_t capacity);
+
+    /**
+     * Add a task to the queue, blocks while the queue is full.
+     *
+     * @param task the lambda to execute for the task
+     */
+    void add(std::function<void()> task);
+
+    /**
+     * Execute the remaining tasks and stop the thread. Must not be called
+     * from the queue thread.
+     */
+    void join();
+};
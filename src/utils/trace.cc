@@ -0,0 +1,183 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "util.h"
+
+NS_GPUPIXEL_BEGIN
+
+// spans kept per thread, about 16 seconds of a 20 span pipeline at 60 fps
+static const uint64_t kTraceBufferSize = 16384;
+
+struct TraceEvent {
+  const char* name;
+  int64_t frameTime;
+  int64_t begin;
+  int64_t duration;
+};
+
+// written by its thread only. A reader copies the events and then drops
+// the ones the writer may have overwritten meanwhile.
+struct TraceBuffer {
+  int threadId;
+  std::string threadName;
+  int64_t frameTime;
+  std::atomic<uint64_t> written;
+  // spans before it were dropped by clear()
+  uint64_t cleared;
+  TraceEvent events[kTraceBufferSize];
+};
+
+static std::atomic<bool> s_traceEnabled(false);
+static std::mutex s_traceMutex;
+// buffers outlive their threads, spans of finished threads are exported too
+static std::vector<std::unique_ptr<TraceBuffer>> s_traceBuffers;
+static thread_local TraceBuffer* s_threadBuffer = nullptr;
+
+static TraceBuffer* getThreadBuffer() {
+  if (!s_threadBuffer) {
+    std::unique_ptr<TraceBuffer> buffer(new TraceBuffer());
+    buffer->frameTime = 0;
+    buffer->written = 0;
+    buffer->cleared = 0;
+    std::unique_lock<std::mutex> lock(s_traceMutex);
+    buffer->threadId = (int)s_traceBuffers.size() + 1;
+    s_threadBuffer = buffer.get();
+    s_traceBuffers.push_back(std::move(buffer));
+  }
+  return s_threadBuffer;
+}
+
+void Trace::setEnabled(bool enabled) {
+  s_traceEnabled = enabled;
+}
+
+bool Trace::isEnabled() {
+  return s_traceEnabled.load(std::memory_order_relaxed);
+}
+
+void Trace::setThreadName(const std::string& name) {
+  TraceBuffer* buffer = getThreadBuffer();
+  std::unique_lock<std::mutex> lock(s_traceMutex);
+  buffer->threadName = name;
+}
+
+void Trace::setFrameTime(int64_t frameTime) {
+  if (isEnabled()) {
+    getThreadBuffer()->frameTime = frameTime;
+  }
+}
+
+int64_t Trace::now() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+void Trace::addSpan(const char* name, int64_t begin, int64_t end) {
+  TraceBuffer* buffer = getThreadBuffer();
+  uint64_t index = buffer->written.load(std::memory_order_relaxed);
+  TraceEvent& event = buffer->events[index % kTraceBufferSize];
+  event.name = name;
+  event.frameTime = buffer->frameTime;
+  event.begin = begin;
+  event.duration = end - begin;
+  buffer->written.store(index + 1, std::memory_order_release);
+}
+
+static std::string escapeJSON(const std::string& value) {
+  std::string escaped;
+  for (char c : value) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+std::string Trace::dumpJSON() {
+  std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  std::map<const char*, std::string> names;
+  std::unique_lock<std::mutex> lock(s_traceMutex);
+  for (auto& buffer : s_traceBuffers) {
+    if (!buffer->threadName.empty()) {
+      json += Util::str_format(
+          "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+          "\"args\":{\"name\":\"%s\"}}",
+          first ? "" : ",", buffer->threadId,
+          escapeJSON(buffer->threadName).c_str());
+      first = false;
+    }
+
+    uint64_t written = buffer->written.load(std::memory_order_acquire);
+    uint64_t start =
+        written > kTraceBufferSize ? written - kTraceBufferSize : 0;
+    start = std::max(start, buffer->cleared);
+    std::vector<TraceEvent> events;
+    for (uint64_t i = start; i < written; ++i) {
+      events.push_back(buffer->events[i % kTraceBufferSize]);
+    }
+    // the thread kept recording while the events were copied, the oldest
+    // ones may have been overwritten
+    uint64_t latest = buffer->written.load(std::memory_order_acquire);
+    uint64_t valid =
+        latest > kTraceBufferSize ? latest - kTraceBufferSize : 0;
+
+    for (uint64_t i = std::max(start, valid); i < written; ++i) {
+      const TraceEvent& event = events[i - start];
+      auto it = names.find(event.name);
+      if (it == names.end()) {
+        it = names.emplace(event.name, escapeJSON(Util::demangle(event.name)))
+                 .first;
+      }
+      json += Util::str_format(
+          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+          "\"ts\":%lld,\"dur\":%lld,\"args\":{\"frame\":%lld}}",
+          first ? "" : ",", it->second.c_str(), buffer->threadId,
+          (long long)event.begin, (long long)event.duration,
+          (long long)event.frameTime);
+      first = false;
+    }
+  }
+  json += "]}";
+  return json;
+}
+
+bool Trace::writeJSON(const std::string& path) {
+  std::string json = dumpJSON();
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file) {
+    Util::Log("ERROR", "Trace: can not open %s", path.c_str());
+    return false;
+  }
+  bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+  fclose(file);
+  if (!written) {
+    Util::Log("ERROR", "Trace: writing %s failed", path.c_str());
+  }
+  return written;
+}
+
+void Trace::clear() {
+  // the spans are only skipped, a thread may be writing into its buffer
+  std::unique_lock<std::mutex> lock(s_traceMutex);
+  for (auto& buffer : s_traceBuffers) {
+    buffer->cleared = buffer->written.load(std::memory_order_acquire);
+  }
+}
+
+NS_GPUPIXEL_END
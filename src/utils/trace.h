@@ -0,0 +1,76 @@
+/*
+ * GPUPixel
+ *
+ * Created by PixPark on 2021/6/24.
+ * Copyright © 2021 PixPark. All rights reserved.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "gpupixel_macros.h"
+
+NS_GPUPIXEL_BEGIN
+
+// CPU spans of the frame pipeline, exported in the Chrome trace event format
+// for chrome://tracing and Perfetto. Every thread records into a ring buffer
+// of its own, a span costs two clock reads and no lock. Each span is tagged
+// with the timestamp of the frame its thread is working on.
+//
+// Recording is off until setEnabled(true). ENABLE_TRACE false compiles the
+// TRACE_* macros out.
+class GPUPIXEL_API Trace {
+ public:
+  static void setEnabled(bool enabled);
+  static bool isEnabled();
+
+  // names the calling thread in the export
+  static void setThreadName(const std::string& name);
+  // the frame following spans of the calling thread belong to
+  static void setFrameTime(int64_t frameTime);
+
+  // |name| must stay valid, mangled type names are demangled on export.
+  // Spans are in microseconds of a monotonic clock.
+  static void addSpan(const char* name, int64_t begin, int64_t end);
+  static int64_t now();
+
+  // the spans still held by the ring buffers of all threads
+  static std::string dumpJSON();
+  static bool writeJSON(const std::string& path);
+  static void clear();
+};
+
+// records the lifetime of the scope as a span
+class GPUPIXEL_API TraceScope {
+ public:
+  TraceScope(const char* name)
+      : _name(name), _begin(Trace::isEnabled() ? Trace::now() : -1) {}
+  ~TraceScope() {
+    if (_begin >= 0) {
+      Trace::addSpan(_name, _begin, Trace::now());
+    }
+  }
+
+ private:
+  const char* _name;
+  int64_t _begin;
+};
+
+NS_GPUPIXEL_END
+
+//------------- ENABLE_TRACE Begin ------------ //
+#ifndef ENABLE_TRACE
+#define ENABLE_TRACE true
+#endif
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#if ENABLE_TRACE
+  #define TRACE_SCOPE(name) \
+  gpupixel::TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+  #define TRACE_FRAME(frameTime) gpupixel::Trace::setFrameTime(frameTime)
+#else
+  #define TRACE_SCOPE(name)
+  #define TRACE_FRAME(frameTime)
+#endif
+//------------- ENABLE_TRACE End ------------ //
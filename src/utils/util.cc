@@ -8,6 +8,9 @@
 #include "util.h"
 #include "gpupixel_context.h"
 #include <cstdarg>
+#if defined(__GNUC__)
+#include <cxxabi.h>
+#endif
 #if defined(GPUPIXEL_ANDROID)
 #include <android/log.h>
 #include "jni_helpers.h"
@@ -184,6 +187,24 @@ int64_t Util::nowTimeMs() {
   return ts;
 }
 
+std::string Util::demangle(const char* name) {
+  std::string readable = name;
+#if defined(__GNUC__)
+  // typeid names are mangled with gcc and clang
+  int status = 0;
+  char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+  if (status == 0 && demangled) {
+    readable = demangled;
+  }
+  free(demangled);
+#endif
+  const std::string prefix = "gpupixel::";
+  if (readable.compare(0, prefix.size(), prefix) == 0) {
+    readable = readable.substr(prefix.size());
+  }
+  return readable;
+}
+
 void Util::Log(const std::string& tag,std::string format, ...) {
   char buffer[10240];
   va_list args;
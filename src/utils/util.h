@@ -23,6 +23,8 @@ class GPUPIXEL_API Util {
   static std::string str_format(const char* fmt, ...);
   static void Log(const std::string& tag, std::string format, ...);
   static int64_t nowTimeMs();
+  // readable form of a typeid name, without the gpupixel namespace
+  static std::string demangle(const char* name);
 
   static std::string getResourcePath(std::string name);
   static void setResourceRoot(std::string root);